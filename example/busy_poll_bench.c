@@ -0,0 +1,120 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "morelib/fcntl.h"
+#include "morelib/mount.h"
+#include "morelib/thread.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+// Measures how long a task blocked in read takes to wake up after another core writes to an
+// eventfd, with busy polling off and with a budget longer than the gap between writes. Then checks
+// that interrupting a thread stops it spinning instead of waiting out its budget.
+#define NUM_ITERATIONS 2000
+#define GAP_US 20
+#define INTERRUPT_BUDGET_US 1000000
+
+static int efd;
+static TaskHandle_t writer_task;
+static volatile int64_t send_us;
+static int64_t total_us;
+static int64_t max_us;
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void *reader(void *arg) {
+    #if configNUMBER_OF_CORES > 1
+    vTaskCoreAffinitySet(NULL, 1u << 1);
+    #endif
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        xTaskNotifyGive(writer_task);
+        uint64_t value;
+        if (read(efd, &value, sizeof(value)) < 0) {
+            break;
+        }
+        int64_t latency = now_us() - send_us;
+        total_us += latency;
+        max_us = latency > max_us ? latency : max_us;
+    }
+    return NULL;
+}
+
+static void run_latency(int budget) {
+    fcntl(efd, F_SETBUSYPOLL, budget);
+    struct busy_poll_stats before, after;
+    fcntl(efd, F_GETBUSYPOLLSTATS, &before);
+    total_us = 0;
+    max_us = 0;
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, reader, NULL);
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        // Wait for the reader to be about to read, then give it time to block or start spinning.
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t start = now_us();
+        while (now_us() - start < GAP_US) {
+        }
+        send_us = now_us();
+        uint64_t value = 1;
+        write(efd, &value, sizeof(value));
+    }
+    pthread_join(thread, NULL);
+
+    fcntl(efd, F_GETBUSYPOLLSTATS, &after);
+    printf("busy poll %4d us: mean %4lld us, max %5lld us, %u hits, %u misses\n", budget,
+        (long long)total_us / NUM_ITERATIONS, (long long)max_us, after.hits - before.hits, after.misses - before.misses);
+}
+
+static void *interrupted_reader(void *arg) {
+    uint64_t value;
+    int ret = read(efd, &value, sizeof(value));
+    *(int *)arg = (ret < 0) ? errno : 0;
+    return NULL;
+}
+
+static void run_interrupt(void) {
+    fcntl(efd, F_SETBUSYPOLL, INTERRUPT_BUDGET_US);
+    int error = 0;
+    pthread_t thread;
+    pthread_create(&thread, NULL, interrupted_reader, &error);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    int64_t start = now_us();
+    thread_interrupt(thread);
+    pthread_join(thread, NULL);
+    printf("interrupt while spinning: returned after %lld us (%s)\n", (long long)(now_us() - start), error == EINTR ? "EINTR" : "failed");
+}
+
+static void init_task(void *params) {
+    mount(NULL, "/dev", "devfs", 1, NULL);
+    int fd = open("/dev/ttyS0", O_RDWR, 0);
+    close(fd);
+
+    writer_task = xTaskGetCurrentTaskHandle();
+    #if configNUMBER_OF_CORES > 1
+    vTaskCoreAffinitySet(NULL, 1u << 0);
+    #endif
+    efd = eventfd(0, 0);
+    run_latency(0);
+    run_latency(4 * GAP_US);
+    run_interrupt();
+    close(efd);
+
+    vTaskDelete(NULL);
+}
+
+int main(int argc, char **argv) {
+    xTaskCreate(init_task, "init", configMINIMAL_STACK_SIZE, NULL, 3, NULL);
+    vTaskStartScheduler();
+    return 1;
+}
@@ -0,0 +1,179 @@
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "morelib/coro.h"
+#include "morelib/evloop.h"
+#include "morelib/mount.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+// Compares the memory used per connection by an echo handler running as a coroutine against one
+// running as a task. Each connection is a pair of pipes, which are allocated before measuring.
+#define NUM_CONNECTIONS 32
+
+struct echo {
+    struct coro co;
+    int in;
+    int out;
+    int len;
+    char buf[16];
+};
+
+static int driver_fds[NUM_CONNECTIONS][2];
+static int handler_fds[NUM_CONNECTIONS][2];
+static atomic_uint num_running;
+static TaskHandle_t driver_task;
+
+static size_t heap_used(void) {
+    return mallinfo().uordblks;
+}
+
+static int open_connections(void) {
+    for (int i = 0; i < NUM_CONNECTIONS; i++) {
+        int in[2], out[2];
+        if ((pipe(in) < 0) || (pipe(out) < 0)) {
+            return -1;
+        }
+        driver_fds[i][0] = in[1];
+        driver_fds[i][1] = out[0];
+        handler_fds[i][0] = in[0];
+        handler_fds[i][1] = out[1];
+    }
+    return 0;
+}
+
+// Sends a byte on every connection, then checks every connection echoed it.
+static int exercise_connections(void) {
+    for (int i = 0; i < NUM_CONNECTIONS; i++) {
+        char c = i;
+        if (write(driver_fds[i][0], &c, 1) != 1) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < NUM_CONNECTIONS; i++) {
+        char c;
+        if ((read(driver_fds[i][1], &c, 1) != 1) || (c != (char)i)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Closes the driver's ends, which makes every handler exit, and waits for them.
+static void close_connections(void) {
+    for (int i = 0; i < NUM_CONNECTIONS; i++) {
+        close(driver_fds[i][0]);
+        close(driver_fds[i][1]);
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+static void handler_exited(void) {
+    if (atomic_fetch_sub(&num_running, 1) == 1) {
+        xTaskNotifyGive(driver_task);
+    }
+}
+
+static int echo_func(struct coro *co) {
+    struct echo *echo = (void *)co;
+    CORO_BEGIN(co);
+    for (;;) {
+        CORO_READ(co, echo->len, echo->in, echo->buf, sizeof(echo->buf));
+        if (echo->len <= 0) {
+            break;
+        }
+        CORO_WRITE(co, echo->len, echo->out, echo->buf, echo->len);
+    }
+    CORO_END(co);
+}
+
+static void echo_done(struct coro *co) {
+    struct echo *echo = (void *)co;
+    close(echo->in);
+    close(echo->out);
+    free(echo);
+    handler_exited();
+}
+
+static void loop_task(void *params) {
+    evloop_run(params);
+    vTaskDelete(NULL);
+}
+
+static struct evloop loop;
+
+static void run_coroutines(void) {
+    evloop_init(&loop);
+    xTaskCreate(loop_task, "loop", configMINIMAL_STACK_SIZE, &loop, 2, NULL);
+
+    open_connections();
+    size_t before = heap_used();
+    for (int i = 0; i < NUM_CONNECTIONS; i++) {
+        struct echo *echo = malloc(sizeof(struct echo));
+        echo->in = handler_fds[i][0];
+        echo->out = handler_fds[i][1];
+        fcntl(echo->in, F_SETFL, O_NONBLOCK);
+        fcntl(echo->out, F_SETFL, O_NONBLOCK);
+        coro_init(&loop, &echo->co, echo_func, echo_done);
+        atomic_fetch_add(&num_running, 1);
+        coro_start(&echo->co);
+    }
+    size_t after = heap_used();
+
+    int ret = exercise_connections();
+    close_connections();
+    evloop_stop(&loop);
+    printf("coroutines: %u bytes per connection (%s)\n", (unsigned)(after - before) / NUM_CONNECTIONS, ret < 0 ? "failed" : "ok");
+}
+
+static void echo_task(void *params) {
+    int *fds = params;
+    char buf[16];
+    for (;;) {
+        int len = read(fds[0], buf, sizeof(buf));
+        if (len <= 0) {
+            break;
+        }
+        write(fds[1], buf, len);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    handler_exited();
+    vTaskDelete(NULL);
+}
+
+static void run_tasks(void) {
+    open_connections();
+    size_t before = heap_used();
+    for (int i = 0; i < NUM_CONNECTIONS; i++) {
+        atomic_fetch_add(&num_running, 1);
+        xTaskCreate(echo_task, "echo", configMINIMAL_STACK_SIZE, handler_fds[i], 2, NULL);
+    }
+    size_t after = heap_used();
+
+    int ret = exercise_connections();
+    close_connections();
+    printf("tasks: %u bytes per connection (%s)\n", (unsigned)(after - before) / NUM_CONNECTIONS, ret < 0 ? "failed" : "ok");
+}
+
+static void init_task(void *params) {
+    mount(NULL, "/dev", "devfs", 1, NULL);
+    int fd = open("/dev/ttyS0", O_RDWR, 0);
+    close(fd);
+
+    driver_task = xTaskGetCurrentTaskHandle();
+    run_coroutines();
+    run_tasks();
+
+    vTaskDelete(NULL);
+}
+
+int main(int argc, char **argv) {
+    xTaskCreate(init_task, "init", configMINIMAL_STACK_SIZE, NULL, 3, NULL);
+    vTaskStartScheduler();
+    return 1;
+}
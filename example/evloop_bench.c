@@ -0,0 +1,203 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "morelib/evloop.h"
+#include "morelib/mount.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+// Compares the round trip time of an event dispatched by evloop against an equivalent poll() loop
+// over the same files. A driver task makes one source readable at a time and waits for the loop's
+// handler to drain it, so the time includes the wake-up and one dispatch. The poll() loop scans every
+// source on each iteration, while evloop only visits the ready handler.
+#define NUM_ITERATIONS 5000
+#define MAX_SOURCES 32
+
+struct source {
+    int read_fd;
+    int write_fd;
+    bool is_pipe;
+};
+
+static struct source sources[MAX_SOURCES];
+static int num_sources;
+static TaskHandle_t driver_task;
+static volatile bool stopping;
+
+static int open_sources(int num, bool is_pipe) {
+    for (num_sources = 0; num_sources < num; num_sources++) {
+        struct source *source = &sources[num_sources];
+        source->is_pipe = is_pipe;
+        if (is_pipe) {
+            int fds[2];
+            if (pipe(fds) < 0) {
+                return -1;
+            }
+            source->read_fd = fds[0];
+            source->write_fd = fds[1];
+        }
+        else {
+            source->read_fd = eventfd(0, 0);
+            if (source->read_fd < 0) {
+                return -1;
+            }
+            source->write_fd = source->read_fd;
+        }
+    }
+    return 0;
+}
+
+static void close_sources(void) {
+    for (int i = 0; i < num_sources; i++) {
+        close(sources[i].read_fd);
+        if (sources[i].is_pipe) {
+            close(sources[i].write_fd);
+        }
+    }
+    num_sources = 0;
+}
+
+static void source_signal(struct source *source) {
+    uint64_t value = 1;
+    if (source->is_pipe) {
+        write(source->write_fd, &value, 1);
+    }
+    else {
+        write(source->write_fd, &value, sizeof(value));
+    }
+}
+
+static void source_drain(struct source *source) {
+    uint64_t value;
+    read(source->read_fd, &value, source->is_pipe ? 1 : sizeof(value));
+    if (!stopping) {
+        xTaskNotifyGive(driver_task);
+    }
+}
+
+// Signals sources round robin and waits for each to be handled. Returns the mean round trip in
+// microseconds.
+static double drive(void) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        source_signal(&sources[i % num_sources]);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+    return elapsed / NUM_ITERATIONS;
+}
+
+
+// evloop
+static struct evloop loop;
+static struct evloop_watch watches[MAX_SOURCES];
+
+static void watch_cb(struct evloop_watch *watch, int fd, uint revents) {
+    source_drain(watch->arg);
+}
+
+static void evloop_task(void *params) {
+    evloop_run(&loop);
+    for (int i = 0; i < num_sources; i++) {
+        evloop_watch_stop(&watches[i]);
+    }
+    xTaskNotifyGive(driver_task);
+    vTaskDelete(NULL);
+}
+
+static double run_evloop(void) {
+    evloop_init(&loop);
+    for (int i = 0; i < num_sources; i++) {
+        evloop_watch_start(&loop, &watches[i], sources[i].read_fd, POLLIN, watch_cb, &sources[i]);
+    }
+    xTaskCreate(evloop_task, "evloop", configMINIMAL_STACK_SIZE, NULL, 2, NULL);
+
+    double us = drive();
+
+    evloop_stop(&loop);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    evloop_deinit(&loop);
+    return us;
+}
+
+
+// poll()
+static void poll_task(void *params) {
+    struct pollfd fds[MAX_SOURCES];
+    for (int i = 0; i < num_sources; i++) {
+        fds[i].fd = sources[i].read_fd;
+        fds[i].events = POLLIN;
+    }
+    while (!stopping) {
+        if (poll(fds, num_sources, -1) < 0) {
+            break;
+        }
+        for (int i = 0; i < num_sources; i++) {
+            if (fds[i].revents & POLLIN) {
+                source_drain(&sources[i]);
+            }
+        }
+    }
+    xTaskNotifyGive(driver_task);
+    vTaskDelete(NULL);
+}
+
+static double run_poll(void) {
+    stopping = false;
+    xTaskCreate(poll_task, "poll", configMINIMAL_STACK_SIZE, NULL, 2, NULL);
+
+    double us = drive();
+
+    // The task may be blocked in poll, so a last signal wakes it to see the flag.
+    stopping = true;
+    source_signal(&sources[0]);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return us;
+}
+
+static void run(int num, bool is_pipe) {
+    const char *kind = is_pipe ? "pipe" : "eventfd";
+    if (open_sources(num, is_pipe) < 0) {
+        printf("%-8s %3d: failed to open sources\n", kind, num);
+        close_sources();
+        return;
+    }
+    double evloop_us = run_evloop();
+    double poll_us = run_poll();
+    printf("%-8s %3d   %8.2f %8.2f\n", kind, num, evloop_us, poll_us);
+    close_sources();
+}
+
+static void init_task(void *params) {
+    mount(NULL, "/dev", "devfs", 1, NULL);
+    int fd = open("/dev/ttyS0", O_RDWR, 0);
+    close(fd);
+
+    driver_task = xTaskGetCurrentTaskHandle();
+    printf("%-8s %3s   %8s %8s  (us per event)\n", "source", "n", "evloop", "poll");
+    static const int counts[] = { 1, 8, 16, 32 };
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        run(counts[i], false);
+    }
+    // Each pipe takes two descriptors.
+    for (size_t i = 0; i < 3; i++) {
+        run(counts[i], true);
+    }
+
+    vTaskDelete(NULL);
+}
+
+int main(int argc, char **argv) {
+    xTaskCreate(init_task, "init", configMINIMAL_STACK_SIZE, NULL, 3, NULL);
+    vTaskStartScheduler();
+    return 1;
+}
@@ -0,0 +1,85 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/lock.h>
+#include <time.h>
+#include <unistd.h>
+#include "morelib/mount.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+
+// Compares pthread mutexes and libc locks against FreeRTOS mutexes, with and without contention.
+#define NUM_ITERATIONS 100000
+
+static pthread_mutex_t pthread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static SemaphoreHandle_t freertos_mutex;
+static _LOCK_T libc_lock;
+static volatile unsigned counter;
+
+static void *pthread_worker(void *arg) {
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        pthread_mutex_lock(&pthread_mutex);
+        counter++;
+        pthread_mutex_unlock(&pthread_mutex);
+    }
+    return NULL;
+}
+
+static void *freertos_worker(void *arg) {
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        xSemaphoreTake(freertos_mutex, portMAX_DELAY);
+        counter++;
+        xSemaphoreGive(freertos_mutex);
+    }
+    return NULL;
+}
+
+static void *libc_worker(void *arg) {
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+        __retarget_lock_acquire_recursive(libc_lock);
+        counter++;
+        __retarget_lock_release_recursive(libc_lock);
+    }
+    return NULL;
+}
+
+static void run(const char *name, void *(*worker)(void *), int num_threads) {
+    pthread_t threads[num_threads];
+    struct timespec start, end;
+    counter = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&threads[i], NULL, worker, NULL);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long long ns = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+    printf("%s, %d threads: %lld ns per lock (count %u)\n", name, num_threads, ns / (num_threads * NUM_ITERATIONS), counter);
+}
+
+static void init_task(void *params) {
+    mount(NULL, "/dev", "devfs", 1, NULL);
+    int fd = open("/dev/ttyS0", O_RDWR, 0);
+    close(fd);
+
+    freertos_mutex = xSemaphoreCreateMutex();
+    __retarget_lock_init_recursive(&libc_lock);
+    for (int num_threads = 1; num_threads <= 4; num_threads *= 2) {
+        run("pthread_mutex", pthread_worker, num_threads);
+        run("FreeRTOS mutex", freertos_worker, num_threads);
+        run("libc lock", libc_worker, num_threads);
+    }
+
+    vTaskDelete(NULL);
+}
+
+int main(int argc, char **argv) {
+    xTaskCreate(init_task, "init", configMINIMAL_STACK_SIZE, NULL, 3, NULL);
+    vTaskStartScheduler();
+    return 1;
+}
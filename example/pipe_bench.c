@@ -0,0 +1,95 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "morelib/fcntl.h"
+#include "morelib/mount.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+// Measures the throughput of a pipe between two tasks at several buffer sizes set with
+// F_SETPIPE_SZ, for small and large writes. A larger buffer lets the writer run further ahead of the
+// reader, so the tasks switch less often.
+#define TOTAL_BYTES (1024 * 1024)
+#define MAX_CHUNK 4096
+
+static char write_buf[MAX_CHUNK];
+static char read_buf[MAX_CHUNK];
+static TaskHandle_t reader_task;
+
+struct writer_params {
+    int fd;
+    int chunk;
+};
+
+static void writer_task(void *params) {
+    struct writer_params *writer = params;
+    size_t total = 0;
+    while (total < TOTAL_BYTES) {
+        int ret = write(writer->fd, write_buf, writer->chunk);
+        if (ret <= 0) {
+            break;
+        }
+        total += ret;
+    }
+    close(writer->fd);
+    xTaskNotifyGive(reader_task);
+    vTaskDelete(NULL);
+}
+
+static void run(int size, int chunk) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        printf("%6d %6d: pipe failed\n", size, chunk);
+        return;
+    }
+    if (fcntl(fds[1], F_SETPIPE_SZ, size) < 0) {
+        printf("%6d %6d: F_SETPIPE_SZ failed\n", size, chunk);
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    int actual_size = fcntl(fds[1], F_GETPIPE_SZ);
+
+    struct writer_params writer = { fds[1], chunk };
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    xTaskCreate(writer_task, "writer", configMINIMAL_STACK_SIZE, &writer, uxTaskPriorityGet(NULL), NULL);
+    size_t total = 0;
+    int ret;
+    while ((ret = read(fds[0], read_buf, sizeof(read_buf))) > 0) {
+        total += ret;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    close(fds[0]);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%6d %6d %10.0f%s\n", actual_size, chunk, total / elapsed, total == TOTAL_BYTES ? "" : " (short)");
+}
+
+static void init_task(void *params) {
+    mount(NULL, "/dev", "devfs", 1, NULL);
+    int fd = open("/dev/ttyS0", O_RDWR, 0);
+    close(fd);
+
+    reader_task = xTaskGetCurrentTaskHandle();
+    printf("%6s %6s %10s\n", "size", "write", "bytes/s");
+    static const int sizes[] = { 512, 1024, 4096, 16384 };
+    static const int chunks[] = { 64, MAX_CHUNK };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (size_t j = 0; j < sizeof(chunks) / sizeof(chunks[0]); j++) {
+            run(sizes[i], chunks[j]);
+        }
+    }
+
+    vTaskDelete(NULL);
+}
+
+int main(int argc, char **argv) {
+    xTaskCreate(init_task, "init", configMINIMAL_STACK_SIZE, NULL, 3, NULL);
+    vTaskStartScheduler();
+    return 1;
+}
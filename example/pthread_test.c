@@ -0,0 +1,113 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "test.h"
+
+
+// Checks pthread thread-specific data, in particular that a key re-created after pthread_key_delete
+// starts out NULL in every thread and never sees the values stored under the deleted key.
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static int step;
+static pthread_key_t key;
+static int destructor_calls;
+static void *destructor_value;
+static int stale_value;
+static int thread_value;
+
+static void destructor(void *value) {
+    destructor_calls++;
+    destructor_value = value;
+}
+
+static void wait_step(int value) {
+    pthread_mutex_lock(&mutex);
+    while (step < value) {
+        pthread_cond_wait(&cond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+static void set_step(int value) {
+    pthread_mutex_lock(&mutex);
+    step = value;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+static void *basic_thread(void *arg) {
+    // A new thread starts with NULL for every key.
+    CHECK(pthread_getspecific(key) == NULL);
+    CHECK(pthread_setspecific(key, &thread_value) == 0);
+    CHECK(pthread_getspecific(key) == &thread_value);
+    return NULL;
+}
+
+static void test_basic(void) {
+    CHECK(pthread_key_create(&key, destructor) == 0);
+    CHECK(pthread_getspecific(key) == NULL);
+    CHECK(pthread_setspecific(key, &stale_value) == 0);
+    CHECK(pthread_getspecific(key) == &stale_value);
+
+    destructor_calls = 0;
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, basic_thread, NULL) == 0);
+    CHECK(pthread_join(thread, NULL) == 0);
+    // The destructor runs once at thread exit, with that thread's value only.
+    CHECK((destructor_calls == 1) && (destructor_value == &thread_value));
+    CHECK(pthread_getspecific(key) == &stale_value);
+
+    CHECK(pthread_setspecific(key, NULL) == 0);
+    CHECK(pthread_key_delete(key) == 0);
+    CHECK(pthread_key_delete(key) == EINVAL);
+}
+
+static void *recreate_thread(void *arg) {
+    CHECK(pthread_setspecific(key, &stale_value) == 0);
+    set_step(1);
+    wait_step(2);
+    // key now names the re-created key, which must not see the value stored under the old one.
+    CHECK(pthread_getspecific(key) == NULL);
+    return NULL;
+}
+
+static void test_recreate(void) {
+    step = 0;
+    CHECK(pthread_key_create(&key, NULL) == 0);
+    CHECK(pthread_setspecific(key, &stale_value) == 0);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, recreate_thread, NULL) == 0);
+    wait_step(1);
+
+    pthread_key_t old_key = key;
+    CHECK(pthread_key_delete(old_key) == 0);
+    CHECK(pthread_key_create(&key, destructor) == 0);
+    if (key != old_key) {
+        printf("pthread_test: key not reused, stale values not exercised\n");
+    }
+    CHECK(pthread_getspecific(key) == NULL);
+
+    destructor_calls = 0;
+    set_step(2);
+    CHECK(pthread_join(thread, NULL) == 0);
+    // The thread exited still holding a value under the deleted key; the new key's destructor must
+    // not be called with it.
+    CHECK(destructor_calls == 0);
+
+    CHECK(pthread_setspecific(key, &thread_value) == 0);
+    CHECK(pthread_getspecific(key) == &thread_value);
+    CHECK(pthread_key_delete(key) == 0);
+}
+
+static void run_tests(void) {
+    test_basic();
+    test_recreate();
+}
+
+int main(int argc, char **argv) {
+    return test_main("pthread_test", run_tests);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "morelib/mount.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+// Scaffolding shared by the test programs. CHECK reports a failed condition and counts it. Checks may
+// run on several threads at once, so the count is atomic. test_main starts the scheduler with an init
+// task that opens the console, runs the tests, and prints a PASS or FAIL summary.
+static atomic_int num_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s (errno %d)\n", __func__, __LINE__, #cond, errno); \
+            atomic_fetch_add(&num_failures, 1); \
+        } \
+} \
+    while (0)
+
+static const char *test_name;
+static void (*test_run)(void);
+
+static void test_init_task(void *params) {
+    mount(NULL, "/dev", "devfs", 1, NULL);
+    int fd = open("/dev/ttyS0", O_RDWR, 0);
+    close(fd);
+
+    test_run();
+    int failures = atomic_load(&num_failures);
+    printf("%s: %s (%d failures)\n", test_name, failures ? "FAIL" : "PASS", failures);
+
+    vTaskDelete(NULL);
+}
+
+static int test_main(const char *name, void (*run)(void)) {
+    test_name = name;
+    test_run = run;
+    xTaskCreate(test_init_task, "init", configMINIMAL_STACK_SIZE, NULL, 3, NULL);
+    vTaskStartScheduler();
+    return 1;
+}
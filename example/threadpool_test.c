@@ -0,0 +1,171 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "morelib/threadpool.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "test.h"
+
+
+// Checks that jobs submitted from several threads each run exactly once, that a job's completion fd
+// becomes readable, that a queued job can be cancelled, and that shutting down a pool runs the jobs
+// still queued.
+#define NUM_SUBMITTERS 4
+#define JOBS_PER_SUBMITTER 64
+#define NUM_JOBS (NUM_SUBMITTERS * JOBS_PER_SUBMITTER)
+#define WORKERS_PER_CORE 2
+#define NUM_WORKERS (WORKERS_PER_CORE * configNUMBER_OF_CORES)
+
+static struct threadpool pool;
+static struct threadpool_job jobs[NUM_JOBS];
+static atomic_uint runs[NUM_JOBS];
+
+static void *count_job(void *arg) {
+    atomic_fetch_add(&runs[(uintptr_t)arg], 1);
+    return arg;
+}
+
+static void reset_runs(void) {
+    for (int i = 0; i < NUM_JOBS; i++) {
+        atomic_store(&runs[i], 0);
+    }
+}
+
+static void *submitter(void *arg) {
+    int base = (uintptr_t)arg * JOBS_PER_SUBMITTER;
+    for (int i = base; i < base + JOBS_PER_SUBMITTER; i++) {
+        threadpool_job_init(&jobs[i], count_job, (void *)(uintptr_t)i);
+        CHECK(threadpool_submit(&pool, &jobs[i]) == 0);
+    }
+    for (int i = base; i < base + JOBS_PER_SUBMITTER; i++) {
+        void *result = NULL;
+        CHECK(threadpool_job_wait(&jobs[i], &result, portMAX_DELAY) == 0);
+        CHECK(result == (void *)(uintptr_t)i);
+    }
+    return NULL;
+}
+
+static void test_submitters(void) {
+    reset_runs();
+    pthread_t threads[NUM_SUBMITTERS];
+    for (uintptr_t i = 0; i < NUM_SUBMITTERS; i++) {
+        CHECK(pthread_create(&threads[i], NULL, submitter, (void *)i) == 0);
+    }
+    for (int i = 0; i < NUM_SUBMITTERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    int wrong = 0;
+    for (int i = 0; i < NUM_JOBS; i++) {
+        wrong += atomic_load(&runs[i]) != 1;
+    }
+    CHECK(wrong == 0);
+}
+
+static void test_job_fd(void) {
+    reset_runs();
+    struct threadpool_job job;
+    threadpool_job_init(&job, count_job, (void *)0);
+    int fd = threadpool_job_fd(&job);
+    CHECK(fd >= 0);
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    CHECK(poll(&pfd, 1, 0) == 0);
+
+    // The fd is readable once the job completes, and again after each resubmission.
+    for (int i = 1; i <= 2; i++) {
+        CHECK(threadpool_submit(&pool, &job) == 0);
+        CHECK(poll(&pfd, 1, 1000) == 1);
+        CHECK(pfd.revents & POLLIN);
+        uint64_t value = 0;
+        CHECK(read(fd, &value, sizeof(value)) == sizeof(value));
+        CHECK(value == 1);
+        CHECK(threadpool_job_wait(&job, NULL, 0) == 0);
+        CHECK(atomic_load(&runs[0]) == i);
+    }
+    close(fd);
+    threadpool_job_deinit(&job);
+}
+
+static struct threadpool_job blockers[NUM_WORKERS];
+static atomic_uint num_blocked;
+static volatile bool release_blocked;
+
+static void *block_job(void *arg) {
+    atomic_fetch_add(&num_blocked, 1);
+    while (!release_blocked) {
+        vTaskDelay(1);
+    }
+    return NULL;
+}
+
+// Occupies every worker so that later jobs stay queued.
+static void block_workers(void) {
+    atomic_store(&num_blocked, 0);
+    release_blocked = false;
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        threadpool_job_init(&blockers[i], block_job, NULL);
+        CHECK(threadpool_submit(&pool, &blockers[i]) == 0);
+    }
+    while (atomic_load(&num_blocked) < NUM_WORKERS) {
+        vTaskDelay(1);
+    }
+}
+
+static void test_cancel(void) {
+    reset_runs();
+    block_workers();
+
+    struct threadpool_job job;
+    threadpool_job_init(&job, count_job, (void *)0);
+    CHECK(threadpool_submit(&pool, &job) == 0);
+    CHECK(threadpool_submit(&pool, &job) < 0);
+    CHECK(errno == EBUSY);
+    CHECK(threadpool_cancel(&job) == 0);
+    CHECK(threadpool_job_wait(&job, NULL, 0) < 0);
+    CHECK(errno == EINVAL);
+
+    release_blocked = true;
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        CHECK(threadpool_job_wait(&blockers[i], NULL, portMAX_DELAY) == 0);
+    }
+    CHECK(atomic_load(&runs[0]) == 0);
+}
+
+static void test_shutdown(void) {
+    reset_runs();
+    block_workers();
+    for (int i = 0; i < NUM_JOBS; i++) {
+        threadpool_job_init(&jobs[i], count_job, (void *)(uintptr_t)i);
+        CHECK(threadpool_submit(&pool, &jobs[i]) == 0);
+    }
+    release_blocked = true;
+
+    // Shutting down runs every job still queued, then stops the workers.
+    threadpool_deinit(&pool);
+    int wrong = 0;
+    for (int i = 0; i < NUM_JOBS; i++) {
+        wrong += (atomic_load(&runs[i]) != 1) || (atomic_load(&jobs[i].state) != THREADPOOL_JOB_DONE);
+    }
+    CHECK(wrong == 0);
+
+    struct threadpool_job job;
+    threadpool_job_init(&job, count_job, (void *)0);
+    CHECK(threadpool_submit(&pool, &job) < 0);
+    CHECK(errno == ESHUTDOWN);
+}
+
+static void run_tests(void) {
+    CHECK(threadpool_init(&pool, WORKERS_PER_CORE, configMINIMAL_STACK_SIZE, 2) == 0);
+    test_submitters();
+    test_job_fd();
+    test_cancel();
+    test_shutdown();
+}
+
+int main(int argc, char **argv) {
+    return test_main("threadpool_test", run_tests);
+}
@@ -0,0 +1,213 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "morelib/unix.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "test.h"
+
+
+// Checks AF_UNIX stream and datagram sockets, SCM_RIGHTS passing, and what happens when a peer
+// closes.
+const struct socket_family *socket_families[] = {
+    &unix_af,
+};
+
+const size_t socket_num_families = sizeof(socket_families) / sizeof(socket_families[0]);
+
+static socklen_t make_address(struct sockaddr_un *address, const char *path) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strncpy(address->sun_path, path, sizeof(address->sun_path) - 1);
+    return sizeof(*address);
+}
+
+// recv ignores flags, so MSG_DONTWAIT goes through recvmsg.
+static int recv_nowait(int socket, void *buf, size_t len) {
+    struct iovec iov = { .iov_base = buf, .iov_len = len };
+    struct msghdr message = { .msg_iov = &iov, .msg_iovlen = 1 };
+    return recvmsg(socket, &message, MSG_DONTWAIT);
+}
+
+static void test_stream_pair(void) {
+    int fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    char buf[16];
+    CHECK(send(fds[0], "hello", 5, 0) == 5);
+    CHECK(send(fds[0], "world", 5, 0) == 5);
+    // A stream has no message boundaries.
+    CHECK(recv(fds[1], buf, sizeof(buf), 0) == 10);
+    CHECK(memcmp(buf, "helloworld", 10) == 0);
+    CHECK(send(fds[1], "x", 1, 0) == 1);
+    CHECK((recv(fds[0], buf, sizeof(buf), 0) == 1) && (buf[0] == 'x'));
+    CHECK(shutdown(fds[0], SHUT_WR) == 0);
+    CHECK(recv(fds[1], buf, sizeof(buf), 0) == 0);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_stream_listen(void) {
+    struct sockaddr_un address;
+    socklen_t address_len = make_address(&address, "/unix_test.stream");
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(server >= 0);
+    CHECK(bind(server, (struct sockaddr *)&address, address_len) == 0);
+    CHECK(listen(server, 1) == 0);
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(connect(client, (struct sockaddr *)&address, address_len) == 0);
+    int conn = accept(server, NULL, NULL);
+    CHECK(conn >= 0);
+
+    char buf[8];
+    CHECK(send(client, "ping", 4, 0) == 4);
+    CHECK((recv(conn, buf, sizeof(buf), 0) == 4) && !memcmp(buf, "ping", 4));
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    CHECK(getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0);
+
+    int other = socket(AF_UNIX, SOCK_STREAM, 0);
+    CHECK(bind(other, (struct sockaddr *)&address, address_len) < 0);
+    CHECK(errno == EADDRINUSE);
+    close(other);
+    close(conn);
+    close(client);
+    close(server);
+}
+
+static void test_dgram(void) {
+    struct sockaddr_un address1, address2, from;
+    socklen_t address1_len = make_address(&address1, "/unix_test.dgram1");
+    socklen_t address2_len = make_address(&address2, "/unix_test.dgram2");
+    int sock1 = socket(AF_UNIX, SOCK_DGRAM, 0);
+    int sock2 = socket(AF_UNIX, SOCK_DGRAM, 0);
+    CHECK(bind(sock1, (struct sockaddr *)&address1, address1_len) == 0);
+    CHECK(bind(sock2, (struct sockaddr *)&address2, address2_len) == 0);
+
+    CHECK(sendto(sock1, "one", 3, 0, (struct sockaddr *)&address2, address2_len) == 3);
+    CHECK(sendto(sock1, "three", 5, 0, (struct sockaddr *)&address2, address2_len) == 5);
+    char buf[16];
+    memset(&from, 0, sizeof(from));
+    socklen_t from_len = sizeof(from);
+    // Each datagram is received whole and on its own.
+    CHECK(recvfrom(sock2, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len) == 3);
+    CHECK(!memcmp(buf, "one", 3) && !strcmp(from.sun_path, "/unix_test.dgram1"));
+    CHECK(recv(sock2, buf, sizeof(buf), 0) == 5);
+    CHECK(!memcmp(buf, "three", 5));
+    CHECK(recv_nowait(sock2, buf, sizeof(buf)) < 0);
+    CHECK(errno == EAGAIN);
+
+    int pair[2];
+    CHECK(socketpair(AF_UNIX, SOCK_DGRAM, 0, pair) == 0);
+    CHECK(send(pair[0], "ab", 2, 0) == 2);
+    CHECK(send(pair[0], "cd", 2, 0) == 2);
+    CHECK((recv(pair[1], buf, 1, 0) == 1) && (buf[0] == 'a'));
+    // The rest of a truncated datagram is discarded.
+    CHECK((recv(pair[1], buf, sizeof(buf), 0) == 2) && (buf[0] == 'c'));
+    close(pair[0]);
+    close(pair[1]);
+    close(sock1);
+    close(sock2);
+}
+
+static int send_fds(int socket, const int *fds, int num_fds, size_t cmsg_len) {
+    char control[CMSG_SPACE(4 * sizeof(int))] = { 0 };
+    char c = 'r';
+    struct iovec iov = { .iov_base = &c, .iov_len = 1 };
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = CMSG_SPACE(num_fds * sizeof(int)),
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = cmsg_len;
+    memcpy(CMSG_DATA(cmsg), fds, num_fds * sizeof(int));
+    return sendmsg(socket, &message, 0);
+}
+
+static void test_rights(void) {
+    int pair[2], pipe_fds[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    CHECK(pipe(pipe_fds) == 0);
+
+    CHECK(send_fds(pair[0], &pipe_fds[0], 1, CMSG_LEN(sizeof(int))) == 1);
+    // The sender's descriptor can be closed once the file is in flight.
+    close(pipe_fds[0]);
+
+    char c;
+    char control[CMSG_SPACE(4 * sizeof(int))];
+    struct iovec iov = { .iov_base = &c, .iov_len = 1 };
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    CHECK(recvmsg(pair[1], &message, 0) == 1);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    CHECK(cmsg && (cmsg->cmsg_type == SCM_RIGHTS) && (cmsg->cmsg_len == CMSG_LEN(sizeof(int))));
+    if (cmsg) {
+        int fd;
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        char buf[4];
+        CHECK(write(pipe_fds[1], "fd", 2) == 2);
+        CHECK((read(fd, buf, sizeof(buf)) == 2) && !memcmp(buf, "fd", 2));
+        close(fd);
+    }
+
+    // A control message whose length runs past the control buffer is rejected.
+    CHECK(send_fds(pair[0], &pipe_fds[1], 1, CMSG_LEN(4 * sizeof(int)) + 64) < 0);
+    CHECK(errno == EINVAL);
+    CHECK(send_fds(pair[0], &pipe_fds[1], 1, CMSG_LEN(0) - 1) < 0);
+    CHECK(errno == EINVAL);
+    CHECK(recv_nowait(pair[1], &c, 1) < 0);
+    CHECK(errno == EAGAIN);
+
+    close(pipe_fds[1]);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+static void test_peer_close(void) {
+    int fds[2];
+    char buf[8];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    CHECK(send(fds[0], "bye", 3, 0) == 3);
+    close(fds[0]);
+    // Data sent before the close is still delivered, then end of file.
+    CHECK(recv(fds[1], buf, sizeof(buf), 0) == 3);
+    CHECK(recv(fds[1], buf, sizeof(buf), 0) == 0);
+    CHECK(send(fds[1], "x", 1, 0) < 0);
+    CHECK(errno == EPIPE);
+    close(fds[1]);
+
+    // A socket in flight whose other end closes is released with the message that carries it.
+    int pair[2], inner[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, inner) == 0);
+    CHECK(send_fds(pair[0], &inner[0], 1, CMSG_LEN(sizeof(int))) == 1);
+    close(inner[0]);
+    close(pair[0]);
+    close(pair[1]);
+    CHECK(recv(inner[1], buf, sizeof(buf), 0) == 0);
+    close(inner[1]);
+}
+
+static void run_tests(void) {
+    test_stream_pair();
+    test_stream_listen();
+    test_dgram();
+    test_rights();
+    test_peer_close();
+}
+
+int main(int argc, char **argv) {
+    return test_main("unix_test", run_tests);
+}
@@ -1,14 +1,21 @@
 // SPDX-FileCopyrightText: 2023 Gregory Neverov
 // SPDX-License-Identifier: MIT
 
+#include <errno.h>
 #include <malloc.h>
+#include "freertos/mem_pressure.h"
+#include "freertos/slab.h"
 
 #include "FreeRTOS.h"
 
 
 void *pvPortMalloc(size_t xWantedSize) {
     void *pvReturn = NULL;
-    pvReturn = malloc(xWantedSize);
+    pvReturn = slab_malloc(xWantedSize);
+    while ((pvReturn == NULL) && mem_pressure_reclaim(xWantedSize)) {
+        pvReturn = slab_malloc(xWantedSize);
+    }
+    mem_pressure_poll();
     configASSERT(((intptr_t)pvReturn & portBYTE_ALIGNMENT_MASK) == 0);
 
     #if (configUSE_MALLOC_FAILED_HOOK == 1)
@@ -24,7 +31,7 @@ void *pvPortMalloc(size_t xWantedSize) {
 /*-----------------------------------------------------------*/
 
 void vPortFree(void *pv) {
-    free(pv);
+    slab_free(pv);
 }
 /*-----------------------------------------------------------*/
 
@@ -35,8 +42,17 @@ size_t xPortGetFreeHeapSize(void) {
 /*-----------------------------------------------------------*/
 
 void *pvPortCalloc(size_t xNum, size_t xSize) {
+    size_t xWantedSize;
+    if (__builtin_mul_overflow(xNum, xSize, &xWantedSize)) {
+        errno = ENOMEM;
+        return NULL;
+    }
     void *pvReturn = NULL;
-    pvReturn = calloc(xNum, xSize);
+    pvReturn = slab_calloc(xNum, xSize);
+    while ((pvReturn == NULL) && mem_pressure_reclaim(xWantedSize)) {
+        pvReturn = slab_calloc(xNum, xSize);
+    }
+    mem_pressure_poll();
     configASSERT(((intptr_t)pvReturn & portBYTE_ALIGNMENT_MASK) == 0);
 
     #if (configUSE_MALLOC_FAILED_HOOK == 1)
@@ -0,0 +1,342 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/lock.h>
+#include <unistd.h>
+#include "freertos/heap_trace.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+// A free chunk of picolibc's malloc. The size includes the chunk header.
+struct heap_chunk {
+    size_t size;
+    struct heap_chunk *next;
+};
+
+extern struct heap_chunk *__malloc_free_list;
+extern char __heap_end[];
+
+void heap_get_info(struct heap_info *info) {
+    __retarget_lock_acquire_recursive(&__lock___libc_recursive_mutex);
+    // Memory between the break and the end of the heap is free, and malloc can claim it with sbrk.
+    size_t tail = __heap_end - (char *)sbrk(0);
+    info->total_free = tail;
+    info->largest_free = tail;
+    info->num_free_blocks = tail ? 1 : 0;
+    for (struct heap_chunk *chunk = __malloc_free_list; chunk; chunk = chunk->next) {
+        info->total_free += chunk->size;
+        if (chunk->size > info->largest_free) {
+            info->largest_free = chunk->size;
+        }
+        info->num_free_blocks++;
+    }
+    __retarget_lock_release_recursive(&__lock___libc_recursive_mutex);
+    info->fragmentation = info->total_free ? 100 - (uint64_t)info->largest_free * 100 / info->total_free : 0;
+}
+
+static_assert((HEAP_TRACE_MAX_ENTRIES & (HEAP_TRACE_MAX_ENTRIES - 1)) == 0);
+static_assert(HEAP_TRACE_MAX_TAGS <= 256);
+
+struct heap_trace_tag {
+    const char *name;
+    size_t bytes;
+    size_t peak_bytes;
+    size_t count;
+};
+
+// Tags are protected by critical section.
+static struct heap_trace_tag heap_trace_tags[HEAP_TRACE_MAX_TAGS] = { { "untagged" } };
+static uint heap_trace_num_tags = 1;
+static uint32_t heap_trace_seq;
+static size_t heap_trace_num_untracked;
+
+// Tag of the current task's allocations
+static _Thread_local uint8_t heap_trace_current_tag;
+
+#if HEAP_TRACE
+struct heap_trace_entry {
+    void *ptr;                          // NULL if the entry is unused
+    void *caller;
+    uint32_t size : 24;
+    uint32_t tag : 8;
+    uint32_t seq;
+    TickType_t time;
+};
+
+// The table is protected by critical section.
+static struct heap_trace_entry heap_trace_entries[HEAP_TRACE_MAX_ENTRIES];
+static uint heap_trace_num_entries;
+
+// Whether the current task is inside a wrapped call, whose own calls to malloc are not recorded
+static _Thread_local uint8_t heap_trace_depth;
+
+static uint heap_trace_hash(void *ptr) {
+    return (((uintptr_t)ptr >> 3) * 2654435761u) & (HEAP_TRACE_MAX_ENTRIES - 1);
+}
+
+// Returns the entry of a pointer, or the unused entry where it would go. Must be called in a critical section.
+static struct heap_trace_entry *heap_trace_find(void *ptr) {
+    uint i = heap_trace_hash(ptr);
+    while (heap_trace_entries[i].ptr && (heap_trace_entries[i].ptr != ptr)) {
+        i = (i + 1) & (HEAP_TRACE_MAX_ENTRIES - 1);
+    }
+    return &heap_trace_entries[i];
+}
+
+static void heap_trace_add(void *ptr, size_t size, void *caller) {
+    if (!ptr || heap_trace_depth) {
+        return;
+    }
+    uint tag = heap_trace_current_tag;
+    taskENTER_CRITICAL();
+    struct heap_trace_entry *entry = heap_trace_find(ptr);
+    if (entry->ptr || (heap_trace_num_entries >= HEAP_TRACE_MAX_ENTRIES / 8 * 7) || (size >= (1u << 24))) {
+        heap_trace_num_untracked++;
+        taskEXIT_CRITICAL();
+        return;
+    }
+    entry->ptr = ptr;
+    entry->caller = caller;
+    entry->size = size;
+    entry->tag = tag;
+    entry->seq = ++heap_trace_seq;
+    entry->time = xTaskGetTickCount();
+    heap_trace_num_entries++;
+    struct heap_trace_tag *t = &heap_trace_tags[tag];
+    t->bytes += size;
+    t->count++;
+    if (t->bytes > t->peak_bytes) {
+        t->peak_bytes = t->bytes;
+    }
+    taskEXIT_CRITICAL();
+}
+
+// Removes the entry of a pointer. Returns whether there was one, and copies it to removed.
+static bool heap_trace_remove(void *ptr, struct heap_trace_entry *removed) {
+    if (!ptr || heap_trace_depth) {
+        return false;
+    }
+    taskENTER_CRITICAL();
+    struct heap_trace_entry *entry = heap_trace_find(ptr);
+    if (!entry->ptr) {
+        taskEXIT_CRITICAL();
+        return false;
+    }
+    *removed = *entry;
+    struct heap_trace_tag *t = &heap_trace_tags[entry->tag];
+    t->bytes -= entry->size;
+    t->count--;
+    heap_trace_num_entries--;
+
+    // Shift back later entries of the probe sequence that would no longer be found.
+    uint i = entry - heap_trace_entries;
+    uint j = i;
+    for (;;) {
+        j = (j + 1) & (HEAP_TRACE_MAX_ENTRIES - 1);
+        if (!heap_trace_entries[j].ptr) {
+            break;
+        }
+        uint k = heap_trace_hash(heap_trace_entries[j].ptr);
+        bool in_place = (i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j));
+        if (!in_place) {
+            heap_trace_entries[i] = heap_trace_entries[j];
+            i = j;
+        }
+    }
+    heap_trace_entries[i].ptr = NULL;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+// Puts back an entry removed by heap_trace_remove.
+static void heap_trace_restore(const struct heap_trace_entry *removed) {
+    taskENTER_CRITICAL();
+    struct heap_trace_entry *entry = heap_trace_find(removed->ptr);
+    if (!entry->ptr) {
+        *entry = *removed;
+        heap_trace_num_entries++;
+        heap_trace_tags[removed->tag].bytes += removed->size;
+        heap_trace_tags[removed->tag].count++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_memalign(size_t alignment, size_t size);
+void *__real_aligned_alloc(size_t alignment, size_t size);
+int __real_posix_memalign(void **memptr, size_t alignment, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+    heap_trace_depth++;
+    void *ptr = __real_malloc(size);
+    heap_trace_depth--;
+    heap_trace_add(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *__wrap_calloc(size_t num, size_t size) {
+    heap_trace_depth++;
+    void *ptr = __real_calloc(num, size);
+    heap_trace_depth--;
+    heap_trace_add(ptr, num * size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    // Remove the old entry first, since once realloc frees the old block another task may get it.
+    struct heap_trace_entry removed;
+    bool was_traced = heap_trace_remove(ptr, &removed);
+    heap_trace_depth++;
+    void *new_ptr = __real_realloc(ptr, size);
+    heap_trace_depth--;
+    if (new_ptr) {
+        heap_trace_add(new_ptr, size, __builtin_return_address(0));
+    } else if (was_traced && size) {
+        heap_trace_restore(&removed);
+    }
+    return new_ptr;
+}
+
+void *__wrap_memalign(size_t alignment, size_t size) {
+    heap_trace_depth++;
+    void *ptr = __real_memalign(alignment, size);
+    heap_trace_depth--;
+    heap_trace_add(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+void *__wrap_aligned_alloc(size_t alignment, size_t size) {
+    heap_trace_depth++;
+    void *ptr = __real_aligned_alloc(alignment, size);
+    heap_trace_depth--;
+    heap_trace_add(ptr, size, __builtin_return_address(0));
+    return ptr;
+}
+
+int __wrap_posix_memalign(void **memptr, size_t alignment, size_t size) {
+    heap_trace_depth++;
+    int ret = __real_posix_memalign(memptr, alignment, size);
+    heap_trace_depth--;
+    if (ret == 0) {
+        heap_trace_add(*memptr, size, __builtin_return_address(0));
+    }
+    return ret;
+}
+
+void __wrap_free(void *ptr) {
+    struct heap_trace_entry removed;
+    heap_trace_remove(ptr, &removed);
+    heap_trace_depth++;
+    __real_free(ptr);
+    heap_trace_depth--;
+}
+#endif
+
+int heap_trace_tag(const char *name) {
+    int tag = 0;
+    taskENTER_CRITICAL();
+    for (uint i = 0; i < heap_trace_num_tags; i++) {
+        if (strcmp(heap_trace_tags[i].name, name) == 0) {
+            tag = i;
+            goto exit;
+        }
+    }
+    if (heap_trace_num_tags < HEAP_TRACE_MAX_TAGS) {
+        tag = heap_trace_num_tags++;
+        heap_trace_tags[tag].name = name;
+    }
+exit:
+    taskEXIT_CRITICAL();
+    return tag;
+}
+
+int heap_trace_set_tag(int tag) {
+    int prev = heap_trace_current_tag;
+    heap_trace_current_tag = ((tag >= 0) && (tag < HEAP_TRACE_MAX_TAGS)) ? tag : 0;
+    return prev;
+}
+
+int heap_trace_get_tag_stats(int tag, struct heap_trace_tag_stats *stats) {
+    taskENTER_CRITICAL();
+    if ((tag < 0) || (tag >= heap_trace_num_tags)) {
+        taskEXIT_CRITICAL();
+        errno = EINVAL;
+        return -1;
+    }
+    struct heap_trace_tag *t = &heap_trace_tags[tag];
+    stats->name = t->name;
+    stats->bytes = t->bytes;
+    stats->peak_bytes = t->peak_bytes;
+    stats->count = t->count;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+void heap_trace_report(FILE *stream) {
+    struct heap_info info;
+    heap_get_info(&info);
+    fprintf(stream, "heap: %zu free, %zu largest block, %zu blocks, %u%% fragmented\n", info.total_free, info.largest_free, info.num_free_blocks, info.fragmentation);
+    if (!HEAP_TRACE) {
+        return;
+    }
+    fprintf(stream, "%-16s %8s %8s %6s\n", "TAG", "BYTES", "PEAK", "COUNT");
+    struct heap_trace_tag_stats stats;
+    for (int tag = 0; heap_trace_get_tag_stats(tag, &stats) == 0; tag++) {
+        fprintf(stream, "%-16s %8zu %8zu %6zu\n", stats.name, stats.bytes, stats.peak_bytes, stats.count);
+    }
+    fprintf(stream, "%zu untracked allocations\n", heap_trace_num_untracked);
+}
+
+// Writes the live allocations, or only those made after a sequence number. Entries are copied one
+// at a time, so that writing to the stream, which may allocate, is outside the critical section.
+static void heap_trace_dump_since(FILE *stream, bool all, uint32_t seq) {
+    fprintf(stream, "%-10s %8s %-16s %-10s %8s\n", "ADDRESS", "SIZE", "TAG", "CALLER", "AGE(ms)");
+    #if HEAP_TRACE
+    TickType_t now = xTaskGetTickCount();
+    for (uint i = 0; i < HEAP_TRACE_MAX_ENTRIES; i++) {
+        taskENTER_CRITICAL();
+        struct heap_trace_entry entry = heap_trace_entries[i];
+        taskEXIT_CRITICAL();
+        if (entry.ptr && (all || ((int32_t)(entry.seq - seq) > 0))) {
+            fprintf(stream, "%-10p %8u %-16s %-10p %8lu\n", entry.ptr, (uint)entry.size, heap_trace_tags[entry.tag].name, entry.caller,
+                (unsigned long)((now - entry.time) * portTICK_PERIOD_MS));
+        }
+    }
+    #endif
+}
+
+void heap_trace_dump(FILE *stream) {
+    heap_trace_dump_since(stream, true, 0);
+}
+
+void heap_trace_snapshot(struct heap_trace_snapshot *snapshot) {
+    taskENTER_CRITICAL();
+    snapshot->seq = heap_trace_seq;
+    for (uint tag = 0; tag < HEAP_TRACE_MAX_TAGS; tag++) {
+        snapshot->bytes[tag] = heap_trace_tags[tag].bytes;
+        snapshot->count[tag] = heap_trace_tags[tag].count;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void heap_trace_diff(FILE *stream, const struct heap_trace_snapshot *snapshot) {
+    fprintf(stream, "%-16s %8s %6s\n", "TAG", "BYTES", "COUNT");
+    struct heap_trace_tag_stats stats;
+    for (int tag = 0; heap_trace_get_tag_stats(tag, &stats) == 0; tag++) {
+        long bytes = stats.bytes - snapshot->bytes[tag];
+        long count = stats.count - snapshot->count[tag];
+        if (bytes || count) {
+            fprintf(stream, "%-16s %+8ld %+6ld\n", stats.name, bytes, count);
+        }
+    }
+    heap_trace_dump_since(stream, false, snapshot->seq);
+}
@@ -44,7 +44,7 @@
 #define configUSE_PREEMPTION                    1
 #define configUSE_TICKLESS_IDLE                 0
 #define configUSE_IDLE_HOOK                     (configNUMBER_OF_CORES == 1)
-#define configUSE_TICK_HOOK                     0
+#define configUSE_TICK_HOOK                     1
 #define configTICK_RATE_HZ                      ((TickType_t)200)
 #define configMAX_PRIORITIES                    4
 #define configMINIMAL_STACK_SIZE                ((configSTACK_DEPTH_TYPE)512)
@@ -68,6 +68,7 @@
 #define configUSE_PICOLIBC_TLS                  1
 #define configENABLE_BACKWARD_COMPATIBILITY     0
 #define configNUM_THREAD_LOCAL_STORAGE_POINTERS 4
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES   2
 
 /* System */
 #define configSTACK_DEPTH_TYPE                  uint32_t
@@ -90,6 +91,7 @@
 #define configGENERATE_RUN_TIME_STATS           1
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    1
+#define configUSE_TRACE_RECORDER                0
 
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES                   0
@@ -131,6 +133,7 @@ to exclude the API function. */
 #define INCLUDE_xQueueGetMutexHolder            1
 
 /* A header file that defines trace macro can be included here. */
+#include "freertos/trace.h"
 
 // Backwards compatibility for lib/pico-sdk/lib/lwip/contrib/ports/freertos/sys_arch.c
 #define portTICK_RATE_MS portTICK_PERIOD_MS
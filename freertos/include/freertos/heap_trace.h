@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Heap tracing and fragmentation reporting.
+ *
+ * When built with the CMake option MORELIB_HEAP_TRACE, malloc, calloc, realloc, memalign,
+ * aligned_alloc, posix_memalign and free are wrapped at link time, and every live allocation is
+ * recorded in a fixed-size hash table with its size, caller, tag, tick count and sequence
+ * number. Recording is a hash table update in a critical section, and calls that malloc makes
+ * internally are not recorded, so the overhead is small enough to leave on in production. If the
+ * table is full, further allocations are counted as untracked.
+ *
+ * A tag names the subsystem that allocations belong to. Each task has a current tag, set with
+ * heap_trace_set_tag, and the table keeps the bytes and count of live allocations per tag. To
+ * find a leak, take a snapshot, run the suspect workload, and call heap_trace_diff to list the
+ * change per tag and the allocations made since the snapshot that are still live.
+ *
+ * heap_get_info reports the free memory of the heap, its largest free block and a fragmentation
+ * index, whether or not tracing is enabled.
+ */
+
+#ifndef HEAP_TRACE
+#define HEAP_TRACE 0
+#endif
+
+// Size of the allocation table. Must be a power of 2. Only 7/8 of the entries are used.
+#ifndef HEAP_TRACE_MAX_ENTRIES
+#define HEAP_TRACE_MAX_ENTRIES 512
+#endif
+
+// Maximum number of tags, including the default tag 0
+#ifndef HEAP_TRACE_MAX_TAGS
+#define HEAP_TRACE_MAX_TAGS 16
+#endif
+
+struct heap_info {
+    size_t total_free;                  // free bytes in the heap, including the part not yet claimed
+    size_t largest_free;                // largest block that can be allocated
+    size_t num_free_blocks;
+    unsigned fragmentation;             // percent of free memory not in the largest block
+};
+
+struct heap_trace_tag_stats {
+    const char *name;
+    size_t bytes;                       // bytes in live allocations
+    size_t peak_bytes;
+    size_t count;                       // number of live allocations
+};
+
+struct heap_trace_snapshot {
+    uint32_t seq;                       // sequence number of the last allocation before the snapshot
+    size_t bytes[HEAP_TRACE_MAX_TAGS];
+    size_t count[HEAP_TRACE_MAX_TAGS];
+};
+
+// Gets the free space and fragmentation of the malloc heap.
+void heap_get_info(struct heap_info *info);
+
+// Returns the tag with a name, adding it if needed. Returns 0, the default tag, if there is no
+// room for more tags.
+int heap_trace_tag(const char *name);
+
+// Sets the tag of the current task's allocations. Returns the previous tag.
+int heap_trace_set_tag(int tag);
+
+// Gets the totals of a tag. Returns -1 with errno EINVAL if the tag does not exist.
+int heap_trace_get_tag_stats(int tag, struct heap_trace_tag_stats *stats);
+
+// Writes the heap info and the totals of every tag to a stream.
+void heap_trace_report(FILE *stream);
+
+// Writes every live allocation to a stream.
+void heap_trace_dump(FILE *stream);
+
+void heap_trace_snapshot(struct heap_trace_snapshot *snapshot);
+
+// Writes the change of each tag's totals since a snapshot, and the allocations made since the
+// snapshot that are still live.
+void heap_trace_diff(FILE *stream, const struct heap_trace_snapshot *snapshot);
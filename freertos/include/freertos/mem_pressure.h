@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Memory pressure.
+ *
+ * Subsystems that hold memory they can give back, such as block caches, register a shrinker.
+ * When pvPortMalloc or mem_tier_malloc cannot allocate, they call mem_pressure_reclaim, which
+ * calls the shrinkers in order of priority, lowest first, until enough memory is freed, and then
+ * retry. The malloc failed hook is only called if the retry fails too.
+ *
+ * A shrinker runs in the task whose allocation failed, possibly with locks of that task held, so
+ * it must not block on a lock that could be held by an allocating task. Use a zero timeout and
+ * skip what is busy. A shrinker is not reentered: allocations that fail while shrinkers run are
+ * not retried.
+ *
+ * A watcher is told when the free heap falls below its low watermark and when it rises back
+ * above it, so an application can shed load before allocations start to fail. The free heap is
+ * sampled after pvPortMalloc and mem_tier_malloc allocate, at most once per tick, or when
+ * mem_pressure_check is called.
+ */
+
+// Priorities of shrinkers
+#define MEM_SHRINKER_PRIORITY_FREE 0    // memory kept for reuse, freed without I/O
+#define MEM_SHRINKER_PRIORITY_CACHE 10  // clean caches that must be refilled later
+#define MEM_SHRINKER_PRIORITY_WRITEBACK 20  // caches that must be written back before freeing
+
+struct mem_shrinker {
+    struct mem_shrinker *next;
+    const char *name;
+    int priority;
+    // Frees about size bytes and returns the number of bytes freed.
+    size_t (*shrink)(struct mem_shrinker *shrinker, size_t size);
+};
+
+struct mem_watcher {
+    struct mem_watcher *next;
+    size_t low_watermark;
+    bool below;                         // free heap was below the watermark when last sampled
+    // Called when below changes, with the free heap in bytes.
+    void (*notify)(struct mem_watcher *watcher, size_t free);
+};
+
+void mem_shrinker_register(struct mem_shrinker *shrinker);
+void mem_shrinker_unregister(struct mem_shrinker *shrinker);
+
+// Calls shrinkers until size bytes are freed. Returns the number of bytes freed.
+size_t mem_pressure_reclaim(size_t size);
+
+void mem_watcher_register(struct mem_watcher *watcher);
+void mem_watcher_unregister(struct mem_watcher *watcher);
+
+// Samples the free heap and notifies watchers whose watermark it crossed.
+void mem_pressure_check(void);
+
+// Samples the free heap if it has not been sampled this tick.
+void mem_pressure_poll(void);
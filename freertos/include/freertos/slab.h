@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A size-class slab allocator for small objects.
+ *
+ * Requests of up to SLAB_MAX_SIZE bytes are rounded up to one of SLAB_NUM_CLASSES object sizes.
+ * Objects of a class are carved from pages of SLAB_PAGE_SIZE bytes, which are aligned to their
+ * size, so the page of an object is found by masking its address. Since a page only holds objects
+ * of one size, freed objects can always be reused by later requests of the same class, and small
+ * objects do not fragment the malloc heap. Pages come from spans of SLAB_SPAN_PAGES pages that are
+ * allocated from the malloc heap, and a span is freed when none of its pages are used.
+ *
+ * Each core has a cache of free objects for each class. Allocating from and freeing to the cache
+ * only masks interrupts on the current core. When a cache is empty or full, a batch of objects is
+ * moved between the cache and the pages in a critical section. Larger requests fall back to
+ * malloc.
+ *
+ * pvPortMalloc and vPortFree use this allocator, so FreeRTOS objects such as task control
+ * blocks, queues, and semaphores come from slabs. Memory from slab_malloc must be freed with
+ * slab_free, and never with free.
+ */
+
+// Size of a slab page in bytes. Must be a power of 2.
+#ifndef SLAB_PAGE_SIZE
+#define SLAB_PAGE_SIZE 1024
+#endif
+
+// Number of free objects each core caches per class
+#ifndef SLAB_CACHE_SIZE
+#define SLAB_CACHE_SIZE 8
+#endif
+
+// Number of pages in a span. Less than 32.
+#ifndef SLAB_SPAN_PAGES
+#define SLAB_SPAN_PAGES 8
+#endif
+
+// Maximum number of spans
+#ifndef SLAB_MAX_SPANS
+#define SLAB_MAX_SPANS 32
+#endif
+
+// Maximum number of heap pages that can be used for slabs. Pages beyond this are not used, and
+// requests fall back to malloc instead.
+#ifndef SLAB_MAX_PAGES
+#define SLAB_MAX_PAGES 1024
+#endif
+
+#define SLAB_NUM_CLASSES 10
+#define SLAB_MAX_SIZE 256
+
+struct slab_stats {
+    size_t size;                        // object size of the class
+    size_t num_pages;                   // pages allocated to the class
+    size_t num_objects;                 // objects in use by callers
+    size_t num_free;                    // free objects in pages and caches
+    uint32_t num_allocs;                // allocations since boot
+    uint32_t num_frees;                 // frees since boot
+    uint32_t num_refills;               // times a cache was refilled from pages
+};
+
+void *slab_malloc(size_t size);
+void *slab_calloc(size_t num, size_t size);
+void *slab_realloc(void *ptr, size_t size);
+void slab_free(void *ptr);
+size_t slab_usable_size(void *ptr);
+
+// Gets the statistics of a size class. Returns -1 with errno EINVAL if cls is out of range.
+int slab_get_stats(unsigned cls, struct slab_stats *stats);
@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+
+/* A hierarchical timing wheel driven from the FreeRTOS tick hook.
+ *
+ * Unlike FreeRTOS software timers, starting and stopping a timer does not send a message to the
+ * timer daemon task. Timers are inserted, removed, and rearmed in O(1) inside a short critical
+ * section, and all timers expiring on a tick are processed together from the tick interrupt. The
+ * callback therefore runs in interrupt context and must only use FromISR functions.
+ *
+ * Requires configUSE_TICK_HOOK to be enabled.
+ */
+
+#ifndef TIMER_WHEEL_BITS
+#define TIMER_WHEEL_BITS 6
+#endif
+
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS 5
+#endif
+
+#define TIMER_WHEEL_SIZE (1u << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MAX_DELAY ((TickType_t)((1ull << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1))
+
+struct timer_wheel_entry;
+
+typedef void (*timer_wheel_callback_t)(struct timer_wheel_entry *entry, BaseType_t *pxHigherPriorityTaskWoken);
+
+struct timer_wheel_entry {
+    struct timer_wheel_entry *next;
+    struct timer_wheel_entry **pprev;
+    TickType_t expiry;
+    TickType_t period;
+    timer_wheel_callback_t callback;
+};
+
+void timer_wheel_entry_init(struct timer_wheel_entry *entry, timer_wheel_callback_t callback);
+
+// Arms a timer to expire after delay ticks, and then every period ticks if period is non-zero.
+// If the timer is already armed, it is rearmed.
+void timer_wheel_start(struct timer_wheel_entry *entry, TickType_t delay, TickType_t period);
+
+void timer_wheel_start_from_isr(struct timer_wheel_entry *entry, TickType_t delay, TickType_t period);
+
+// Disarms a timer. Once this function returns, the timer's callback is not running and will not be called.
+void timer_wheel_stop(struct timer_wheel_entry *entry);
+
+static inline bool timer_wheel_is_active(const struct timer_wheel_entry *entry) {
+    return entry->pprev != NULL;
+}
+
+// Returns the number of ticks until the timer next expires, or 0 if the timer is not armed.
+TickType_t timer_wheel_remaining(const struct timer_wheel_entry *entry);
+
+// Advances the wheel to the current tick count and calls the callbacks of expired timers.
+void timer_wheel_tick_from_isr(void);
@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+/* A flight recorder of scheduler and syscall events.
+ *
+ * This header is included by FreeRTOSConfig.h to define the FreeRTOS trace macros. Events are
+ * recorded with a microsecond timestamp into a ring buffer per core. Each core only writes its
+ * own buffer with interrupts masked, so recording never takes a lock shared between cores. When a
+ * buffer is full, the oldest events are overwritten.
+ *
+ * trace_dump writes the buffers to a file descriptor, which may be a file or a socket. The tool
+ * morelib/tools/trace2json.py converts the dump to the Chrome JSON trace format, which can be
+ * loaded by Perfetto and Trace Compass.
+ *
+ * Tracing is compiled in when configUSE_TRACE_RECORDER is 1.
+ */
+
+#ifndef configUSE_TRACE_RECORDER
+#define configUSE_TRACE_RECORDER 0
+#endif
+
+// Number of events per core. Must be a power of 2.
+#ifndef TRACE_BUFFER_SIZE
+#define TRACE_BUFFER_SIZE 512
+#endif
+
+#define TRACE_MAGIC 0x4352544d             // "MTRC"
+#define TRACE_VERSION 1
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+enum trace_event_type {
+    TRACE_TASK_SWITCHED_IN = 1,         // arg1 = task number
+    TRACE_TASK_READY,                   // arg1 = task number
+    TRACE_TASK_CREATE,                  // arg1 = task number
+    TRACE_TASK_DELETE,                  // arg1 = task number
+    TRACE_TASK_DELAY,                   // arg1 = wake time in ticks, or 0 if relative
+    TRACE_BLOCK_QUEUE_RECEIVE,          // arg1 = queue, including semaphores and mutexes
+    TRACE_BLOCK_QUEUE_SEND,             // arg1 = queue
+    TRACE_BLOCK_NOTIFY,                 // arg1 = notification index
+    TRACE_SYSCALL_ENTER,                // arg1 = syscall, arg2 = first argument
+    TRACE_SYSCALL_EXIT,                 // arg1 = syscall, arg2 = return value
+    TRACE_INTERRUPTIBLE_BEGIN,          // arg1 = address of caller
+    TRACE_INTERRUPTIBLE_END,
+};
+
+enum trace_syscall {
+    TRACE_SYS_READ,
+    TRACE_SYS_WRITE,
+    TRACE_SYS_POLL,
+};
+
+struct trace_event {
+    uint32_t timestamp;                 // low 32 bits of the run time counter in microseconds
+    uint8_t type;
+    uint8_t core;
+    uint16_t reserved;
+    uint32_t arg1;
+    uint32_t arg2;
+};
+
+/* Dump format, all little endian:
+ *   struct trace_header
+ *   num_tasks * struct trace_task
+ *   for each core: uint32_t count, then count * struct trace_event, oldest first
+ */
+struct trace_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_cores;
+    uint32_t timestamp_hz;
+    uint32_t num_tasks;
+};
+
+struct trace_task {
+    uint32_t number;
+    char name[16];
+};
+
+// Discards recorded events and starts recording.
+void trace_start(void);
+
+void trace_stop(void);
+
+// Writes all recorded events to fd. Recording is paused while dumping. Fails with ENOTSUP if
+// tracing is not compiled in.
+int trace_dump(int fd);
+
+#if configUSE_TRACE_RECORDER
+void trace_record(unsigned type, uint32_t arg1, uint32_t arg2);
+
+struct tskTaskControlBlock;
+
+// Gives a new task the next task number and records its creation.
+void trace_task_create(struct tskTaskControlBlock *task);
+
+#define traceTASK_SWITCHED_IN() trace_record(TRACE_TASK_SWITCHED_IN, uxTaskGetTaskNumber(xTaskGetCurrentTaskHandle()), 0)
+#define traceMOVED_TASK_TO_READY_STATE(pxTCB) trace_record(TRACE_TASK_READY, uxTaskGetTaskNumber(pxTCB), 0)
+#define traceTASK_CREATE(pxNewTCB) trace_task_create(pxNewTCB)
+#define traceTASK_DELETE(pxTaskToDelete) trace_record(TRACE_TASK_DELETE, uxTaskGetTaskNumber(pxTaskToDelete), 0)
+#define traceTASK_DELAY() trace_record(TRACE_TASK_DELAY, 0, 0)
+#define traceTASK_DELAY_UNTIL(xTimeToWake) trace_record(TRACE_TASK_DELAY, xTimeToWake, 0)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) trace_record(TRACE_BLOCK_QUEUE_RECEIVE, (uint32_t)(uintptr_t)(pxQueue), 0)
+#define traceBLOCKING_ON_QUEUE_PEEK(pxQueue) trace_record(TRACE_BLOCK_QUEUE_RECEIVE, (uint32_t)(uintptr_t)(pxQueue), 0)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue) trace_record(TRACE_BLOCK_QUEUE_SEND, (uint32_t)(uintptr_t)(pxQueue), 0)
+#define traceTASK_NOTIFY_TAKE_BLOCK(uxIndexToWait) trace_record(TRACE_BLOCK_NOTIFY, uxIndexToWait, 0)
+#define traceTASK_NOTIFY_WAIT_BLOCK(uxIndexToWait) trace_record(TRACE_BLOCK_NOTIFY, uxIndexToWait, 0)
+
+#define TRACE_SYSCALL(syscall, arg) trace_record(TRACE_SYSCALL_ENTER, syscall, (uint32_t)(arg))
+#define TRACE_SYSCALL_RETURN(syscall, ret) trace_record(TRACE_SYSCALL_EXIT, syscall, (uint32_t)(ret))
+#define TRACE_ENABLE_INTERRUPT() trace_record(TRACE_INTERRUPTIBLE_BEGIN, (uint32_t)(uintptr_t)__builtin_return_address(0), 0)
+#define TRACE_DISABLE_INTERRUPT() trace_record(TRACE_INTERRUPTIBLE_END, 0, 0)
+#else
+#define TRACE_SYSCALL(syscall, arg)
+#define TRACE_SYSCALL_RETURN(syscall, ret)
+#define TRACE_ENABLE_INTERRUPT()
+#define TRACE_DISABLE_INTERRUPT()
+#endif
+
+#endif
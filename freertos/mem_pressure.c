@@ -0,0 +1,133 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include "freertos/heap_trace.h"
+#include "freertos/mem_pressure.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+
+// Shrinkers and watchers are protected by the mutex. Shrinkers are sorted by priority.
+static SemaphoreHandle_t mem_pressure_mutex;
+static struct mem_shrinker *mem_shrinkers;
+static struct mem_watcher *mem_watchers;
+static TickType_t mem_pressure_last_tick;
+
+// Runs before the constructors of other files, which may register shrinkers.
+__attribute__((constructor(101), visibility("hidden")))
+void mem_pressure_init(void) {
+    static StaticSemaphore_t xMutexBuffer;
+    mem_pressure_mutex = xSemaphoreCreateMutexStatic(&xMutexBuffer);
+}
+
+// Takes the mutex, unless the scheduler is not running or the current task already holds it.
+static bool mem_pressure_lock(TickType_t xTicksToWait) {
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        return false;
+    }
+    if (xSemaphoreGetMutexHolder(mem_pressure_mutex) == xTaskGetCurrentTaskHandle()) {
+        return false;
+    }
+    return xSemaphoreTake(mem_pressure_mutex, xTicksToWait);
+}
+
+static void mem_pressure_unlock(void) {
+    xSemaphoreGive(mem_pressure_mutex);
+}
+
+// Locks the lists. Constructors register shrinkers before the scheduler starts, when there is
+// nothing to lock against.
+static void mem_pressure_list_lock(void) {
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
+        xSemaphoreTake(mem_pressure_mutex, portMAX_DELAY);
+    }
+}
+
+static void mem_pressure_list_unlock(void) {
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
+        xSemaphoreGive(mem_pressure_mutex);
+    }
+}
+
+void mem_shrinker_register(struct mem_shrinker *shrinker) {
+    mem_pressure_list_lock();
+    struct mem_shrinker **pshrinker = &mem_shrinkers;
+    while (*pshrinker && ((*pshrinker)->priority <= shrinker->priority)) {
+        pshrinker = &(*pshrinker)->next;
+    }
+    shrinker->next = *pshrinker;
+    *pshrinker = shrinker;
+    mem_pressure_list_unlock();
+}
+
+void mem_shrinker_unregister(struct mem_shrinker *shrinker) {
+    mem_pressure_list_lock();
+    struct mem_shrinker **pshrinker = &mem_shrinkers;
+    while (*pshrinker && (*pshrinker != shrinker)) {
+        pshrinker = &(*pshrinker)->next;
+    }
+    if (*pshrinker) {
+        *pshrinker = shrinker->next;
+    }
+    mem_pressure_list_unlock();
+}
+
+size_t mem_pressure_reclaim(size_t size) {
+    if (!mem_pressure_lock(portMAX_DELAY)) {
+        return 0;
+    }
+    size_t freed = 0;
+    for (struct mem_shrinker *shrinker = mem_shrinkers; shrinker && (freed < size); shrinker = shrinker->next) {
+        freed += shrinker->shrink(shrinker, size - freed);
+    }
+    mem_pressure_unlock();
+    return freed;
+}
+
+void mem_watcher_register(struct mem_watcher *watcher) {
+    watcher->below = false;
+    mem_pressure_list_lock();
+    watcher->next = mem_watchers;
+    mem_watchers = watcher;
+    mem_pressure_list_unlock();
+    mem_pressure_check();
+}
+
+void mem_watcher_unregister(struct mem_watcher *watcher) {
+    mem_pressure_list_lock();
+    struct mem_watcher **pwatcher = &mem_watchers;
+    while (*pwatcher && (*pwatcher != watcher)) {
+        pwatcher = &(*pwatcher)->next;
+    }
+    if (*pwatcher) {
+        *pwatcher = watcher->next;
+    }
+    mem_pressure_list_unlock();
+}
+
+void mem_pressure_check(void) {
+    // Sampling is skipped rather than waited for, since it is called from allocators.
+    if (!mem_watchers || !mem_pressure_lock(0)) {
+        return;
+    }
+    struct heap_info info;
+    heap_get_info(&info);
+    for (struct mem_watcher *watcher = mem_watchers; watcher; watcher = watcher->next) {
+        bool below = info.total_free < watcher->low_watermark;
+        if (below != watcher->below) {
+            watcher->below = below;
+            watcher->notify(watcher, info.total_free);
+        }
+    }
+    mem_pressure_unlock();
+}
+
+void mem_pressure_poll(void) {
+    TickType_t xTickCount = xTaskGetTickCount();
+    if (mem_watchers && (xTickCount != mem_pressure_last_tick)) {
+        mem_pressure_last_tick = xTickCount;
+        mem_pressure_check();
+    }
+}
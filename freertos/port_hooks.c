@@ -1,6 +1,9 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+#include "freertos/heap_trace.h"
+#include "freertos/timer_wheel.h"
+
 #include "pico/sync.h"
 
 #if (configNUMBER_OF_CORES == 1)
@@ -18,5 +21,12 @@ void vApplicationStackOverflowHook(TaskHandle_t Task, char *pcTaskName) {
 }
 
 void vApplicationMallocFailedHook(void) {
+    heap_trace_report(stderr);
     panic("Malloc Failed\n");
 };
+
+#if configUSE_TICK_HOOK
+void vApplicationTickHook(void) {
+    timer_wheel_tick_from_isr();
+}
+#endif
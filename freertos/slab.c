@@ -0,0 +1,452 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <string.h>
+#include "freertos/mem_pressure.h"
+#include "freertos/slab.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+static_assert((SLAB_PAGE_SIZE & (SLAB_PAGE_SIZE - 1)) == 0);
+
+static_assert(SLAB_SPAN_PAGES < 32);
+
+struct slab_page {
+    struct slab_page *next;             // list of partial pages of the class
+    struct slab_page *prev;
+    void *free;                         // free objects in the page
+    uint16_t cls;
+    uint16_t num_free;
+};
+
+// Pages are carved from spans, which are blocks of SLAB_SPAN_PAGES pages allocated with plain
+// malloc. Only the aligned part of a block is used, so aligning costs at most one page per span,
+// and the heap is not cut into page-sized pieces that fit nothing else when freed.
+struct slab_span {
+    char *block;                        // block from malloc, or NULL if the slot is unused
+    uintptr_t first;                    // address of the first page
+    uint8_t num_pages;
+    uint32_t free_mask;                 // pages not used by any class
+};
+
+#define SLAB_HEADER_SIZE ((sizeof(struct slab_page) + 7) & ~7)
+
+struct slab_class {
+    struct slab_page *partial;          // pages with free objects
+    struct slab_page *empty;            // a page with no objects in use, kept to avoid thrashing
+    size_t num_pages;
+    size_t num_free;                    // free objects in pages
+    uint32_t num_refills;
+};
+
+struct slab_cache {
+    void *objects[SLAB_CACHE_SIZE];
+    uint count;
+    uint32_t num_allocs;
+    uint32_t num_frees;
+};
+
+// Object sizes are multiples of 8 to keep objects aligned. The last size is SLAB_MAX_SIZE.
+static const uint16_t slab_sizes[SLAB_NUM_CLASSES] = { 8, 16, 24, 32, 48, 64, 96, 128, 192, 256 };
+
+// Classes are protected by critical section.
+static struct slab_class slab_classes[SLAB_NUM_CLASSES];
+
+// Each core's caches are protected by masking interrupts on that core.
+static struct slab_cache slab_caches[configNUMBER_OF_CORES][SLAB_NUM_CLASSES];
+
+// Spans are protected by critical section.
+static struct slab_span slab_spans[SLAB_MAX_SPANS];
+
+// Bitmap of heap pages that belong to spans, protected by critical section.
+static uint32_t slab_page_map[SLAB_MAX_PAGES / 32];
+
+// Range of the malloc heap, which slab pages are allocated from
+#ifndef SLAB_HEAP_START
+extern char __heap_start[];
+extern char __heap_end[];
+#define SLAB_HEAP_START ((uintptr_t)__heap_start)
+#define SLAB_HEAP_END ((uintptr_t)__heap_end)
+#endif
+
+static uint slab_class_of(size_t size) {
+    uint cls = 0;
+    while (slab_sizes[cls] < size) {
+        cls++;
+    }
+    return cls;
+}
+
+static struct slab_page *slab_page_of(void *ptr) {
+    return (struct slab_page *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+}
+
+// Returns the index of a page in the page map, or -1 if the page is outside the map.
+static int slab_page_index(struct slab_page *page) {
+    uintptr_t base = (SLAB_HEAP_START + SLAB_PAGE_SIZE - 1) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1);
+    if (((uintptr_t)page < base) || ((uintptr_t)page >= SLAB_HEAP_END)) {
+        return -1;
+    }
+    size_t index = ((uintptr_t)page - base) / SLAB_PAGE_SIZE;
+    if (index >= SLAB_MAX_PAGES) {
+        return -1;
+    }
+    return (int)index;
+}
+
+static bool slab_owns(void *ptr) {
+    int index = slab_page_index(slab_page_of(ptr));
+    return (index >= 0) && (slab_page_map[index / 32] & (1u << (index % 32)));
+}
+
+static void slab_map_span(struct slab_span *span, bool used) {
+    int index = slab_page_index((struct slab_page *)span->first);
+    for (uint i = 0; i < span->num_pages; i++, index++) {
+        if (used) {
+            slab_page_map[index / 32] |= 1u << (index % 32);
+        } else {
+            slab_page_map[index / 32] &= ~(1u << (index % 32));
+        }
+    }
+}
+
+// Takes an unused page from a span, or returns NULL if there is none. Must be called in a critical section.
+static struct slab_page *slab_take_page(void) {
+    for (uint i = 0; i < SLAB_MAX_SPANS; i++) {
+        struct slab_span *span = &slab_spans[i];
+        if (span->free_mask) {
+            uint bit = __builtin_ctz(span->free_mask);
+            span->free_mask &= ~(1u << bit);
+            return (struct slab_page *)(span->first + bit * SLAB_PAGE_SIZE);
+        }
+    }
+    return NULL;
+}
+
+// Returns a page to its span. If no page of the span is used anymore, the span is removed and its
+// block is pushed on a list of blocks to free. Must be called in a critical section.
+static void slab_put_page(struct slab_page *page, void **release) {
+    struct slab_span *span = slab_spans;
+    while ((uintptr_t)page - span->first >= span->num_pages * SLAB_PAGE_SIZE) {
+        span++;
+    }
+    span->free_mask |= 1u << (((uintptr_t)page - span->first) / SLAB_PAGE_SIZE);
+    if (span->free_mask == (1u << span->num_pages) - 1) {
+        slab_map_span(span, false);
+        *(void **)span->block = *release;
+        *release = span->block;
+        span->block = NULL;
+        span->free_mask = 0;
+    }
+}
+
+// Allocates a new span. Must be called with interrupts enabled.
+static int slab_add_span(void) {
+    char *block = malloc(SLAB_SPAN_PAGES * SLAB_PAGE_SIZE);
+    if (!block) {
+        return -1;
+    }
+    uintptr_t first = ((uintptr_t)block + SLAB_PAGE_SIZE - 1) & ~(uintptr_t)(SLAB_PAGE_SIZE - 1);
+    uint num_pages = ((uintptr_t)block + SLAB_SPAN_PAGES * SLAB_PAGE_SIZE - first) / SLAB_PAGE_SIZE;
+    if ((slab_page_index((struct slab_page *)first) < 0) ||
+        (slab_page_index((struct slab_page *)(first + (num_pages - 1) * SLAB_PAGE_SIZE)) < 0)) {
+        free(block);
+        return -1;
+    }
+
+    taskENTER_CRITICAL();
+    for (uint i = 0; i < SLAB_MAX_SPANS; i++) {
+        struct slab_span *span = &slab_spans[i];
+        if (!span->block) {
+            span->block = block;
+            span->first = first;
+            span->num_pages = num_pages;
+            span->free_mask = (1u << num_pages) - 1;
+            slab_map_span(span, true);
+            taskEXIT_CRITICAL();
+            return 0;
+        }
+    }
+    taskEXIT_CRITICAL();
+    free(block);
+    return -1;
+}
+
+// Page list functions. Must be called in a critical section.
+static void slab_link(struct slab_class *class, struct slab_page *page) {
+    page->prev = NULL;
+    page->next = class->partial;
+    if (class->partial) {
+        class->partial->prev = page;
+    }
+    class->partial = page;
+}
+
+static void slab_unlink(struct slab_class *class, struct slab_page *page) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        class->partial = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+}
+
+// Moves up to half a cache of objects from pages to an empty cache. Must be called with interrupts masked.
+static void slab_refill(uint cls, struct slab_cache *cache) {
+    struct slab_class *class = &slab_classes[cls];
+    UBaseType_t uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    if (!class->partial && class->empty) {
+        slab_link(class, class->empty);
+        class->empty = NULL;
+    }
+    while ((cache->count < SLAB_CACHE_SIZE / 2) && class->partial) {
+        struct slab_page *page = class->partial;
+        void *ptr = page->free;
+        page->free = *(void **)ptr;
+        page->num_free--;
+        class->num_free--;
+        if (!page->num_free) {
+            slab_unlink(class, page);
+        }
+        cache->objects[cache->count++] = ptr;
+    }
+    class->num_refills++;
+    taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+}
+
+// Moves objects from a cache back to pages until keep objects are left. Span blocks that are no
+// longer needed are pushed on the release list, linked by their first word. Must be called with
+// interrupts masked.
+static void slab_flush(uint cls, struct slab_cache *cache, uint keep, void **release) {
+    struct slab_class *class = &slab_classes[cls];
+    uint objects_per_page = (SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / slab_sizes[cls];
+    UBaseType_t uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    while (cache->count > keep) {
+        void *ptr = cache->objects[--cache->count];
+        struct slab_page *page = slab_page_of(ptr);
+        *(void **)ptr = page->free;
+        page->free = ptr;
+        page->num_free++;
+        class->num_free++;
+        if (page->num_free == 1) {
+            slab_link(class, page);
+        }
+        if (page->num_free == objects_per_page) {
+            // Keep one empty page per class and release the rest.
+            slab_unlink(class, page);
+            if (class->empty) {
+                class->num_pages--;
+                class->num_free -= objects_per_page;
+                slab_put_page(page, release);
+            } else {
+                class->empty = page;
+            }
+        }
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+}
+
+// Frees the span blocks on a release list. Returns the number of bytes freed.
+static size_t slab_release(void *release) {
+    size_t freed = 0;
+    while (release) {
+        void *block = release;
+        release = *(void **)block;
+        free(block);
+        freed += SLAB_SPAN_PAGES * SLAB_PAGE_SIZE;
+    }
+    return freed;
+}
+
+// Adds a new page to a class. Must be called with interrupts enabled.
+static int slab_grow(uint cls) {
+    struct slab_page *page;
+    for (;;) {
+        taskENTER_CRITICAL();
+        page = slab_take_page();
+        taskEXIT_CRITICAL();
+        if (page) {
+            break;
+        }
+        if (slab_add_span() < 0) {
+            return -1;
+        }
+    }
+
+    uint size = slab_sizes[cls];
+    uint objects_per_page = (SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / size;
+    page->cls = cls;
+    page->num_free = objects_per_page;
+    page->free = NULL;
+    for (uint i = objects_per_page; i > 0; i--) {
+        void *ptr = (char *)page + SLAB_HEADER_SIZE + (i - 1) * size;
+        *(void **)ptr = page->free;
+        page->free = ptr;
+    }
+
+    struct slab_class *class = &slab_classes[cls];
+    taskENTER_CRITICAL();
+    class->num_pages++;
+    class->num_free += objects_per_page;
+    slab_link(class, page);
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+void *slab_malloc(size_t size) {
+    if (size > SLAB_MAX_SIZE) {
+        return malloc(size);
+    }
+    uint cls = slab_class_of(size);
+    for (;;) {
+        // Masking interrupts also keeps the task on this core while it uses the core's cache.
+        UBaseType_t uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+        struct slab_cache *cache = &slab_caches[portGET_CORE_ID()][cls];
+        if (!cache->count) {
+            slab_refill(cls, cache);
+        }
+        void *ptr = NULL;
+        if (cache->count) {
+            ptr = cache->objects[--cache->count];
+            cache->num_allocs++;
+        }
+        portCLEAR_INTERRUPT_MASK_FROM_ISR(uxSavedInterruptStatus);
+        if (ptr) {
+            return ptr;
+        }
+        if (slab_grow(cls) < 0) {
+            // No page could be used, so try the general heap.
+            return malloc(size);
+        }
+    }
+}
+
+void *slab_calloc(size_t num, size_t size) {
+    size_t total;
+    if (__builtin_mul_overflow(num, size, &total)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *ptr = slab_malloc(total);
+    if (ptr) {
+        memset(ptr, 0, total);
+    }
+    return ptr;
+}
+
+void slab_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    if (!slab_owns(ptr)) {
+        free(ptr);
+        return;
+    }
+    struct slab_page *page = slab_page_of(ptr);
+    void *release = NULL;
+    UBaseType_t uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+    struct slab_cache *cache = &slab_caches[portGET_CORE_ID()][page->cls];
+    if (cache->count == SLAB_CACHE_SIZE) {
+        slab_flush(page->cls, cache, SLAB_CACHE_SIZE / 2, &release);
+    }
+    cache->objects[cache->count++] = ptr;
+    cache->num_frees++;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(uxSavedInterruptStatus);
+    slab_release(release);
+}
+
+size_t slab_usable_size(void *ptr) {
+    if (!ptr) {
+        return 0;
+    }
+    if (!slab_owns(ptr)) {
+        return malloc_usable_size(ptr);
+    }
+    return slab_sizes[slab_page_of(ptr)->cls];
+}
+
+void *slab_realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return slab_malloc(size);
+    }
+    if (!slab_owns(ptr)) {
+        return realloc(ptr, size);
+    }
+    size_t old_size = slab_usable_size(ptr);
+    if (size <= old_size) {
+        return ptr;
+    }
+    void *new_ptr = slab_malloc(size);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, old_size);
+        slab_free(ptr);
+    }
+    return new_ptr;
+}
+
+int slab_get_stats(unsigned cls, struct slab_stats *stats) {
+    if (cls >= SLAB_NUM_CLASSES) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct slab_class *class = &slab_classes[cls];
+    uint objects_per_page = (SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / slab_sizes[cls];
+    taskENTER_CRITICAL();
+    stats->size = slab_sizes[cls];
+    stats->num_pages = class->num_pages;
+    stats->num_free = class->num_free;
+    stats->num_allocs = 0;
+    stats->num_frees = 0;
+    stats->num_refills = class->num_refills;
+    // The other core may be using its cache, so its counts are approximate.
+    for (uint core = 0; core < configNUMBER_OF_CORES; core++) {
+        struct slab_cache *cache = &slab_caches[core][cls];
+        stats->num_free += cache->count;
+        stats->num_allocs += cache->num_allocs;
+        stats->num_frees += cache->num_frees;
+    }
+    taskEXIT_CRITICAL();
+    stats->num_objects = stats->num_pages * objects_per_page - stats->num_free;
+    return 0;
+}
+
+// Returns the current core's cached objects and the empty page that each class keeps to the spans.
+// The other core's caches are left alone, since only that core may touch them.
+static size_t slab_shrink(struct mem_shrinker *shrinker, size_t size) {
+    (void)shrinker;
+    (void)size;
+    void *release = NULL;
+    UBaseType_t uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+    for (uint cls = 0; cls < SLAB_NUM_CLASSES; cls++) {
+        struct slab_class *class = &slab_classes[cls];
+        slab_flush(cls, &slab_caches[portGET_CORE_ID()][cls], 0, &release);
+        UBaseType_t uxSavedCriticalStatus = taskENTER_CRITICAL_FROM_ISR();
+        if (class->empty) {
+            class->num_pages--;
+            class->num_free -= (SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / slab_sizes[cls];
+            slab_put_page(class->empty, &release);
+            class->empty = NULL;
+        }
+        taskEXIT_CRITICAL_FROM_ISR(uxSavedCriticalStatus);
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(uxSavedInterruptStatus);
+    return slab_release(release);
+}
+
+static struct mem_shrinker slab_shrinker = {
+    .name = "slab",
+    .priority = MEM_SHRINKER_PRIORITY_FREE,
+    .shrink = slab_shrink,
+};
+
+__attribute__((constructor, visibility("hidden")))
+void slab_init(void) {
+    mem_shrinker_register(&slab_shrinker);
+}
@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <limits.h>
+#include <sys/param.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "freertos/timer_wheel.h"
+
+
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+
+// All state is protected by the critical section.
+static struct {
+    struct timer_wheel_entry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+    // The next tick to be processed by timer_wheel_tick_from_isr.
+    TickType_t next_tick;
+    size_t num_entries;
+} timer_wheel;
+
+static inline bool timer_wheel_after(TickType_t a, TickType_t b) {
+    return (int32_t)(a - b) > 0;
+}
+
+static void timer_wheel_link(struct timer_wheel_entry **slot, struct timer_wheel_entry *entry) {
+    entry->next = *slot;
+    if (entry->next) {
+        entry->next->pprev = &entry->next;
+    }
+    entry->pprev = slot;
+    *slot = entry;
+    timer_wheel.num_entries++;
+}
+
+static void timer_wheel_unlink(struct timer_wheel_entry *entry) {
+    *entry->pprev = entry->next;
+    if (entry->next) {
+        entry->next->pprev = entry->pprev;
+    }
+    entry->next = NULL;
+    entry->pprev = NULL;
+    timer_wheel.num_entries--;
+}
+
+static void timer_wheel_insert(struct timer_wheel_entry *entry) {
+    TickType_t expiry = entry->expiry;
+    TickType_t delta = expiry - timer_wheel.next_tick;
+    if (!timer_wheel_after(expiry, timer_wheel.next_tick)) {
+        // Already expired: process on the next tick.
+        expiry = timer_wheel.next_tick;
+        delta = 0;
+    } else if (delta > TIMER_WHEEL_MAX_DELAY) {
+        // Beyond the range of the wheel: park in the last slot and re-insert when it is reached.
+        delta = TIMER_WHEEL_MAX_DELAY;
+        expiry = timer_wheel.next_tick + delta;
+    }
+
+    uint level = 0;
+    while ((level < TIMER_WHEEL_LEVELS - 1) && (delta >> (TIMER_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    uint index = (expiry >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    timer_wheel_link(&timer_wheel.slots[level][index], entry);
+}
+
+static void timer_wheel_cascade(uint level, uint index) {
+    // Entries only move to lower levels, so none are re-inserted into this slot.
+    struct timer_wheel_entry **slot = &timer_wheel.slots[level][index];
+    struct timer_wheel_entry *entry;
+    while ((entry = *slot)) {
+        timer_wheel_unlink(entry);
+        timer_wheel_insert(entry);
+    }
+}
+
+static void timer_wheel_expire(TickType_t tick, BaseType_t *pxHigherPriorityTaskWoken) {
+    // Move the expiring entries to a local list first. Periodic entries may be rearmed into the
+    // same slot, and callbacks may stop other entries in the list.
+    struct timer_wheel_entry *work = timer_wheel.slots[0][tick & TIMER_WHEEL_MASK];
+    timer_wheel.slots[0][tick & TIMER_WHEEL_MASK] = NULL;
+    if (work) {
+        work->pprev = &work;
+    }
+
+    struct timer_wheel_entry *entry;
+    while ((entry = work)) {
+        timer_wheel_unlink(entry);
+        if (timer_wheel_after(entry->expiry, tick)) {
+            // Entry was parked beyond the range of the wheel.
+            timer_wheel_insert(entry);
+            continue;
+        }
+        if (entry->period) {
+            entry->expiry += entry->period;
+            timer_wheel_insert(entry);
+        }
+        entry->callback(entry, pxHigherPriorityTaskWoken);
+    }
+}
+
+void timer_wheel_entry_init(struct timer_wheel_entry *entry, timer_wheel_callback_t callback) {
+    entry->next = NULL;
+    entry->pprev = NULL;
+    entry->expiry = 0;
+    entry->period = 0;
+    entry->callback = callback;
+}
+
+static void timer_wheel_start_internal(struct timer_wheel_entry *entry, TickType_t now, TickType_t delay, TickType_t period) {
+    if (entry->pprev) {
+        timer_wheel_unlink(entry);
+    }
+    if (!timer_wheel.num_entries) {
+        timer_wheel.next_tick = now + 1;
+    }
+    entry->expiry = now + MIN(delay, INT32_MAX);
+    entry->period = MIN(period, INT32_MAX);
+    timer_wheel_insert(entry);
+}
+
+void timer_wheel_start(struct timer_wheel_entry *entry, TickType_t delay, TickType_t period) {
+    taskENTER_CRITICAL();
+    timer_wheel_start_internal(entry, xTaskGetTickCount(), delay, period);
+    taskEXIT_CRITICAL();
+}
+
+void timer_wheel_start_from_isr(struct timer_wheel_entry *entry, TickType_t delay, TickType_t period) {
+    UBaseType_t uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    timer_wheel_start_internal(entry, xTaskGetTickCountFromISR(), delay, period);
+    taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+}
+
+void timer_wheel_stop(struct timer_wheel_entry *entry) {
+    taskENTER_CRITICAL();
+    if (entry->pprev) {
+        timer_wheel_unlink(entry);
+    }
+    taskEXIT_CRITICAL();
+}
+
+TickType_t timer_wheel_remaining(const struct timer_wheel_entry *entry) {
+    TickType_t ret = 0;
+    taskENTER_CRITICAL();
+    if (entry->pprev) {
+        TickType_t now = xTaskGetTickCount();
+        ret = timer_wheel_after(entry->expiry, now) ? entry->expiry - now : 0;
+    }
+    taskEXIT_CRITICAL();
+    return ret;
+}
+
+void timer_wheel_tick_from_isr(void) {
+    UBaseType_t uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    TickType_t now = xTaskGetTickCountFromISR();
+    if (!timer_wheel.num_entries) {
+        timer_wheel.next_tick = now + 1;
+    }
+    // Catch up on any ticks missed while the scheduler was suspended.
+    while (!timer_wheel_after(timer_wheel.next_tick, now)) {
+        TickType_t tick = timer_wheel.next_tick;
+        uint index = tick & TIMER_WHEEL_MASK;
+        for (uint level = 1; !index && (level < TIMER_WHEEL_LEVELS); level++) {
+            index = (tick >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+            timer_wheel_cascade(level, index);
+        }
+        timer_wheel.next_tick = tick + 1;
+
+        // The tick interrupt yields by itself if a higher priority task was woken.
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        timer_wheel_expire(tick, &xHigherPriorityTaskWoken);
+    }
+    taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+}
@@ -0,0 +1,17 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Minimal single-core definitions for building slab.c on the host.
+#include <assert.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef unsigned long UBaseType_t;
+
+#define configNUMBER_OF_CORES 1
+
+#define portGET_CORE_ID() 0
+#define portSET_INTERRUPT_MASK_FROM_ISR() 0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x) (void)(x)
@@ -0,0 +1,321 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+/* Replays an allocation trace on the host against a model of the malloc heap, with and without
+ * the slab allocator in front of it, and compares heap footprint, fragmentation, and speed.
+ *
+ * Build from this directory:
+ *   cc -O2 -I. -I../../include -o slab_replay slab_replay.c
+ *
+ * Usage:
+ *   slab_replay TRACE               replay a trace file
+ *   slab_replay -s COUNT [SEED]     replay a synthetic trace of COUNT allocations
+ *
+ * A trace has one operation per line: "+ ID SIZE" allocates SIZE bytes for ID, and "- ID" frees
+ * the allocation of ID. IDs are any non-negative integers.
+ */
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/mem_pressure.h"
+
+
+// The heap model is a first-fit allocator with an address-ordered free list, like picolibc's
+// malloc, carving chunks from a fixed arena. Each chunk has an 8-byte header holding its size.
+#define ARENA_SIZE (64u << 20)
+#define ALIGN 8
+#define HEADER 8
+#define MIN_CHUNK 16
+
+struct chunk {
+    size_t size;                        // size of the chunk including header
+    struct chunk *next;                 // next free chunk, only valid when free
+};
+
+static char arena[ARENA_SIZE] __attribute__((aligned(4096)));
+static size_t arena_top;                // end of the used part of the arena
+static size_t arena_peak;
+static struct chunk *arena_free_list;
+
+static void arena_reset(void) {
+    arena_top = 0;
+    arena_peak = 0;
+    arena_free_list = NULL;
+}
+
+static void *chunk_ptr(struct chunk *chunk) {
+    return (char *)chunk + HEADER;
+}
+
+static struct chunk *ptr_chunk(void *ptr) {
+    return (struct chunk *)((char *)ptr - HEADER);
+}
+
+static void *arena_malloc(size_t size) {
+    size_t need = (size + HEADER + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+    if (need < MIN_CHUNK) {
+        need = MIN_CHUNK;
+    }
+    for (struct chunk **pchunk = &arena_free_list; *pchunk; pchunk = &(*pchunk)->next) {
+        struct chunk *chunk = *pchunk;
+        if (chunk->size < need) {
+            continue;
+        }
+        if (chunk->size - need >= MIN_CHUNK) {
+            struct chunk *rest = (struct chunk *)((char *)chunk + need);
+            rest->size = chunk->size - need;
+            rest->next = chunk->next;
+            *pchunk = rest;
+            chunk->size = need;
+        } else {
+            *pchunk = chunk->next;
+        }
+        return chunk_ptr(chunk);
+    }
+    if (arena_top + need > ARENA_SIZE) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    struct chunk *chunk = (struct chunk *)(arena + arena_top);
+    chunk->size = need;
+    arena_top += need;
+    if (arena_top > arena_peak) {
+        arena_peak = arena_top;
+    }
+    return chunk_ptr(chunk);
+}
+
+static void arena_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    struct chunk *chunk = ptr_chunk(ptr);
+    struct chunk **pchunk = &arena_free_list;
+    struct chunk *prev = NULL;
+    while (*pchunk && (*pchunk < chunk)) {
+        prev = *pchunk;
+        pchunk = &(*pchunk)->next;
+    }
+    chunk->next = *pchunk;
+    *pchunk = chunk;
+    if (chunk->next && ((char *)chunk + chunk->size == (char *)chunk->next)) {
+        chunk->size += chunk->next->size;
+        chunk->next = chunk->next->next;
+    }
+    if (prev && ((char *)prev + prev->size == (char *)chunk)) {
+        prev->size += chunk->size;
+        prev->next = chunk->next;
+        chunk = prev;
+    }
+    // Give a free chunk at the top back to the arena.
+    if ((char *)chunk + chunk->size == arena + arena_top) {
+        arena_top -= chunk->size;
+        pchunk = &arena_free_list;
+        while (*pchunk != chunk) {
+            pchunk = &(*pchunk)->next;
+        }
+        *pchunk = NULL;
+    }
+}
+
+static size_t arena_usable_size(void *ptr) {
+    return ptr_chunk(ptr)->size - HEADER;
+}
+
+static void *arena_realloc(void *ptr, size_t size) {
+    void *new_ptr = arena_malloc(size);
+    if (ptr && new_ptr) {
+        size_t old_size = arena_usable_size(ptr);
+        memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+        arena_free(ptr);
+    }
+    return new_ptr;
+}
+
+
+// The replay has no memory pressure, so the slab's shrinker is not registered anywhere.
+void mem_shrinker_register(struct mem_shrinker *shrinker) {
+    (void)shrinker;
+}
+
+// Build the slab allocator on top of the heap model.
+#define SLAB_HEAP_START ((uintptr_t)arena)
+#define SLAB_HEAP_END ((uintptr_t)arena + ARENA_SIZE)
+#define SLAB_MAX_PAGES (ARENA_SIZE / SLAB_PAGE_SIZE)
+#define SLAB_MAX_SPANS 4096
+#define malloc arena_malloc
+#define free arena_free
+#define realloc arena_realloc
+#define malloc_usable_size arena_usable_size
+#include "../../slab.c"
+#undef malloc
+#undef free
+#undef realloc
+#undef malloc_usable_size
+
+static void slab_reset(void) {
+    memset(slab_classes, 0, sizeof(slab_classes));
+    memset(slab_caches, 0, sizeof(slab_caches));
+    memset(slab_spans, 0, sizeof(slab_spans));
+    memset(slab_page_map, 0, sizeof(slab_page_map));
+}
+
+
+struct op {
+    size_t id;
+    size_t size;                        // 0 for a free
+};
+
+static struct op *ops;
+static size_t num_ops;
+static size_t max_id;
+
+static void add_op(size_t id, size_t size) {
+    static size_t capacity;
+    if (num_ops == capacity) {
+        capacity = capacity ? 2 * capacity : 1024;
+        ops = realloc(ops, capacity * sizeof(struct op));
+        if (!ops) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    ops[num_ops++] = (struct op){ id, size };
+    if (id > max_id) {
+        max_id = id;
+    }
+}
+
+static void read_trace(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        size_t id, size;
+        if (sscanf(line, "+ %zu %zu", &id, &size) == 2) {
+            add_op(id, size ? size : 1);
+        } else if (sscanf(line, "- %zu", &id) == 1) {
+            add_op(id, 0);
+        }
+    }
+    fclose(file);
+}
+
+// Generates a mix like a network application: many short-lived small objects, some long-lived
+// small objects, and occasional large buffers.
+static void make_trace(size_t count, unsigned seed) {
+    srand(seed);
+    size_t *live = malloc(count * sizeof(size_t));
+    size_t num_live = 0;
+    for (size_t id = 0; id < count; id++) {
+        int r = rand() % 100;
+        size_t size = (r < 60) ? 8 + rand() % 56 : (r < 95) ? 64 + rand() % 192 : 512 + rand() % 3584;
+        add_op(id, size);
+        live[num_live++] = id;
+        // Free a random live object most of the time, so the live set grows slowly.
+        while (num_live && (rand() % 100 < 48)) {
+            size_t i = rand() % num_live;
+            add_op(live[i], 0);
+            live[i] = live[--num_live];
+        }
+    }
+    while (num_live) {
+        add_op(live[--num_live], 0);
+    }
+    free(live);
+}
+
+struct result {
+    size_t peak_live;
+    size_t peak_heap;
+    double ns_per_op;
+};
+
+static struct result replay(void *(*alloc)(size_t), void (*dealloc)(void *)) {
+    void **ptrs = calloc(max_id + 1, sizeof(void *));
+    size_t *sizes = calloc(max_id + 1, sizeof(size_t));
+    size_t live = 0;
+    struct result result = { 0 };
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < num_ops; i++) {
+        struct op *op = &ops[i];
+        if (op->size) {
+            if (ptrs[op->id]) {
+                continue;
+            }
+            ptrs[op->id] = alloc(op->size);
+            if (!ptrs[op->id]) {
+                fprintf(stderr, "out of memory at op %zu\n", i);
+                exit(1);
+            }
+            sizes[op->id] = op->size;
+            live += op->size;
+            if (live > result.peak_live) {
+                result.peak_live = live;
+            }
+        } else if (ptrs[op->id]) {
+            dealloc(ptrs[op->id]);
+            ptrs[op->id] = NULL;
+            live -= sizes[op->id];
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    result.peak_heap = arena_peak;
+    result.ns_per_op = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / num_ops;
+    for (size_t id = 0; id <= max_id; id++) {
+        if (ptrs[id]) {
+            dealloc(ptrs[id]);
+        }
+    }
+    free(ptrs);
+    free(sizes);
+    return result;
+}
+
+static void print_result(const char *name, struct result result) {
+    printf("%-6s peak live %8zu  peak heap %8zu  overhead %5.1f%%  %6.1f ns/op\n", name, result.peak_live, result.peak_heap,
+        100.0 * (result.peak_heap - result.peak_live) / result.peak_live, result.ns_per_op);
+}
+
+int main(int argc, char **argv) {
+    if ((argc >= 3) && (strcmp(argv[1], "-s") == 0)) {
+        make_trace(strtoul(argv[2], NULL, 0), argc >= 4 ? strtoul(argv[3], NULL, 0) : 1);
+    } else if (argc == 2) {
+        read_trace(argv[1]);
+    } else {
+        fprintf(stderr, "usage: %s TRACE | -s COUNT [SEED]\n", argv[0]);
+        return 1;
+    }
+    if (!num_ops) {
+        fprintf(stderr, "empty trace\n");
+        return 1;
+    }
+
+    arena_reset();
+    struct result heap = replay(arena_malloc, arena_free);
+    arena_reset();
+    slab_reset();
+    struct result slab = replay(slab_malloc, slab_free);
+
+    printf("%zu operations\n", num_ops);
+    print_result("malloc", heap);
+    print_result("slab", slab);
+    for (uint cls = 0; cls < SLAB_NUM_CLASSES; cls++) {
+        struct slab_stats stats;
+        slab_get_stats(cls, &stats);
+        printf("  class %3zu: %6u allocs, %4zu pages, %4u refills\n", stats.size, stats.num_allocs, stats.num_pages, stats.num_refills);
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+#define taskENTER_CRITICAL_FROM_ISR() 0
+#define taskEXIT_CRITICAL_FROM_ISR(x) (void)(x)
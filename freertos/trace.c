@@ -0,0 +1,143 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/param.h>
+#include <unistd.h>
+#include "freertos/trace.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+#if configUSE_TRACE_RECORDER
+static_assert((TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1)) == 0);
+static_assert(sizeof(struct trace_event) == 16);
+
+struct trace_buffer {
+    uint32_t count;                     // total events recorded, only written by the owning core
+    struct trace_event events[TRACE_BUFFER_SIZE];
+};
+
+static struct trace_buffer trace_buffers[configNUMBER_OF_CORES];
+static volatile bool trace_enabled;
+static uint32_t trace_num_tasks;
+
+void trace_record(unsigned type, uint32_t arg1, uint32_t arg2) {
+    if (!trace_enabled) {
+        return;
+    }
+    // Masking interrupts makes the write atomic with respect to interrupts on this core. No other
+    // core writes to this core's buffer.
+    UBaseType_t uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+    uint core = portGET_CORE_ID();
+    struct trace_buffer *buffer = &trace_buffers[core];
+    struct trace_event *event = &buffer->events[buffer->count & (TRACE_BUFFER_SIZE - 1)];
+    event->timestamp = portGET_RUN_TIME_COUNTER_VALUE();
+    event->type = type;
+    event->core = core;
+    event->reserved = 0;
+    event->arg1 = arg1;
+    event->arg2 = arg2;
+    buffer->count++;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(uxSavedInterruptStatus);
+}
+
+void trace_task_create(struct tskTaskControlBlock *task) {
+    // FreeRTOS calls this in a critical section, so the counter needs no lock of its own.
+    vTaskSetTaskNumber(task, ++trace_num_tasks);
+    trace_record(TRACE_TASK_CREATE, uxTaskGetTaskNumber(task), 0);
+}
+
+void trace_start(void) {
+    trace_enabled = false;
+    for (int i = 0; i < configNUMBER_OF_CORES; i++) {
+        trace_buffers[i].count = 0;
+    }
+    trace_enabled = true;
+}
+
+void trace_stop(void) {
+    trace_enabled = false;
+}
+
+static int trace_write(int fd, const void *buffer, size_t size) {
+    while (size) {
+        int ret = write(fd, buffer, size);
+        if (ret < 0) {
+            return -1;
+        }
+        buffer += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static int trace_dump_tasks(int fd) {
+    UBaseType_t num_tasks = uxTaskGetNumberOfTasks();
+    TaskStatus_t *status = malloc(num_tasks * sizeof(TaskStatus_t));
+    if (!status) {
+        return -1;
+    }
+    num_tasks = uxTaskGetSystemState(status, num_tasks, NULL);
+
+    int ret = 0;
+    struct trace_header header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .num_cores = configNUMBER_OF_CORES,
+        .timestamp_hz = 1000000,
+        .num_tasks = num_tasks,
+    };
+    if (trace_write(fd, &header, sizeof(header)) < 0) {
+        ret = -1;
+    }
+    for (UBaseType_t i = 0; (ret >= 0) && (i < num_tasks); i++) {
+        struct trace_task task = { .number = uxTaskGetTaskNumber(status[i].xHandle) };
+        strncpy(task.name, status[i].pcTaskName, sizeof(task.name));
+        ret = trace_write(fd, &task, sizeof(task));
+    }
+    free(status);
+    return ret;
+}
+
+int trace_dump(int fd) {
+    bool enabled = trace_enabled;
+    trace_enabled = false;
+
+    int ret = trace_dump_tasks(fd);
+    for (int i = 0; (ret >= 0) && (i < configNUMBER_OF_CORES); i++) {
+        struct trace_buffer *buffer = &trace_buffers[i];
+        // The other core may still be finishing an event it started before recording was paused.
+        // That event is written to the slot after the last counted one, which is the oldest event
+        // if the buffer has wrapped, so skip the oldest event in that case.
+        uint32_t end = buffer->count;
+        uint32_t begin = (end > TRACE_BUFFER_SIZE - 1) ? end - (TRACE_BUFFER_SIZE - 1) : 0;
+        uint32_t count = end - begin;
+        ret = trace_write(fd, &count, sizeof(count));
+        while ((ret >= 0) && (begin != end)) {
+            uint32_t index = begin & (TRACE_BUFFER_SIZE - 1);
+            uint32_t n = MIN(end - begin, TRACE_BUFFER_SIZE - index);
+            ret = trace_write(fd, &buffer->events[index], n * sizeof(struct trace_event));
+            begin += n;
+        }
+    }
+
+    trace_enabled = enabled;
+    return ret;
+}
+#else
+void trace_start(void) {
+}
+
+void trace_stop(void) {
+}
+
+int trace_dump(int fd) {
+    errno = ENOTSUP;
+    return -1;
+}
+#endif
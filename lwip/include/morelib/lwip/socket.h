@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "morelib/mem_tier.h"
 #include "morelib/socket.h"
 
 #include "lwip/err.h"
@@ -10,6 +11,22 @@
 #include "lwip/pbuf.h"
 
 
+// Number of lwIP sockets preallocated in a pool. More sockets are allocated from the heap.
+#ifndef SOCKET_LWIP_POOL_SIZE
+#define SOCKET_LWIP_POOL_SIZE 8
+#endif
+
+// Number of pending TCP connections preallocated in a pool, shared by all listening sockets
+#ifndef SOCKET_TCP_ACCEPT_POOL_SIZE
+#define SOCKET_TCP_ACCEPT_POOL_SIZE 4
+#endif
+
+// Memory hint for the lwIP heap. Network drivers DMA to and from pbufs, so by default they stay
+// in SRAM.
+#ifndef SOCKET_LWIP_MEM_HINT
+#define SOCKET_LWIP_MEM_HINT MEM_DMA
+#endif
+
 struct socket_lwip {
     struct socket base;
     union {
@@ -33,6 +50,13 @@ struct socket_lwip {
 
 struct socket_lwip *socket_lwip_alloc(const struct socket_vtable *vtable, int domain, int type, int protocol);
 
+// Allocators for the lwIP heap that follow SOCKET_LWIP_MEM_HINT. To use them, define in lwipopts.h
+// MEM_LIBC_MALLOC to 1 and mem_clib_malloc, mem_clib_calloc and mem_clib_free to these functions.
+// With MEMP_MEM_MALLOC also 1, pbuf pools come from this heap too.
+void *socket_lwip_mem_malloc(size_t size);
+void *socket_lwip_mem_calloc(size_t num, size_t size);
+void socket_lwip_mem_free(void *ptr);
+
 // pbuf helpers
 struct pbuf *pbuf_advance(struct pbuf *p, u16_t *offset, u16_t len);
 struct pbuf *pbuf_concat(struct pbuf *p, struct pbuf *new_p);
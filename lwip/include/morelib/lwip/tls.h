@@ -13,6 +13,12 @@
 #define SOCKET_TLS_FLAG_DO_HANDSHAKE_ON_CONNECT 2
 #define SOCKET_TLS_FLAG_SUPPRESS_RAGGED_EOFS 4
 
+// Memory hint for mbedTLS allocations, which include the record buffers of every connection.
+// Only used if MBEDTLS_PLATFORM_MEMORY is defined.
+#ifndef SOCKET_TLS_MEM_HINT
+#define SOCKET_TLS_MEM_HINT MEM_BULK
+#endif
+
 #ifdef MBEDTLS_X509_TRUSTED_CERTIFICATE_CALLBACK
 struct socket_tls_ca_cert {
     struct socket_tls_ca_cert *next;
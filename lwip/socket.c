@@ -9,8 +9,11 @@
 #include "lwip/ip.h"
 
 #include "morelib/lwip/socket.h"
+#include "morelib/pool.h"
 
 
+POOL_DEFINE(socket_lwip_pool, struct socket_lwip, SOCKET_LWIP_POOL_SIZE)
+
 __attribute__((visibility("hidden")))
 int socket_lwip_check_ret(err_t err) {
     if (err >= 0) {
@@ -24,7 +27,7 @@ int socket_lwip_check_ret(err_t err) {
 
 __attribute__((visibility("hidden")))
 struct socket_lwip *socket_lwip_alloc(const struct socket_vtable *vtable, int domain, int type, int protocol) {
-    struct socket_lwip *socket = socket_alloc(sizeof(struct socket_lwip), vtable, domain, type, protocol);
+    struct socket_lwip *socket = socket_alloc_pooled(&socket_lwip_pool, vtable, domain, type, protocol);
     if (!socket) {
         return NULL;
     }
@@ -32,6 +35,18 @@ struct socket_lwip *socket_lwip_alloc(const struct socket_vtable *vtable, int do
     return socket;
 }
 
+void *socket_lwip_mem_malloc(size_t size) {
+    return mem_tier_malloc(size, SOCKET_LWIP_MEM_HINT);
+}
+
+void *socket_lwip_mem_calloc(size_t num, size_t size) {
+    return mem_tier_calloc(num, size, SOCKET_LWIP_MEM_HINT);
+}
+
+void socket_lwip_mem_free(void *ptr) {
+    mem_tier_free(ptr);
+}
+
 __attribute__((visibility("hidden")))
 int socket_domain_to_lwip(int domain, u8_t *iptype) {
     switch (domain) {
@@ -316,7 +331,8 @@ static struct socket *socket_lwip_create(int domain, int type, int protocol) {
     return vtable(domain, type, protocol);
 }
 
-int socketpair(int domain, int type, int protocol, int socket_vector[2]) {
+// Creates a connected pair over loopback. AF_UNIX sockets are a cheaper way to do this.
+static int socket_lwip_socketpair(int domain, int type, int protocol, int socket_vector[2]) {
     u8_t iptype;
     if (socket_domain_to_lwip(domain, &iptype) < 0) {
         return -1;
@@ -391,6 +407,7 @@ const struct socket_family lwip_ipv4_af = {
     .socket = socket_lwip_create,
     .getaddrinfo = lwip_getaddrinfo,
     .getnameinfo = lwip_getnameinfo,
+    .socketpair = socket_lwip_socketpair,
 };
 #endif
 
@@ -400,5 +417,6 @@ const struct socket_family lwip_ipv6_af = {
     .socket = socket_lwip_create,
     .getaddrinfo = lwip_getaddrinfo,
     .getnameinfo = lwip_getnameinfo,
+    .socketpair = socket_lwip_socketpair,
 };
 #endif
\ No newline at end of file
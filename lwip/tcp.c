@@ -8,6 +8,7 @@
 #include "lwip/tcp.h"
 
 #include "morelib/lwip/socket.h"
+#include "morelib/pool.h"
 
 
 static void socket_tcp_lwip_err(void *arg, err_t err) {
@@ -71,6 +72,8 @@ struct socket_tcp_accept_result {
     u16_t port;
 };
 
+POOL_DEFINE(socket_tcp_accept_pool, struct socket_tcp_accept_result, SOCKET_TCP_ACCEPT_POOL_SIZE)
+
 static void socket_tcp_lwip_new_accept(struct socket_tcp_accept_result *accept_result, struct socket_lwip *new_socket) {
     struct tcp_pcb *new_pcb = accept_result->new_pcb;
     LOCK_TCPIP_CORE();
@@ -92,7 +95,7 @@ static void socket_tcp_lwip_new_accept(struct socket_tcp_accept_result *accept_r
         tcp_abort(new_pcb);
     }
     UNLOCK_TCPIP_CORE();
-    free(accept_result);
+    pool_free(accept_result);
 }
 
 static struct socket *socket_tcp_accept(void *ctx, struct sockaddr *address, socklen_t *address_len) {
@@ -244,7 +247,7 @@ static err_t socket_tcp_lwip_accept(void *arg, struct tcp_pcb *new_pcb, err_t er
     // printf(", remote=%s:%hu, err=%i\n", ipaddr_ntoa(&new_pcb->remote_ip), new_pcb->remote_port, (int)err);
     struct socket_lwip *socket = arg;
 
-    struct socket_tcp_accept_result *accept_result = calloc(1, sizeof(struct socket_tcp_accept_result));
+    struct socket_tcp_accept_result *accept_result = pool_calloc(&socket_tcp_accept_pool);
     if (!accept_result) {
         tcp_abort(new_pcb);
         return ERR_ABRT;
@@ -264,7 +267,7 @@ static err_t socket_tcp_lwip_accept(void *arg, struct tcp_pcb *new_pcb, err_t er
     if (socket_lwip_push(socket, &accept_result, sizeof(accept_result)) < 0) {
         socket_unlock(&socket->base);
         tcp_abort(new_pcb);
-        free(accept_result);
+        pool_free(accept_result);
         return ERR_ABRT;
     }
     socket_unlock(&socket->base);
@@ -24,10 +24,19 @@
 
 static mbedtls_entropy_context socket_tls_entropy;
 
+#if defined(MBEDTLS_PLATFORM_MEMORY) && !defined(MBEDTLS_PLATFORM_CALLOC_MACRO)
+static void *socket_tls_calloc(size_t num, size_t size) {
+    return mem_tier_calloc(num, size, SOCKET_TLS_MEM_HINT);
+}
+#endif
+
 __attribute__((constructor))
 void socket_tls_init() {
 #ifdef MBEDTLS_DEBUG_C
     mbedtls_debug_set_threshold(1);
+#endif
+#if defined(MBEDTLS_PLATFORM_MEMORY) && !defined(MBEDTLS_PLATFORM_CALLOC_MACRO)
+    mbedtls_platform_set_calloc_free(socket_tls_calloc, mem_tier_free);
 #endif
     mbedtls_entropy_init(&socket_tls_entropy);
 }
@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include "morelib/coro.h"
+
+
+static void coro_resume(struct coro *co) {
+    // Whatever woke the coroutine, cancel the other wake-ups of the wait.
+    evloop_watch_stop(&co->watch);
+    evloop_timer_stop(&co->timer);
+    evloop_defer_cancel(&co->defer);
+
+    if (co->func(co) == CORO_DONE) {
+        co->line = 0;
+        if (co->done) {
+            co->done(co);
+        }
+    }
+}
+
+static void coro_watch_cb(struct evloop_watch *watch, int fd, uint revents) {
+    struct coro *co = (void *)watch - offsetof(struct coro, watch);
+    coro_resume(co);
+}
+
+static void coro_timer_cb(struct evloop_timer *timer) {
+    struct coro *co = (void *)timer - offsetof(struct coro, timer);
+    if (co->watch.file) {
+        co->flags |= CORO_FLAG_TIMED_OUT;
+    }
+    coro_resume(co);
+}
+
+static void coro_defer_cb(struct evloop_defer *defer) {
+    struct coro *co = (void *)defer - offsetof(struct coro, defer);
+    coro_resume(co);
+}
+
+void coro_init(struct evloop *loop, struct coro *co, coro_func_t func, coro_done_t done) {
+    memset(&co->watch, 0, sizeof(co->watch));
+    evloop_timer_init(loop, &co->timer, coro_timer_cb, NULL);
+    evloop_defer_init(loop, &co->defer, coro_defer_cb, NULL);
+    co->func = func;
+    co->done = done;
+    co->timeout = portMAX_DELAY;
+    co->line = 0;
+    co->flags = 0;
+}
+
+void coro_start(struct coro *co) {
+    coro_stop(co);
+    co->line = 0;
+    co->flags = 0;
+    coro_wake(co);
+}
+
+void coro_stop(struct coro *co) {
+    evloop_watch_stop(&co->watch);
+    evloop_timer_stop(&co->timer);
+    evloop_defer_cancel(&co->defer);
+}
+
+void coro_wake(struct coro *co) {
+    evloop_defer_post(&co->defer);
+}
+
+void coro_wake_from_isr(struct coro *co, BaseType_t *pxHigherPriorityTaskWoken) {
+    evloop_defer_post_from_isr(&co->defer, pxHigherPriorityTaskWoken);
+}
+
+void coro_set_timeout(struct coro *co, TickType_t xTicksToWait) {
+    co->timeout = xTicksToWait;
+}
+
+void coro_sleep(struct coro *co, TickType_t xTicksToWait) {
+    evloop_timer_start(&co->timer, xTicksToWait, 0);
+}
+
+int coro_wait_fd(struct coro *co, int fd, uint events) {
+    if (evloop_watch_start(co->defer.loop, &co->watch, fd, events, coro_watch_cb, NULL) < 0) {
+        return -1;
+    }
+    if (co->timeout != portMAX_DELAY) {
+        evloop_timer_start(&co->timer, co->timeout, 0);
+    }
+    return 0;
+}
+
+// Completes a file operation that returned ret. If it would block, waits for events on the file
+// and fails with EAGAIN. If the previous wait timed out, fails with ETIMEDOUT instead.
+static int coro_check(struct coro *co, int ret, int fd, uint events) {
+    if ((ret >= 0) || (errno != EAGAIN)) {
+        co->flags &= ~CORO_FLAG_TIMED_OUT;
+        return ret;
+    }
+    if (co->flags & CORO_FLAG_TIMED_OUT) {
+        co->flags &= ~CORO_FLAG_TIMED_OUT;
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    if (coro_wait_fd(co, fd, events) < 0) {
+        return -1;
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+int coro_read(struct coro *co, int fd, void *buffer, size_t size) {
+    int ret = read(fd, buffer, size);
+    return coro_check(co, ret, fd, POLLIN);
+}
+
+int coro_write(struct coro *co, int fd, const void *buffer, size_t size) {
+    int ret = write(fd, buffer, size);
+    return coro_check(co, ret, fd, POLLOUT);
+}
+
+int coro_accept(struct coro *co, int fd, struct sockaddr *address, socklen_t *address_len) {
+    int ret = accept(fd, address, address_len);
+    if ((ret >= 0) && (fcntl(ret, F_SETFL, fcntl(ret, F_GETFL) | O_NONBLOCK) < 0)) {
+        close(ret);
+        ret = -1;
+    }
+    return coro_check(co, ret, fd, POLLIN);
+}
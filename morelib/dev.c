@@ -59,6 +59,11 @@ void dev_lock(void) {
     xSemaphoreTakeRecursive(dev_mutex, portMAX_DELAY);
 }
 
+__attribute__((visibility("hidden")))
+bool dev_try_lock(void) {
+    return xSemaphoreTakeRecursive(dev_mutex, 0);
+}
+
 __attribute__((visibility("hidden")))
 void dev_unlock(void) {
     xSemaphoreGiveRecursive(dev_mutex);
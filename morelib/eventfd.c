@@ -2,23 +2,39 @@
 // SPDX-License-Identifier: MIT
 
 #include <errno.h>
-#include <malloc.h>
+#include <stddef.h>
 #include <sys/eventfd.h>
 #include <sys/time.h>
 #include <sys/timerfd.h>
-#include "freertos/timers.h"
+#include "freertos/timer_wheel.h"
 #include "morelib/poll.h"
+#include "morelib/pool.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
-#include "timers.h"
 
 
+// Number of eventfds and timerfds preallocated in pools. More are allocated from the heap.
+#ifndef EVENTFD_POOL_SIZE
+#define EVENTFD_POOL_SIZE 2
+#endif
+
+#ifndef TIMERFD_POOL_SIZE
+#define TIMERFD_POOL_SIZE 2
+#endif
+
 struct eventfd {
     struct poll_file base;
     uint64_t value;
 };
 
+POOL_DEFINE(eventfd_pool, struct eventfd, EVENTFD_POOL_SIZE)
+
+static int eventfd_close(void *ctx) {
+    pool_free(ctx);
+    return 0;
+}
+
 static int eventfd_read(void *ctx, void *buffer, size_t size) {
     struct eventfd *file = ctx;
     if (size < sizeof(uint64_t)) {
@@ -84,12 +100,13 @@ static int eventfd_write(void *ctx, const void *buffer, size_t size) {
 
 static const struct vfs_file_vtable eventfd_vtable = {
     .pollable = 1,
+    .close = eventfd_close,
     .read = eventfd_read,
     .write = eventfd_write,
 };
 
 int eventfd(unsigned int initval, int flags) {
-    struct eventfd *file = calloc(1, sizeof(struct eventfd));
+    struct eventfd *file = pool_calloc(&eventfd_pool);
     if (!file) {
         return -1;
     }
@@ -107,17 +124,15 @@ int eventfd(unsigned int initval, int flags) {
 struct timerfd {
     struct eventfd base;
     int clockid;
-    TickType_t value;
-    TickType_t interval;
-    TimerHandle_t timer;
-    StaticTimer_t xTimerBuffer;
+    struct timer_wheel_entry timer;
 };
 
+POOL_DEFINE(timerfd_pool, struct timerfd, TIMERFD_POOL_SIZE)
+
 int timerfd_close(void *ctx) {
     struct timerfd *file = ctx;
-    xTimerDelete(file->timer, portMAX_DELAY);
-    xTimerSyncTimerDaemon();
-    free(file);
+    timer_wheel_stop(&file->timer);
+    pool_free(file);
     return 0;
 }
 
@@ -127,22 +142,11 @@ static const struct vfs_file_vtable timerfd_vtable = {
     .read = eventfd_read,
 };
 
-static void timerfd_callback(TimerHandle_t xTimer) {
-    struct timerfd *file = pvTimerGetTimerID(xTimer);
-    assert(file->timer == xTimer);
-    taskENTER_CRITICAL();
+static void timerfd_callback(struct timer_wheel_entry *entry, BaseType_t *pxHigherPriorityTaskWoken) {
+    // Called from the tick interrupt. The timer wheel rearms periodic timers itself.
+    struct timerfd *file = (void *)entry - offsetof(struct timerfd, timer);
     file->base.value++;
-    poll_file_notify(&file->base.base, 0, POLLIN);
-    taskEXIT_CRITICAL();
-
-    if (file->value) {
-        if (file->interval) {
-            xTimerChangePeriod(xTimer, file->interval, portMAX_DELAY);
-        } else {
-            xTimerStop(xTimer, portMAX_DELAY);
-        }
-        file->value = 0;
-    }
+    poll_file_notify_from_isr(&file->base.base, 0, POLLIN, pxHigherPriorityTaskWoken);
 }
 
 int timerfd_create(int clockid, int flags) {
@@ -151,13 +155,13 @@ int timerfd_create(int clockid, int flags) {
         return -1;
     }
 
-    struct timerfd *file = calloc(1, sizeof(struct timerfd));
+    struct timerfd *file = pool_calloc(&timerfd_pool);
     if (!file) {
         return -1;
     }
 
     poll_file_init(&file->base.base, &timerfd_vtable, O_RDWR | (flags & ~O_ACCMODE), 0);
-    file->timer = xTimerCreateStatic("timerfd", portMAX_DELAY, pdFALSE, file, timerfd_callback, &file->xTimerBuffer);
+    timer_wheel_entry_init(&file->timer, timerfd_callback);
     file->clockid = clockid;
 
     int ret = poll_file_fd(&file->base.base);
@@ -191,11 +195,12 @@ static void ticks_to_timespec(TickType_t ticks, struct timespec *ts) {
 
 static void timerfd_gettime_internal(struct timerfd *file, struct itimerspec *value) {
     memset(value, 0, sizeof(*value));
-    if (file->timer && xTimerIsTimerActive(file->timer)) {
-        TickType_t ticks = xTimerGetExpiryTime(file->timer) - xTaskGetTickCount();
-        ticks_to_timespec(ticks, &value->it_value);
-        ticks_to_timespec(xTimerGetPeriod(file->timer), &value->it_interval);
+    taskENTER_CRITICAL();
+    if (timer_wheel_is_active(&file->timer)) {
+        ticks_to_timespec(timer_wheel_remaining(&file->timer), &value->it_value);
+        ticks_to_timespec(file->timer.period, &value->it_interval);
     }
+    taskEXIT_CRITICAL();
 }
 
 int timerfd_settime(int fd, int flags, const struct itimerspec *new_value, struct itimerspec *old_value) {
@@ -204,10 +209,11 @@ int timerfd_settime(int fd, int flags, const struct itimerspec *new_value, struc
         return -1;
     }
 
+    int ret = -1;
     struct timespec ts = new_value->it_value;
     if (flags & TFD_TIMER_ABSTIME) {
         if (clock_gettime(file->clockid, &ts) < 0) {
-            return -1;
+            goto exit;
         }
         timespecsub(&new_value->it_value, &ts, &ts);
     }
@@ -216,17 +222,18 @@ int timerfd_settime(int fd, int flags, const struct itimerspec *new_value, struc
         timerfd_gettime_internal(file, old_value);
     }
 
-    xTimerStop(file->timer, portMAX_DELAY);
-    xTimerSyncTimerDaemon();
-
-    file->value = timespec_to_ticks(&ts);
-    file->interval = timespec_to_ticks(&new_value->it_interval);
-    if (file->value || file->interval) {
-        file->timer = xTimerCreateStatic("timerfd", file->value ? file->value : file->interval, file->interval ? pdTRUE : pdFALSE, file, timerfd_callback, &file->xTimerBuffer);
-        xTimerStart(file->timer, portMAX_DELAY);
+    TickType_t value = timespec_to_ticks(&ts);
+    TickType_t interval = timespec_to_ticks(&new_value->it_interval);
+    if (value || interval) {
+        timer_wheel_start(&file->timer, value ? value : interval, interval);
+    } else {
+        timer_wheel_stop(&file->timer);
     }
+    ret = 0;
 
-    return 0;
+exit:
+    poll_file_release(&file->base.base);
+    return ret;
 }
 
 int timerfd_gettime(int fd, struct itimerspec *curr_value) {
@@ -235,5 +242,6 @@ int timerfd_gettime(int fd, struct itimerspec *curr_value) {
         return -1;
     }
     timerfd_gettime_internal(file, curr_value);
+    poll_file_release(&file->base.base);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,293 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <stddef.h>
+#include "morelib/evloop.h"
+
+
+static void evloop_event_init(struct evloop_event *event, void (*dispatch)(struct evloop_event *event)) {
+    event->next = NULL;
+    event->prev = NULL;
+    event->dispatch = dispatch;
+}
+
+// Appends an event to the loop's ready queue if it is not already queued. Must be called in a critical section.
+static void evloop_event_link(struct evloop *loop, struct evloop_event *event) {
+    if (event->next) {
+        return;
+    }
+    event->next = &loop->ready;
+    event->prev = loop->ready.prev;
+    loop->ready.prev->next = event;
+    loop->ready.prev = event;
+}
+
+// Removes an event from whichever queue it is on. Must be called in a critical section.
+static void evloop_event_unlink(struct evloop_event *event) {
+    if (!event->next) {
+        return;
+    }
+    event->next->prev = event->prev;
+    event->prev->next = event->next;
+    event->next = NULL;
+    event->prev = NULL;
+}
+
+// Queues an event and wakes the loop's task. Must be called in a critical section.
+static void evloop_event_queue(struct evloop *loop, struct evloop_event *event, BaseType_t *pxHigherPriorityTaskWoken) {
+    evloop_event_link(loop, event);
+    if (!loop->task) {
+        return;
+    }
+    if (pxHigherPriorityTaskWoken) {
+        vTaskNotifyGiveFromISR(loop->task, pxHigherPriorityTaskWoken);
+    }
+    else {
+        xTaskNotifyGive(loop->task);
+    }
+}
+
+void evloop_init(struct evloop *loop) {
+    loop->ready.next = &loop->ready;
+    loop->ready.prev = &loop->ready;
+    loop->ready.dispatch = NULL;
+    loop->idles = NULL;
+    loop->idle_cursor = NULL;
+    loop->task = NULL;
+    loop->stopped = false;
+}
+
+void evloop_deinit(struct evloop *loop) {
+    taskENTER_CRITICAL();
+    assert(loop->ready.next == &loop->ready);
+    loop->task = NULL;
+    taskEXIT_CRITICAL();
+}
+
+static bool evloop_is_empty(struct evloop *loop) {
+    taskENTER_CRITICAL();
+    bool empty = loop->ready.next == &loop->ready;
+    taskEXIT_CRITICAL();
+    return empty;
+}
+
+static void evloop_run_idles(struct evloop *loop) {
+    // The cursor lets an idle callback stop any idle handler, including the next one.
+    loop->idle_cursor = loop->idles;
+    struct evloop_idle *idle;
+    while ((idle = loop->idle_cursor)) {
+        loop->idle_cursor = idle->next;
+        idle->cb(idle);
+    }
+}
+
+int evloop_run_once(struct evloop *loop, TickType_t xTicksToWait) {
+    taskENTER_CRITICAL();
+    loop->task = xTaskGetCurrentTaskHandle();
+    taskEXIT_CRITICAL();
+
+    if (evloop_is_empty(loop)) {
+        evloop_run_idles(loop);
+        // A notification sent after the queue was checked makes poll_wait return immediately.
+        if (evloop_is_empty(loop) && xTicksToWait && (poll_wait(&xTicksToWait) < 0)) {
+            return -1;
+        }
+    }
+
+    // Take the currently ready events, so that events requeued during dispatch wait for the next iteration.
+    struct evloop_event pending;
+    taskENTER_CRITICAL();
+    if (loop->ready.next == &loop->ready) {
+        pending.next = &pending;
+        pending.prev = &pending;
+    } else {
+        pending.next = loop->ready.next;
+        pending.prev = loop->ready.prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        loop->ready.next = &loop->ready;
+        loop->ready.prev = &loop->ready;
+    }
+    taskEXIT_CRITICAL();
+
+    int count = 0;
+    for (;;) {
+        taskENTER_CRITICAL();
+        struct evloop_event *event = pending.next;
+        if (event != &pending) {
+            evloop_event_unlink(event);
+        }
+        taskEXIT_CRITICAL();
+        if (event == &pending) {
+            break;
+        }
+        event->dispatch(event);
+        count++;
+    }
+    return count;
+}
+
+int evloop_run(struct evloop *loop) {
+    int ret = 0;
+    while (!loop->stopped) {
+        if (evloop_run_once(loop, portMAX_DELAY) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+    loop->stopped = false;
+    return ret;
+}
+
+void evloop_stop(struct evloop *loop) {
+    taskENTER_CRITICAL();
+    loop->stopped = true;
+    if (loop->task) {
+        xTaskNotifyGive(loop->task);
+    }
+    taskEXIT_CRITICAL();
+}
+
+
+static void evloop_watch_notify(const void *ptr, BaseType_t *pxHigherPriorityTaskWoken) {
+    // Called in the poll_file's critical section, possibly from an interrupt.
+    struct evloop_watch *watch = (void *)ptr;
+    evloop_event_queue(watch->loop, &watch->event, pxHigherPriorityTaskWoken);
+}
+
+static void evloop_watch_dispatch(struct evloop_event *event) {
+    struct evloop_watch *watch = (void *)event - offsetof(struct evloop_watch, event);
+    uint revents = poll_file_poll(watch->file) & watch->base.events;
+    if (!revents) {
+        return;
+    }
+    // Waiters are only notified of new events, so check again on the next iteration in case the
+    // callback does not consume all the readiness. This must happen before the callback since the
+    // callback may stop the watch.
+    taskENTER_CRITICAL();
+    evloop_event_link(watch->loop, event);
+    taskEXIT_CRITICAL();
+    watch->cb(watch, watch->fd, revents);
+}
+
+int evloop_watch_start(struct evloop *loop, struct evloop_watch *watch, int fd, uint events, evloop_watch_cb_t cb, void *arg) {
+    struct poll_file *file = poll_file_acquire(fd, 0);
+    if (!file) {
+        return -1;
+    }
+    poll_waiter_init(&watch->base, events, evloop_watch_notify);
+    evloop_event_init(&watch->event, evloop_watch_dispatch);
+    watch->loop = loop;
+    watch->file = file;
+    watch->fd = fd;
+    watch->cb = cb;
+    watch->arg = arg;
+    poll_waiter_add(file, &watch->base);
+    return 0;
+}
+
+void evloop_watch_modify(struct evloop_watch *watch, uint events) {
+    taskENTER_CRITICAL();
+    watch->base.events = events | POLLCOM;
+    taskEXIT_CRITICAL();
+    poll_waiter_modify(watch->file, &watch->base);
+}
+
+void evloop_watch_stop(struct evloop_watch *watch) {
+    if (!watch->file) {
+        return;
+    }
+    poll_waiter_remove(watch->file, &watch->base);
+    taskENTER_CRITICAL();
+    evloop_event_unlink(&watch->event);
+    taskEXIT_CRITICAL();
+    poll_file_release(watch->file);
+    watch->file = NULL;
+}
+
+
+static void evloop_timer_expire(struct timer_wheel_entry *entry, BaseType_t *pxHigherPriorityTaskWoken) {
+    // Called from the tick interrupt.
+    struct evloop_timer *timer = (void *)entry;
+    evloop_event_queue(timer->loop, &timer->event, pxHigherPriorityTaskWoken);
+}
+
+static void evloop_timer_dispatch(struct evloop_event *event) {
+    struct evloop_timer *timer = (void *)event - offsetof(struct evloop_timer, event);
+    timer->cb(timer);
+}
+
+void evloop_timer_init(struct evloop *loop, struct evloop_timer *timer, evloop_timer_cb_t cb, void *arg) {
+    timer_wheel_entry_init(&timer->entry, evloop_timer_expire);
+    evloop_event_init(&timer->event, evloop_timer_dispatch);
+    timer->loop = loop;
+    timer->cb = cb;
+    timer->arg = arg;
+}
+
+void evloop_timer_start(struct evloop_timer *timer, TickType_t delay, TickType_t period) {
+    timer_wheel_start(&timer->entry, delay, period);
+}
+
+void evloop_timer_stop(struct evloop_timer *timer) {
+    timer_wheel_stop(&timer->entry);
+    taskENTER_CRITICAL();
+    evloop_event_unlink(&timer->event);
+    taskEXIT_CRITICAL();
+}
+
+
+void evloop_idle_start(struct evloop *loop, struct evloop_idle *idle, evloop_idle_cb_t cb, void *arg) {
+    idle->cb = cb;
+    idle->arg = arg;
+    idle->next = loop->idles;
+    loop->idles = idle;
+}
+
+void evloop_idle_stop(struct evloop *loop, struct evloop_idle *idle) {
+    if (loop->idle_cursor == idle) {
+        loop->idle_cursor = idle->next;
+    }
+    struct evloop_idle **pidle = &loop->idles;
+    while (*pidle) {
+        if (*pidle == idle) {
+            *pidle = idle->next;
+            break;
+        }
+        pidle = &(*pidle)->next;
+    }
+}
+
+
+static void evloop_defer_dispatch(struct evloop_event *event) {
+    struct evloop_defer *defer = (void *)event;
+    defer->cb(defer);
+}
+
+void evloop_defer_init(struct evloop *loop, struct evloop_defer *defer, evloop_defer_cb_t cb, void *arg) {
+    evloop_event_init(&defer->event, evloop_defer_dispatch);
+    defer->loop = loop;
+    defer->cb = cb;
+    defer->arg = arg;
+}
+
+void evloop_defer_post_from_isr(struct evloop_defer *defer, BaseType_t *pxHigherPriorityTaskWoken) {
+    UBaseType_t uxSavedInterruptStatus;
+    if (pxHigherPriorityTaskWoken) {
+        uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    } else {
+        taskENTER_CRITICAL();
+    }
+    evloop_event_queue(defer->loop, &defer->event, pxHigherPriorityTaskWoken);
+    if (pxHigherPriorityTaskWoken) {
+        taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+    } else {
+        taskEXIT_CRITICAL();
+    }
+}
+
+void evloop_defer_cancel(struct evloop_defer *defer) {
+    taskENTER_CRITICAL();
+    evloop_event_unlink(&defer->event);
+    taskEXIT_CRITICAL();
+}
@@ -2,8 +2,9 @@
 // SPDX-License-Identifier: MIT
 
 #include <errno.h>
-#include <fcntl.h>
-#include "morelib/vfs.h"
+#include "morelib/fcntl.h"
+#include "morelib/pipe.h"
+#include "morelib/poll.h"
 
 
 int fcntl(int fd, int cmd, ...) {
@@ -26,6 +27,43 @@ int fcntl(int fd, int cmd, ...) {
             ret = 0;
             break;
         }
+        case F_SETPIPE_SZ: {
+            ret = pipe_set_size(file, va_arg(args, int));
+            break;
+        }
+        case F_GETPIPE_SZ: {
+            ret = pipe_get_size(file);
+            break;
+        }
+        case F_SETBUSYPOLL: {
+            int budget = va_arg(args, int);
+            if (!file->func->pollable || (budget < 0)) {
+                errno = EINVAL;
+                break;
+            }
+            ((struct poll_file *)file)->busy_poll = budget;
+            ret = 0;
+            break;
+        }
+        case F_GETBUSYPOLL: {
+            if (!file->func->pollable) {
+                errno = EINVAL;
+                break;
+            }
+            ret = ((struct poll_file *)file)->busy_poll;
+            break;
+        }
+        case F_GETBUSYPOLLSTATS: {
+            struct busy_poll_stats *stats = va_arg(args, struct busy_poll_stats *);
+            if (!file->func->pollable) {
+                errno = EINVAL;
+                break;
+            }
+            stats->hits = ((struct poll_file *)file)->busy_poll_hits;
+            stats->misses = ((struct poll_file *)file)->busy_poll_misses;
+            ret = 0;
+            break;
+        }
         default: {
             errno = EINVAL;
             break;
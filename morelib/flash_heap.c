@@ -9,6 +9,7 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include "morelib/flash_heap.h"
+#include "morelib/mem_tier.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -78,13 +79,13 @@ void flash_heap_init(void) {
         }
         header = ((void *)header) + header->flash_size;
     }
-    flash_heap_tail[0] = header;
+    flash_heap_tail[FLASH_HEAP_DEVICE_FLASH] = header;
 
     #if PSRAM_BASE
     // PSRAM section is not initialized with data and BSS sections. Initialize its only variable here.
     flash_heap_psram_head = (flash_heap_header_t) { 0, 0, 0, &__StackLimit, NULL };
     // PSRAM is cleared on reset, so reset tail to head.
-    flash_heap_tail[1] = flash_heap_head[1];
+    flash_heap_tail[FLASH_HEAP_DEVICE_PSRAM] = flash_heap_head[FLASH_HEAP_DEVICE_PSRAM];
     #endif
 }
 
@@ -116,6 +117,10 @@ int flash_heap_open(flash_heap_t *file, uint device, uint32_t type) {
     file->flash_start = (flash_ptr_t)tail;
     file->flash_end = file->flash_start + sizeof(flash_heap_header_t);
     file->flash_limit = base + size;
+    if (device == FLASH_HEAP_DEVICE_PSRAM) {
+        // The top of PSRAM belongs to the PSRAM memory tier.
+        file->flash_limit -= mem_tier_psram_size((const void *)base, size);
+    }
     file->flash_pos = file->flash_end;
 
     file->ram_start = (flash_ptr_t)tail->ram_base;
@@ -0,0 +1,93 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "morelib/futex.h"
+
+
+struct futex_waiter {
+    struct futex_waiter *next;
+    atomic_uint *addr;
+    TaskHandle_t task;
+    bool woken;
+};
+
+// Waiters are hashed by address. All buckets are protected by critical section.
+static struct futex_waiter *futex_buckets[FUTEX_NUM_BUCKETS];
+
+static struct futex_waiter **futex_bucket(atomic_uint *addr) {
+    uintptr_t hash = (uintptr_t)addr;
+    hash ^= hash >> 7;
+    return &futex_buckets[(hash >> 2) % FUTEX_NUM_BUCKETS];
+}
+
+int futex_wait(atomic_uint *addr, uint expected, TickType_t *pxTicksToWait) {
+    struct futex_waiter waiter = {
+        .next = NULL,
+        .addr = addr,
+        .task = xTaskGetCurrentTaskHandle(),
+        .woken = false,
+    };
+    struct futex_waiter **bucket = futex_bucket(addr);
+
+    taskENTER_CRITICAL();
+    if (atomic_load_explicit(addr, memory_order_relaxed) != expected) {
+        taskEXIT_CRITICAL();
+        errno = EAGAIN;
+        return -1;
+    }
+    // Discard a notification left over from an earlier wait that timed out as it was woken.
+    ulTaskNotifyValueClearIndexed(NULL, FUTEX_NOTIFY_INDEX, UINT32_MAX);
+    xTaskNotifyStateClearIndexed(NULL, FUTEX_NOTIFY_INDEX);
+    struct futex_waiter **pwaiter = bucket;
+    while (*pwaiter) {
+        pwaiter = &(*pwaiter)->next;
+    }
+    *pwaiter = &waiter;
+    taskEXIT_CRITICAL();
+
+    TimeOut_t xTimeOut;
+    vTaskSetTimeOutState(&xTimeOut);
+    ulTaskNotifyTakeIndexed(FUTEX_NOTIFY_INDEX, pdTRUE, *pxTicksToWait);
+
+    taskENTER_CRITICAL();
+    bool woken = waiter.woken;
+    if (!woken) {
+        pwaiter = bucket;
+        while (*pwaiter != &waiter) {
+            pwaiter = &(*pwaiter)->next;
+        }
+        *pwaiter = waiter.next;
+    }
+    taskEXIT_CRITICAL();
+
+    // Updates the remaining time even after a wake, so a caller that waits again in a loop keeps to
+    // its original deadline.
+    bool timed_out = xTaskCheckForTimeOut(&xTimeOut, pxTicksToWait);
+    if (!woken && timed_out) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    return 0;
+}
+
+int futex_wake(atomic_uint *addr, int count) {
+    int woken = 0;
+    taskENTER_CRITICAL();
+    struct futex_waiter **pwaiter = futex_bucket(addr);
+    while (*pwaiter && (woken < count)) {
+        struct futex_waiter *waiter = *pwaiter;
+        if (waiter->addr == addr) {
+            *pwaiter = waiter->next;
+            waiter->woken = true;
+            xTaskNotifyGiveIndexed(waiter->task, FUTEX_NOTIFY_INDEX);
+            woken++;
+        } else {
+            pwaiter = &waiter->next;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return woken;
+}
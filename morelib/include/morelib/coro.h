@@ -0,0 +1,130 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include "morelib/evloop.h"
+
+#include "FreeRTOS.h"
+
+/* Stackless coroutines that run on an event loop.
+ *
+ * A task needs its own stack, so a server with one task per connection runs out of RAM after a
+ * few dozen connections. A coroutine instead runs on the stack of the event loop's task and only
+ * needs a small struct coro to remember where it is suspended, so one task can serve thousands of
+ * connections.
+ *
+ * A coroutine is a function that is called again from the top each time it resumes. The
+ * CORO_BEGIN and CORO_END macros wrap its body in a switch statement, and each suspension point
+ * records its line number so that the next call jumps back to it. Because the stack is not saved,
+ * local variables do not keep their values across a suspension point. State that must live across
+ * suspension points goes in a struct that embeds struct coro as its first member. Also, a switch
+ * statement in the body must not contain suspension points, and there can be at most one
+ * suspension point per line.
+ *
+ *   struct echo {
+ *       struct coro co;
+ *       int fd;
+ *       int len;
+ *       char buf[64];
+ *   };
+ *
+ *   static int echo_func(struct coro *co) {
+ *       struct echo *echo = (void *)co;
+ *       CORO_BEGIN(co);
+ *       for (;;) {
+ *           CORO_READ(co, echo->len, echo->fd, echo->buf, sizeof(echo->buf));
+ *           if (echo->len <= 0) {
+ *               break;
+ *           }
+ *           CORO_WRITE(co, echo->len, echo->fd, echo->buf, echo->len);
+ *       }
+ *       CORO_END(co);
+ *   }
+ *
+ * The I/O macros have the semantics of read, write, and accept on a non-blocking file: if the
+ * call would block, the coroutine suspends until the file is ready and then retries. So files used
+ * by coroutines must be pollable and in non-blocking mode. Sockets returned by CORO_ACCEPT are
+ * already in non-blocking mode.
+ *
+ * All coroutine functions must be called from the loop's task, except coro_wake.
+ */
+
+enum coro_status {
+    CORO_WAIT,                          // the coroutine is suspended
+    CORO_DONE,                          // the coroutine has finished
+};
+
+enum coro_flags {
+    CORO_FLAG_TIMED_OUT = 0x1,
+};
+
+struct coro;
+
+typedef int (*coro_func_t)(struct coro *co);
+// Called when a coroutine finishes. May free the coroutine.
+typedef void (*coro_done_t)(struct coro *co);
+
+struct coro {
+    struct evloop_watch watch;          // file the coroutine is waiting on, if any
+    struct evloop_timer timer;          // sleep or timeout of the current wait
+    struct evloop_defer defer;          // resumes the coroutine on the next loop iteration
+    coro_func_t func;
+    coro_done_t done;
+    TickType_t timeout;                 // timeout of each file wait, or portMAX_DELAY
+    uint16_t line;                      // line number of the suspension point, or 0 if not started
+    uint16_t flags;
+};
+
+
+// Body macros
+#define CORO_BEGIN(co) switch ((co)->line) { case 0:
+
+#define CORO_END(co) } return CORO_DONE
+
+// Suspends at this line until the coroutine is resumed by some wake-up the caller arranged.
+#define CORO_SUSPEND(co) do { (co)->line = __LINE__; return CORO_WAIT; case __LINE__:; } while (0)
+
+// Lets other handlers of the loop run before continuing.
+#define CORO_YIELD(co) do { coro_wake(co); CORO_SUSPEND(co); } while (0)
+
+#define CORO_SLEEP(co, ticks) do { coro_sleep(co, ticks); CORO_SUSPEND(co); } while (0)
+
+// Suspends until cond is true. cond is evaluated each time the coroutine resumes, so whatever
+// makes cond true must also call coro_wake.
+#define CORO_WAIT_UNTIL(co, cond) do { (co)->line = __LINE__; case __LINE__: if (!(cond)) return CORO_WAIT; } while (0)
+
+// Assigns the result of expr to ret, suspending and evaluating expr again for as long as it fails
+// with EAGAIN. expr must arrange a wake-up before failing with EAGAIN, as the coro_ I/O functions do.
+#define CORO_AWAIT(co, ret, expr) \
+    do { (co)->line = __LINE__; case __LINE__: ret = (expr); if ((ret < 0) && (errno == EAGAIN)) return CORO_WAIT; } while (0)
+
+#define CORO_READ(co, ret, fd, buffer, size) CORO_AWAIT(co, ret, coro_read(co, fd, buffer, size))
+
+#define CORO_WRITE(co, ret, fd, buffer, size) CORO_AWAIT(co, ret, coro_write(co, fd, buffer, size))
+
+#define CORO_ACCEPT(co, ret, fd, address, address_len) CORO_AWAIT(co, ret, coro_accept(co, fd, address, address_len))
+
+
+// Coroutine functions
+void coro_init(struct evloop *loop, struct coro *co, coro_func_t func, coro_done_t done);
+// Runs the coroutine from the beginning on the next loop iteration.
+void coro_start(struct coro *co);
+// Cancels any pending wait. The coroutine is not resumed again unless it is restarted.
+void coro_stop(struct coro *co);
+// Resumes the coroutine on the next loop iteration. May be called from any task.
+void coro_wake(struct coro *co);
+void coro_wake_from_isr(struct coro *co, BaseType_t *pxHigherPriorityTaskWoken);
+// Sets the timeout of subsequent file waits. A wait that times out fails with ETIMEDOUT.
+void coro_set_timeout(struct coro *co, TickType_t xTicksToWait);
+// Arranges for the coroutine to be resumed after a delay.
+void coro_sleep(struct coro *co, TickType_t xTicksToWait);
+
+// I/O functions. On EAGAIN, these arrange for the coroutine to be resumed when the file is ready.
+int coro_wait_fd(struct coro *co, int fd, uint events);
+int coro_read(struct coro *co, int fd, void *buffer, size_t size);
+int coro_write(struct coro *co, int fd, const void *buffer, size_t size);
+int coro_accept(struct coro *co, int fd, struct sockaddr *address, socklen_t *address_len);
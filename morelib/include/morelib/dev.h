@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -37,6 +38,9 @@ int statdev(dev_t dev, struct stat *pstat);
 
 void dev_lock(void);
 
+// Locks the device table if it is not held by another task. Returns false if it is.
+bool dev_try_lock(void);
+
 void dev_unlock(void);
 
 // Standard device umbers
@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdbool.h>
+#include "freertos/timer_wheel.h"
+#include "morelib/poll.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* An event loop that dispatches callbacks for file readiness, timers, idle, and deferred calls.
+ *
+ * Unlike a poll() loop, handlers are registered once and stay registered as poll waiters on their
+ * files. Notifications put handlers on the loop's ready queue and wake the loop's task, so an
+ * iteration only does work proportional to the number of ready handlers.
+ *
+ * A loop is run by a single task. To use several cores, run one loop per task and set the core
+ * affinity of each task. Handler objects are owned by the caller and must stay valid until they
+ * are stopped. evloop_defer_post may be called from any task or interrupt; all other functions
+ * must be called from the loop's own task, or before the loop starts running.
+ */
+
+struct evloop;
+
+struct evloop_event {
+    struct evloop_event *next;
+    struct evloop_event *prev;
+    void (*dispatch)(struct evloop_event *event);
+};
+
+struct evloop {
+    struct evloop_event ready;          // protected by critical section
+    struct evloop_idle *idles;
+    struct evloop_idle *idle_cursor;
+    TaskHandle_t task;
+    bool stopped;
+};
+
+// File readiness handlers
+struct evloop_watch;
+
+typedef void (*evloop_watch_cb_t)(struct evloop_watch *watch, int fd, uint revents);
+
+struct evloop_watch {
+    struct poll_waiter base;
+    struct evloop_event event;
+    struct evloop *loop;
+    struct poll_file *file;
+    int fd;
+    evloop_watch_cb_t cb;
+    void *arg;
+};
+
+// Timer handlers
+struct evloop_timer;
+
+typedef void (*evloop_timer_cb_t)(struct evloop_timer *timer);
+
+struct evloop_timer {
+    struct timer_wheel_entry entry;
+    struct evloop_event event;
+    struct evloop *loop;
+    evloop_timer_cb_t cb;
+    void *arg;
+};
+
+// Idle handlers
+struct evloop_idle;
+
+typedef void (*evloop_idle_cb_t)(struct evloop_idle *idle);
+
+struct evloop_idle {
+    struct evloop_idle *next;
+    evloop_idle_cb_t cb;
+    void *arg;
+};
+
+// Deferred call handlers
+struct evloop_defer;
+
+typedef void (*evloop_defer_cb_t)(struct evloop_defer *defer);
+
+struct evloop_defer {
+    struct evloop_event event;
+    struct evloop *loop;
+    evloop_defer_cb_t cb;
+    void *arg;
+};
+
+
+// Loop functions
+void evloop_init(struct evloop *loop);
+void evloop_deinit(struct evloop *loop);
+int evloop_run(struct evloop *loop);
+int evloop_run_once(struct evloop *loop, TickType_t xTicksToWait);
+void evloop_stop(struct evloop *loop);
+
+// File readiness functions
+// Calls cb whenever the file is ready for any of events. Readiness is level-triggered.
+int evloop_watch_start(struct evloop *loop, struct evloop_watch *watch, int fd, uint events, evloop_watch_cb_t cb, void *arg);
+void evloop_watch_modify(struct evloop_watch *watch, uint events);
+void evloop_watch_stop(struct evloop_watch *watch);
+
+// Timer functions
+void evloop_timer_init(struct evloop *loop, struct evloop_timer *timer, evloop_timer_cb_t cb, void *arg);
+void evloop_timer_start(struct evloop_timer *timer, TickType_t delay, TickType_t period);
+void evloop_timer_stop(struct evloop_timer *timer);
+
+// Idle functions
+// Calls cb each time the loop has no ready handlers and is about to block.
+void evloop_idle_start(struct evloop *loop, struct evloop_idle *idle, evloop_idle_cb_t cb, void *arg);
+void evloop_idle_stop(struct evloop *loop, struct evloop_idle *idle);
+
+// Deferred call functions
+void evloop_defer_init(struct evloop *loop, struct evloop_defer *defer, evloop_defer_cb_t cb, void *arg);
+void evloop_defer_post_from_isr(struct evloop_defer *defer, BaseType_t *pxHigherPriorityTaskWoken);
+static inline void evloop_defer_post(struct evloop_defer *defer) {
+    evloop_defer_post_from_isr(defer, NULL);
+}
+void evloop_defer_cancel(struct evloop_defer *defer);
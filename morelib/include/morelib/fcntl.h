@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <fcntl.h>
+
+
+// Linux fcntls
+// ---
+#define F_LINUX_SPECIFIC_BASE 1024
+
+// Set the size of a pipe's buffer, rounded up to a power of two. Returns the new size.
+// param: int
+#define F_SETPIPE_SZ        (F_LINUX_SPECIFIC_BASE + 7)
+
+// Get the size of a pipe's buffer
+// param: none
+#define F_GETPIPE_SZ        (F_LINUX_SPECIFIC_BASE + 8)
+
+
+// Busy poll fcntls
+// ---
+// Pollable files can spin for a budget of microseconds waiting for readiness before a blocking
+// read, write, or poll puts the task to sleep. Spinning trades CPU time for wake-up latency.
+#define F_BUSYPOLL_BASE 0x8200
+
+// Set the busy poll budget in microseconds (0 = disabled)
+// param: int
+#define F_SETBUSYPOLL       (F_BUSYPOLL_BASE + 0)
+
+// Get the busy poll budget in microseconds
+// param: none
+#define F_GETBUSYPOLL       (F_BUSYPOLL_BASE + 1)
+
+// Get busy poll counters
+// param: struct busy_poll_stats *
+#define F_GETBUSYPOLLSTATS  (F_BUSYPOLL_BASE + 2)
+
+struct busy_poll_stats {
+    unsigned int hits;                  // spins that found the file ready
+    unsigned int misses;                // spins that ran out of budget
+};
@@ -7,6 +7,8 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+#define FLASH_HEAP_DEVICE_FLASH 0
+#define FLASH_HEAP_DEVICE_PSRAM 1
 #define FLASH_HEAP_NUM_DEVICES 2
 
 #define FIRMWARE_FLASH_HEAP_TYPE 0x10001
@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdatomic.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Futex-style wait queues keyed by address.
+ *
+ * Synchronization objects keep their state in an atomic word and only call into FreeRTOS when
+ * they need to block or wake a task. futex_wait blocks only if the word still holds the expected
+ * value, which is checked atomically with queueing the waiter, so a wake between reading the word
+ * and blocking is never lost. Waiters are woken in FIFO order. Wake-ups may be spurious, so
+ * callers must recheck their condition in a loop.
+ *
+ * Waiting uses its own task notification index, so it does not disturb poll or other users of the
+ * default notification.
+ */
+
+#define FUTEX_NOTIFY_INDEX 1
+
+static_assert(FUTEX_NOTIFY_INDEX < configTASK_NOTIFICATION_ARRAY_ENTRIES);
+
+#ifndef FUTEX_NUM_BUCKETS
+#define FUTEX_NUM_BUCKETS 16
+#endif
+
+
+// Blocks while *addr == expected. Returns 0 when woken, or -1 with errno set to EAGAIN if *addr
+// did not equal expected, or ETIMEDOUT if the timeout expired. Updates *pxTicksToWait with the
+// time remaining.
+int futex_wait(atomic_uint *addr, uint expected, TickType_t *pxTicksToWait);
+
+// Wakes up to count tasks waiting on addr. Returns the number of tasks woken.
+int futex_wake(atomic_uint *addr, int count);
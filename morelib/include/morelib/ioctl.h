@@ -12,3 +12,24 @@
 
 #define TMUX_ADD (TMUX_BASE + 0)
 #define TMUX_REMOVE (TMUX_BASE + 1)
+
+
+// MTD block device ioctls
+// ---
+#define MTDBLK_BASE 0x8200
+
+// Get the number of cache entries
+// param: int *
+#define MTDBLKGETCACHE (MTDBLK_BASE + 0)
+
+// Write back the cache and resize it to a number of entries
+// param: const int *
+#define MTDBLKSETCACHE (MTDBLK_BASE + 1)
+
+// Get cache statistics
+// param: struct mtdblk_stats *
+#define MTDBLKGETSTATS (MTDBLK_BASE + 2)
+
+// Erase the device and format it for the flash translation layer, if built with MTDBLK_FTL
+// param: none
+#define MTDBLKFTLFORMAT (MTDBLK_BASE + 3)
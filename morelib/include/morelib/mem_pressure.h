@@ -0,0 +1,21 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <fcntl.h>
+#include "freertos/mem_pressure.h"
+
+/* Memory pressure notification.
+ *
+ * mem_pressure_open returns a file that becomes readable when the free heap falls below a low
+ * watermark, so an event loop can shed load, such as refusing connections or dropping caches of
+ * its own, before allocations start to fail. Reading it returns the free heap in bytes as a
+ * uint64_t when the watermark was crossed, and clears the event until the free heap rises above
+ * the watermark and falls below it again.
+ */
+
+#define MPFD_CLOEXEC    O_CLOEXEC
+#define MPFD_NONBLOCK   O_NONBLOCK
+
+int mem_pressure_open(size_t low_watermark, int flags);
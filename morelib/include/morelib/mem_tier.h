@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tiered memory allocation.
+ *
+ * Memory comes from tiers with different speed and size. The SRAM tier is the malloc heap, which
+ * is fast and DMA-capable but small. The PSRAM tier is an arena in external PSRAM, which is large
+ * but slower. An allocation takes a hint of what the memory is for, and the allocator picks the
+ * tier:
+ *   MEM_FAST   SRAM only, for latency-critical objects
+ *   MEM_DMA    SRAM only, for buffers that DMA reads or writes at full speed
+ *   MEM_BULK   PSRAM, or SRAM if PSRAM is absent or full, for large buffers such as TLS records,
+ *              file caches and image frames
+ *   MEM_AUTO   MEM_BULK for requests of at least MEM_TIER_BULK_THRESHOLD bytes, else MEM_FAST
+ *
+ * The PSRAM arena is the top PSRAM_HEAP_SIZE bytes of /dev/psram, which the flash heap leaves
+ * alone. It defaults to half of the PSRAM, and is claimed on first use. Other regions, such as
+ * static arrays that simulate PSRAM on a host build, can be added with mem_tier_add_region.
+ *
+ * Memory from these functions must be freed with mem_tier_free.
+ */
+
+// Size from which MEM_AUTO allocations go to the PSRAM tier
+#ifndef MEM_TIER_BULK_THRESHOLD
+#define MEM_TIER_BULK_THRESHOLD 4096
+#endif
+
+enum mem_hint {
+    MEM_AUTO,
+    MEM_FAST,
+    MEM_DMA,
+    MEM_BULK,
+};
+
+enum mem_tier {
+    MEM_TIER_SRAM,
+    MEM_TIER_PSRAM,
+    MEM_NUM_TIERS,
+};
+
+struct mem_tier_stats {
+    size_t size;                        // bytes in the tier's regions, or the free SRAM heap
+    size_t used;                        // bytes allocated from the tier through this API
+    size_t peak_used;
+    size_t largest_free;                // largest block that can be allocated
+    uint32_t num_allocs;
+    uint32_t num_fallbacks;             // allocations hinted to this tier that another tier served
+};
+
+void *mem_tier_malloc(size_t size, enum mem_hint hint);
+void *mem_tier_calloc(size_t num, size_t size, enum mem_hint hint);
+
+// Resizes an allocation, keeping it in the same tier.
+void *mem_tier_realloc(void *ptr, size_t size);
+
+void mem_tier_free(void *ptr);
+
+// Returns the tier that an allocation is in.
+enum mem_tier mem_tier_of(const void *ptr);
+
+// Adds a region of memory to a tier other than SRAM. Returns -1 with errno EINVAL if the tier is
+// SRAM, or ENOMEM if there are too many regions.
+int mem_tier_add_region(enum mem_tier tier, void *base, size_t size);
+
+// Gets the statistics of a tier. Returns -1 with errno EINVAL if tier is out of range.
+int mem_tier_get_stats(enum mem_tier tier, struct mem_tier_stats *stats);
+
+// Returns the size of PSRAM to reserve for the PSRAM tier, given the mapping and size of the PSRAM
+// device. The size never reaches below the end of the flash heap in PSRAM.
+size_t mem_tier_psram_size(const void *base, size_t device_size);
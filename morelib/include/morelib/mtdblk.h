@@ -9,19 +9,108 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 
+/* Block device on top of an MTD device.
+ *
+ * Writes go through a cache of erase blocks. The cache is set-associative: a block can be cached
+ * in any of the MTDBLK_CACHE_WAYS entries of its set, and the least recently used entry of the
+ * set is replaced. Each entry has a bitmap of dirty sectors, so evicting a clean entry does no
+ * I/O. When a dirty entry is written back, and the MTD can flip single bits and every dirty
+ * sector only clears bits, the dirty sectors are programmed without erasing the block.
+ * Otherwise the block is erased and programmed whole. Reads that miss the cache go to the MTD.
+ *
+ * The number of cache entries of a device is MTDBLK_NUM_CACHE_ENTRIES when it is opened, and can
+ * be changed with the MTDBLKSETCACHE ioctl. MTDBLKGETSTATS reports hits, misses and I/O.
+ *
+ * When built with MTDBLK_FTL, a device that was formatted with the MTDBLKFTLFORMAT ioctl is
+ * accessed through a log-structured flash translation layer instead of being mapped 1:1. Sectors
+ * are written out of place to the next free slot of the erase block being filled, and the slot's
+ * tag in the block header records which sector it holds. A tag is programmed after its data, so a
+ * write that is cut short by power loss leaves the previous version of the sector in place, and
+ * the mapping is rebuilt from the tags when the device is opened. When free blocks run out, the
+ * block with the fewest live sectors is garbage collected. New blocks are taken in order of erase
+ * count, and when erase counts drift more than MTDBLK_FTL_WEAR_THRESHOLD apart, the cold data of
+ * the least worn block is moved so that the block is used again. The cache then caches sectors
+ * rather than erase blocks. MTDBLK_FTL_SPARE_BLOCKS blocks are kept back from the capacity of the
+ * device for garbage collection, and the mapping takes 4 bytes of RAM per sector.
+ */
+
+// Default number of cache entries per device
 #ifndef MTDBLK_NUM_CACHE_ENTRIES
 #define MTDBLK_NUM_CACHE_ENTRIES 16
 #endif
 
+// Number of entries in a set
+#ifndef MTDBLK_CACHE_WAYS
+#define MTDBLK_CACHE_WAYS 4
+#endif
+
 #ifndef MTDBLK_NUM_DEVICES
 #define MTDBLK_NUM_DEVICES 4
 #endif
 
+#ifndef MTDBLK_FTL
+#define MTDBLK_FTL 0
+#endif
+
+// Sector size of the flash translation layer. Raised to the MTD write size if that is larger.
+#ifndef MTDBLK_FTL_SECTOR_SIZE
+#define MTDBLK_FTL_SECTOR_SIZE 512
+#endif
+
+// Erase blocks not counted in the capacity of a device, so garbage collection has room. At least 3.
+#ifndef MTDBLK_FTL_SPARE_BLOCKS
+#define MTDBLK_FTL_SPARE_BLOCKS 4
+#endif
+
+// Difference between the highest and lowest erase count at which cold data is moved
+#ifndef MTDBLK_FTL_WEAR_THRESHOLD
+#define MTDBLK_FTL_WEAR_THRESHOLD 32
+#endif
+
 
 struct mtdblk_cache_entry {
-    size_t num;
-    void *page;
-    uint tick;
+    size_t num;                         // erase block number
+    void *page;                         // contents of the block, or NULL if the entry is empty
+    uint tick;                          // time of last use
+    uint32_t dirty;                     // bitmap of dirty sectors
+};
+
+struct mtdblk_stats {
+    uint32_t hits;                      // accesses to cached blocks
+    uint32_t misses;                    // blocks read into the cache
+    uint32_t clean_evictions;           // evictions that needed no I/O
+    uint32_t writebacks;                // dirty blocks written back
+    uint32_t erases;                    // blocks erased
+    uint32_t programs;                  // sectors programmed
+    uint32_t gc_moves;                  // sectors moved by garbage collection and wear leveling
+    uint32_t min_erase_count;           // lowest and highest erase count of any block, with FTL
+    uint32_t max_erase_count;
+};
+
+struct mtdblk_ftl_block {
+    uint32_t seq;                       // order in which the block was filled
+    uint32_t erase_count;
+    uint16_t num_valid;                 // slots that hold the current version of a sector
+    uint8_t state;
+};
+
+struct mtdblk_ftl {
+    size_t erase_size;
+    size_t write_size;
+    size_t sector_size;
+    size_t header_size;                 // bytes at the start of a block for the header and tags
+    uint num_blocks;
+    uint num_slots;                     // sector slots per block
+    uint num_sectors;                   // capacity of the device
+    uint32_t *map;                      // slot of each sector, numbered across blocks
+    struct mtdblk_ftl_block *blocks;
+    uint head;                          // block being filled, or num_blocks if none
+    uint head_slot;                     // next free slot of the head
+    uint num_free;                      // free blocks, including the ones that need erasing
+    uint32_t next_seq;
+    bool collecting;
+    bool static_turn;                   // whether the next collection may level wear
+    uint8_t *buffer;                    // a sector and a write page, for moving sectors and headers
 };
 
 struct mtdblk_file {
@@ -30,12 +119,20 @@ struct mtdblk_file {
     struct vfs_file *file;
     size_t size;
     size_t block_size;
+    size_t sector_size;                 // bytes per dirty bit
+    uint32_t flags;                     // mtd_info flags of the MTD
     SemaphoreHandle_t mutex;
     size_t pos;
     int ro;
 
-    struct mtdblk_cache_entry cache[MTDBLK_NUM_CACHE_ENTRIES];
+    struct mtdblk_cache_entry *cache;
+    size_t num_entries;
+    size_t num_ways;
     uint next_tick;
+    struct mtdblk_stats stats;
+    #if MTDBLK_FTL
+    struct mtdblk_ftl *ftl;             // NULL if the device is mapped 1:1
+    #endif
 
     struct timespec mtime;
     StaticSemaphore_t xMutexBuffer;
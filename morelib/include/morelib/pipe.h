@@ -5,5 +5,25 @@
 
 #include "morelib/poll.h"
 
+// Initial size of a pipe's buffer
+#ifndef PIPE_DEFAULT_LOG2_SIZE
+#define PIPE_DEFAULT_LOG2_SIZE 9
+#endif
 
-int pipe_pair(struct poll_file *pipes[2]);
\ No newline at end of file
+// Number of pipes preallocated in a pool. More pipes are allocated from the heap.
+#ifndef PIPE_POOL_SIZE
+#define PIPE_POOL_SIZE 2
+#endif
+
+// Largest size that F_SETPIPE_SZ accepts
+#ifndef PIPE_MAX_SIZE
+#define PIPE_MAX_SIZE 16384
+#endif
+
+
+int pipe_pair(struct poll_file *pipes[2], int flags);
+
+int pipe_get_size(struct vfs_file *file);
+
+// Resizes the pipe's buffer to size rounded up to a power of two. Returns the new size.
+int pipe_set_size(struct vfs_file *file, int size);
\ No newline at end of file
@@ -12,6 +12,11 @@
 #define POLLFILE (POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM)
 #define POLLCOM (POLLERR | POLLHUP | POLLNVAL)
 
+// Number of files that poll can wait on without allocating memory
+#ifndef POLL_STACK_NFDS
+#define POLL_STACK_NFDS 4
+#endif
+
 
 typedef void (*poll_notification_t)(const void *ptr, BaseType_t *pxHigherPriorityTaskWoken);
 
@@ -25,6 +30,9 @@ struct poll_file {
     struct vfs_file base;
     struct poll_waiter *waiters;
     int events;
+    uint busy_poll;                     // microseconds to spin before blocking, 0 = never spin
+    uint busy_poll_hits;                // approximate count of spins that found the file ready
+    uint busy_poll_misses;              // approximate count of spins that ran out of budget
 };
 
 // generic wait for task notification
@@ -34,6 +42,7 @@ int poll_wait(TickType_t *pxTicksToWait);
 void poll_waiter_init(struct poll_waiter *desc, uint events, poll_notification_t notify);
 void poll_waiter_add(struct poll_file *file, struct poll_waiter *desc);
 void poll_waiter_remove(struct poll_file *file, struct poll_waiter *desc);
+void poll_waiter_modify(struct poll_file *file, struct poll_waiter *desc);
 
 // file functions
 void poll_file_init(struct poll_file *file, const struct vfs_file_vtable *func, int flags, uint events);
@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/* Fixed-size object pools.
+ *
+ * A pool has storage for a fixed number of objects of one type, reserved at build time, so
+ * objects that are created and destroyed at a high rate, such as sockets and pipes, do not go
+ * through malloc. Allocating and freeing is a compare-and-swap on the head of a free list, which
+ * is tagged with a generation count so that a concurrent pop and push of the same object is
+ * detected. When a pool is empty, objects are allocated from malloc instead, and pool_free sends
+ * them back to free.
+ *
+ * Pools are defined with POOL_DEFINE. A pool needs no initialization: when its free list is empty,
+ * objects that have never been allocated are taken from the storage in order, and a pool registers
+ * itself for pool_free and pool_report on its first allocation. Nothing refers to a pool that is never
+ * allocated from, so the linker can discard it. A pool holds at most 65535 objects.
+ */
+
+struct pool {
+    const char *name;
+    char *objects;                      // storage for capacity objects
+    size_t size;                        // object size, rounded up to a multiple of 8
+    uint capacity;
+    atomic_uint head;                   // generation << 16 | index + 1 of the first free object, or 0 if none
+    atomic_uint num_carved;             // objects ever taken from the storage, which start the free list
+    atomic_uint state;                  // POOL_UNREGISTERED, POOL_REGISTERING or POOL_REGISTERED
+    atomic_uint num_used;               // objects in use from the pool
+    atomic_uint peak_used;
+    atomic_uint num_fallbacks;          // allocations that fell back to malloc
+    struct pool *next;                  // list of registered pools
+};
+
+struct pool_stats {
+    uint capacity;
+    uint num_used;
+    uint peak_used;
+    uint num_fallbacks;
+};
+
+enum {
+    POOL_UNREGISTERED,
+    POOL_REGISTERING,
+    POOL_REGISTERED,
+};
+
+#define POOL_OBJECT_SIZE(type) ((sizeof(type) + 7) & ~7)
+
+// Defines a pool named var of count objects of type. Count may be 0, in which case every
+// allocation comes from malloc.
+#define POOL_DEFINE(var, type, count) \
+    static char var##_objects[(count) * POOL_OBJECT_SIZE(type)] __attribute__((aligned(8))); \
+    static struct pool var = { #var, var##_objects, POOL_OBJECT_SIZE(type), count };
+
+// Allocates an object from a pool, or from malloc if the pool is empty. The object is not zeroed.
+void *pool_alloc(struct pool *pool);
+
+// Allocates a zeroed object from a pool, or from malloc if the pool is empty.
+void *pool_calloc(struct pool *pool);
+
+// Frees an object allocated from any pool, or from malloc.
+void pool_free(void *ptr);
+
+void pool_get_stats(struct pool *pool, struct pool_stats *stats);
+
+// Writes the occupancy of all pools to a stream.
+void pool_report(FILE *stream);
@@ -13,6 +13,12 @@ typedef struct ring {
     size_t write_index;
 } ring_t;
 
+// A contiguous region of a ring's buffer
+struct ring_segment {
+    char *ptr;
+    size_t size;
+};
+
 
 void *ring_alloc(ring_t *ring, uint log2_size);
 
@@ -42,3 +48,75 @@ static inline void ring_clear(ring_t *ring) {
     ring->write_index = 0;
     ring->read_index = 0;
 }
+
+// Splits count bytes from index into the part before the end of the buffer and the part that wraps
+// around to the start. Returns count.
+static inline size_t ring_segments(const ring_t *ring, size_t index, size_t count, struct ring_segment segs[2]) {
+    segs[0].ptr = ring_at(ring, index, &segs[0].size);
+    segs[0].size = count < segs[0].size ? count : segs[0].size;
+    segs[1].ptr = ring->buffer;
+    segs[1].size = count - segs[0].size;
+    return count;
+}
+
+
+// Zero-copy functions
+// ---
+// Instead of copying through a caller buffer, a producer can reserve the free space, fill it in
+// place, then commit the bytes it filled. Likewise a consumer can peek at the readable data, parse
+// it in place, then consume the bytes it used. The second segment is empty unless the region wraps.
+static inline size_t ring_reserve(const ring_t *ring, struct ring_segment segs[2]) {
+    return ring_segments(ring, ring->write_index, ring_write_count(ring), segs);
+}
+
+static inline void ring_commit(ring_t *ring, size_t count) {
+    ring->write_index += count;
+}
+
+static inline size_t ring_peek(const ring_t *ring, struct ring_segment segs[2]) {
+    return ring_segments(ring, ring->read_index, ring_read_count(ring), segs);
+}
+
+static inline void ring_consume(ring_t *ring, size_t count) {
+    ring->read_index += count;
+}
+
+
+// Lock-free single-producer/single-consumer functions
+// ---
+// One producer may call the write functions while one consumer calls the read functions, each
+// from a task or interrupt on either core, without a lock or critical section. The producer only
+// stores write_index and the consumer only stores read_index. Callers must still serialize
+// multiple producers or multiple consumers among themselves.
+static inline size_t ring_spsc_write_count(const ring_t *ring) {
+    return __atomic_load_n(&ring->read_index, __ATOMIC_ACQUIRE) + ring->size - ring->write_index;
+}
+
+static inline size_t ring_spsc_read_count(const ring_t *ring) {
+    return __atomic_load_n(&ring->write_index, __ATOMIC_ACQUIRE) - ring->read_index;
+}
+
+size_t ring_spsc_write(ring_t *ring, const void *buffer, size_t buffer_size);
+
+size_t ring_spsc_read(ring_t *ring, void *buffer, size_t buffer_size);
+
+static inline size_t ring_spsc_reserve(const ring_t *ring, struct ring_segment segs[2]) {
+    return ring_segments(ring, ring->write_index, ring_spsc_write_count(ring), segs);
+}
+
+static inline void ring_spsc_commit(ring_t *ring, size_t count) {
+    __atomic_store_n(&ring->write_index, ring->write_index + count, __ATOMIC_RELEASE);
+}
+
+static inline size_t ring_spsc_peek(const ring_t *ring, struct ring_segment segs[2]) {
+    return ring_segments(ring, ring->read_index, ring_spsc_read_count(ring), segs);
+}
+
+static inline void ring_spsc_consume(ring_t *ring, size_t count) {
+    __atomic_store_n(&ring->read_index, ring->read_index + count, __ATOMIC_RELEASE);
+}
+
+// Discards all readable data. Must be called by the consumer.
+static inline void ring_spsc_clear(ring_t *ring) {
+    __atomic_store_n(&ring->read_index, __atomic_load_n(&ring->write_index, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stddef.h>
+
+
+// Allocates and frees the memory backing shared memory objects. The default uses mem_tier_malloc
+// with MEM_AUTO, so large objects go to PSRAM when it is present. A port can override these weak
+// functions to place objects in another memory.
+void *shm_storage_alloc(size_t size);
+void shm_storage_free(void *ptr);
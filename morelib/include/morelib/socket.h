@@ -12,6 +12,7 @@
 #include "semphr.h"
 
 
+struct pool;
 struct socket_vtable;
 
 struct socket {
@@ -36,7 +37,9 @@ struct socket_vtable {
     int (*getsockopt)(void *ctx, int level, int option_name, void *option_value, socklen_t *option_len);
     int (*listen)(void *ctx, int backlog);
     int (*recvfrom)(void *ctx, void *buf, size_t len, struct sockaddr *address, socklen_t *address_len);
+    int (*recvmsg)(void *ctx, struct msghdr *message, int flags);
     int (*setsockopt)(void *ctx, int level, int option_name, const void *option_value, socklen_t option_len);
+    int (*sendmsg)(void *ctx, const struct msghdr *message, int flags);
     int (*sendto)(void *ctx, const void *buf, size_t len, const struct sockaddr *address, socklen_t address_len);
     int (*shutdown)(void *ctx, int how);
 };
@@ -45,6 +48,9 @@ struct socket_vtable {
 struct socket *socket_acquire(int fd);
 void *socket_alloc(size_t size, const struct socket_vtable *vtable, int domain, int type, int protocol);
 
+// Allocates a socket from a pool of objects of the socket's type.
+void *socket_alloc_pooled(struct pool *pool, const struct socket_vtable *vtable, int domain, int type, int protocol);
+
 static inline void socket_lock(struct socket *socket) {
     xSemaphoreTake(socket->mutex, portMAX_DELAY);
 }
@@ -139,6 +145,8 @@ static inline int socket_recv(struct socket *socket, void *buf, size_t len, int
     return socket_recvfrom(socket, buf, len, flags, NULL, NULL);
 }
 
+int socket_recvmsg(struct socket *socket, struct msghdr *message, int flags);
+
 static inline int socket_sendto(struct socket *socket, const void *buf, size_t len, int flags, const struct sockaddr *address, socklen_t address_len) {
     if (!socket->func->sendto) {
         errno = EOPNOTSUPP;
@@ -151,6 +159,8 @@ static inline int socket_send(struct socket *socket, const void *buf, size_t len
     return socket_sendto(socket, buf, len, flags, NULL, 0);
 }
 
+int socket_sendmsg(struct socket *socket, const struct msghdr *message, int flags);
+
 int socket_setintopt(const void *option_value, socklen_t option_len, int *value);
 int socket_setsockopt(struct socket *socket, int level, int option_name, const void *option_value, socklen_t option_len);
 
@@ -168,6 +178,7 @@ struct socket_family {
     struct socket *(*socket)(int domain, int type, int protocol);
     int (*getaddrinfo)(const char *nodename, const char *servname, const struct addrinfo *hints, struct addrinfo **res);
     int (*getnameinfo)(const struct sockaddr *sa, socklen_t salen, char *node, socklen_t nodelen, char *service, socklen_t servicelen, int flags);
+    int (*socketpair)(int domain, int type, int protocol, int socket_vector[2]);
 };
 
 extern const struct socket_family *socket_families[];
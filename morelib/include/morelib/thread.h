@@ -4,6 +4,7 @@
 #pragma once
 
 #include <stdatomic.h>
+#include <stdio.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -11,24 +12,72 @@
 
 #define TLS_INDEX_SYS 0
 #define TLS_INDEX_APP 1
+#define TLS_INDEX_PTHREAD 2
+
+
+static_assert(TLS_INDEX_PTHREAD < configNUM_THREAD_LOCAL_STORAGE_POINTERS);
+
+// Number of hash buckets for looking up threads by ID
+#ifndef THREAD_NUM_BUCKETS
+#define THREAD_NUM_BUCKETS 16
+#endif
+
+/* Stack profiling
+ *
+ * FreeRTOS fills new stacks with a known value, so the most stack a thread has used so far can be
+ * found by scanning for the first overwritten word. thread_stack_usage returns this for one
+ * thread and thread_stack_report prints it for all threads.
+ *
+ * Threads created by thread_create are sized from the STACK_SIZES environment variable if it
+ * lists the thread's name. It holds space-separated entries of the form name:words, where words is
+ * the peak usage of threads with that name, and the thread gets at least that many words plus
+ * THREAD_STACK_MARGIN. A learned size only ever grows the requested size, so a stack is never
+ * made smaller than its creator asked for. When THREAD_STACK_LEARN is 1, the peak usage of each
+ * thread is recorded by name when it exits, and thread_stack_save merges these with the peaks of
+ * live threads and the existing variable and writes the result to STACK_SIZES. Since environment
+ * variables are stored in flash, save once after exercising the application, and the next boot
+ * gives threads that overflowed their requested size enough stack.
+ *
+ * Threads named THREAD_NAME_PTHREAD or THREAD_NAME_POOL run unrelated code under one name, so
+ * their stacks are neither learned nor sized from STACK_SIZES.
+ */
+#ifndef THREAD_STACK_LEARN
+#define THREAD_STACK_LEARN 0
+#endif
+
+// Words added to a learned peak usage to get the stack size
+#ifndef THREAD_STACK_MARGIN
+#define THREAD_STACK_MARGIN 64
+#endif
 
+// Names of pthreads and thread pool workers
+#define THREAD_NAME_PTHREAD "pthread"
+#define THREAD_NAME_POOL "pool"
 
-static_assert(TLS_INDEX_APP < configNUM_THREAD_LOCAL_STORAGE_POINTERS);
+// Number of thread names whose peak usage is recorded in learning mode
+#ifndef THREAD_STACK_MAX_ENTRIES
+#define THREAD_STACK_MAX_ENTRIES 16
+#endif
 
 enum thread_interrupt_state {
     TASK_INTERRUPT_SET = 0x1,
     TASK_INTERRUPT_CAN_ABORT = 0x2,
+    TASK_INTERRUPT_ABORTING = 0x4,
 };
 
 typedef struct thread {
     struct thread *next;
+    struct thread **pprev;
+    struct thread *bucket_next;
     int ref_count;
     TaskHandle_t handle;
     UBaseType_t id;
-    enum thread_interrupt_state state;
+    atomic_uint state;                  // enum thread_interrupt_state flags
+    configSTACK_DEPTH_TYPE stack_depth;
 
     TaskFunction_t entry;
     void *param;
+    void *result;
     SemaphoreHandle_t joiner;
 } thread_t;
 
@@ -77,6 +126,17 @@ TaskHandle_t thread_suspend(thread_t *thread);
 void thread_resume(TaskHandle_t handle);
 
 
+// Stack profiling
+// Gets the stack size of a thread and the most stack it has used so far, both in words.
+int thread_stack_usage(thread_t *thread, configSTACK_DEPTH_TYPE *size, configSTACK_DEPTH_TYPE *peak);
+
+void thread_stack_report(FILE *stream);
+
+#if THREAD_STACK_LEARN
+int thread_stack_save(void);
+#endif
+
+
 // Task utilities
 static inline StackType_t *task_pxTopOfStack(TaskHandle_t handle) {
     // assert(eTaskGetState(handle) == eSuspended);
@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "morelib/poll.h"
+#include "morelib/thread.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* A pool of worker threads for running compute-heavy jobs on all cores.
+ *
+ * Each worker is pinned to a core and has its own deque of jobs. A worker runs jobs from the back
+ * of its own deque, and when that is empty it steals the oldest job from the front of another
+ * worker's deque. So jobs spread across cores without any central queue. Jobs submitted by a
+ * worker go on that worker's deque; jobs submitted by any other task go on the deque of a worker
+ * on the submitter's core.
+ *
+ * Jobs are owned by the caller and must stay valid until they complete or are cancelled. A task
+ * can block on a job with threadpool_job_wait, or get a completion fd with threadpool_job_fd that
+ * becomes readable when the job completes, for use with poll or an event loop. A job may submit
+ * and wait for other jobs: a worker waiting for a job runs queued jobs in the meantime, so jobs
+ * waiting on jobs do not tie up all the workers.
+ */
+
+enum threadpool_job_state {
+    THREADPOOL_JOB_IDLE,
+    THREADPOOL_JOB_QUEUED,
+    THREADPOOL_JOB_RUNNING,
+    THREADPOOL_JOB_DONE,
+};
+
+struct threadpool_worker;
+
+struct threadpool_job {
+    struct threadpool_job *next;
+    struct threadpool_job *prev;
+    struct threadpool *pool;            // pool the job was last submitted to
+    struct threadpool_worker *worker;   // deque the job is queued on, protected by critical section
+    void *(*func)(void *arg);
+    void *arg;
+    void *result;
+    atomic_uint state;
+    struct poll_file *file;             // completion file, if any
+};
+
+struct threadpool_worker {
+    struct threadpool *pool;
+    thread_t *thread;
+    struct threadpool_job *head;        // deque protected by critical section
+    struct threadpool_job *tail;
+};
+
+struct threadpool {
+    struct threadpool_worker *workers;
+    uint num_workers;
+    uint workers_per_core;
+    atomic_uint seq;                    // incremented on every submit, idle workers wait on it
+    atomic_uint num_idle;
+    atomic_uint next;                   // round-robin counter for choosing a worker on a core
+    bool stopped;
+};
+
+
+// Pool functions
+// Creates workers_per_core workers on each core.
+int threadpool_init(struct threadpool *pool, uint workers_per_core, configSTACK_DEPTH_TYPE usStackDepth, UBaseType_t uxPriority);
+// Waits for all queued jobs to finish, then stops the workers.
+void threadpool_deinit(struct threadpool *pool);
+
+// Job functions
+void threadpool_job_init(struct threadpool_job *job, void *(*func)(void *arg), void *arg);
+void threadpool_job_deinit(struct threadpool_job *job);
+// Returns a new fd that becomes readable when the job completes. Must be called while the job is not queued.
+int threadpool_job_fd(struct threadpool_job *job);
+int threadpool_submit(struct threadpool *pool, struct threadpool_job *job);
+// Removes a job that has not started running. Returns -1 with errno EBUSY if it already started.
+int threadpool_cancel(struct threadpool_job *job);
+// Waits for a job to complete and returns its result in *result.
+int threadpool_job_wait(struct threadpool_job *job, void **result, TickType_t xTicksToWait);
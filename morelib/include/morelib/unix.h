@@ -0,0 +1,24 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "morelib/socket.h"
+
+// Receive buffer size of a connected stream socket
+#ifndef UNIX_STREAM_LOG2_SIZE
+#define UNIX_STREAM_LOG2_SIZE 11
+#endif
+
+// Maximum bytes of datagrams queued on a datagram socket
+#ifndef UNIX_DGRAM_QUEUE_SIZE
+#define UNIX_DGRAM_QUEUE_SIZE 2048
+#endif
+
+// Maximum file descriptors passed in one SCM_RIGHTS message
+#ifndef UNIX_RIGHTS_MAX
+#define UNIX_RIGHTS_MAX 16
+#endif
+
+
+extern const struct socket_family unix_af;
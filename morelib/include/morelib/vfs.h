@@ -60,6 +60,7 @@ struct vfs_file_vtable {
     int (*ftruncate)(void *ctx, off_t length);
 
     void *(*mmap)(void *ctx, void *addr, size_t len, int prot, int flags, off_t off);
+    int (*munmap)(void *ctx, void *addr, size_t len);   // if set, the file is held open until munmap
     int (*ioctl)(void *ctx, unsigned long request, va_list args);
 };
 
@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <time.h>
+
+// Attributes of a queue created without an attribute argument
+#ifndef MQ_DEFAULT_MAXMSG
+#define MQ_DEFAULT_MAXMSG 8
+#endif
+
+#ifndef MQ_DEFAULT_MSGSIZE
+#define MQ_DEFAULT_MSGSIZE 128
+#endif
+
+#ifndef MQ_PRIO_MAX
+#define MQ_PRIO_MAX 32
+#endif
+
+typedef int mqd_t;
+
+struct mq_attr {
+    long mq_flags;
+    long mq_maxmsg;
+    long mq_msgsize;
+    long mq_curmsgs;
+};
+
+
+int mq_close(mqd_t mqdes);
+int mq_getattr(mqd_t mqdes, struct mq_attr *mqstat);
+int mq_notify(mqd_t mqdes, const struct sigevent *notification);
+mqd_t mq_open(const char *name, int oflag, ...);
+ssize_t mq_receive(mqd_t mqdes, char *msg_ptr, size_t msg_len, unsigned *msg_prio);
+int mq_send(mqd_t mqdes, const char *msg_ptr, size_t msg_len, unsigned msg_prio);
+int mq_setattr(mqd_t mqdes, const struct mq_attr *mqstat, struct mq_attr *omqstat);
+ssize_t mq_timedreceive(mqd_t mqdes, char *msg_ptr, size_t msg_len, unsigned *msg_prio, const struct timespec *abstime);
+int mq_timedsend(mqd_t mqdes, const char *msg_ptr, size_t msg_len, unsigned msg_prio, const struct timespec *abstime);
+int mq_unlink(const char *name);
@@ -0,0 +1,166 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <time.h>
+
+// Stack size of threads created without a stack size attribute
+#ifndef PTHREAD_STACK_DEFAULT
+#define PTHREAD_STACK_DEFAULT 4096
+#endif
+
+#ifndef PTHREAD_STACK_MIN
+#define PTHREAD_STACK_MIN 2048
+#endif
+
+#ifndef PTHREAD_KEYS_MAX
+#define PTHREAD_KEYS_MAX 8
+#endif
+
+#ifndef PTHREAD_DESTRUCTOR_ITERATIONS
+#define PTHREAD_DESTRUCTOR_ITERATIONS 4
+#endif
+
+#define PTHREAD_CREATE_JOINABLE 0
+#define PTHREAD_CREATE_DETACHED 1
+
+#define PTHREAD_MUTEX_NORMAL 0
+#define PTHREAD_MUTEX_ERRORCHECK 1
+#define PTHREAD_MUTEX_RECURSIVE 2
+#define PTHREAD_MUTEX_DEFAULT PTHREAD_MUTEX_NORMAL
+
+#define PTHREAD_PROCESS_PRIVATE 0
+
+#define PTHREAD_BARRIER_SERIAL_THREAD -1
+
+typedef struct thread *pthread_t;
+
+typedef struct {
+    size_t stacksize;
+    int detachstate;
+} pthread_attr_t;
+
+typedef struct {
+    atomic_uint state;                  // 0 = unlocked, 1 = locked, 2 = locked with waiters
+    int type;
+    void *owner;                        // task handle of owner, for error checking and recursive mutexes
+    unsigned count;                     // recursion count
+} pthread_mutex_t;
+
+typedef struct {
+    int type;
+} pthread_mutexattr_t;
+
+#define PTHREAD_MUTEX_INITIALIZER { 0 }
+
+typedef struct {
+    atomic_uint seq;
+    clockid_t clock;
+} pthread_cond_t;
+
+typedef struct {
+    clockid_t clock;
+} pthread_condattr_t;
+
+#define PTHREAD_COND_INITIALIZER { 0, CLOCK_REALTIME }
+
+typedef struct {
+    atomic_uint state;                  // reader count, or write locked, and waiters flags
+} pthread_rwlock_t;
+
+typedef struct {
+    int pshared;
+} pthread_rwlockattr_t;
+
+#define PTHREAD_RWLOCK_INITIALIZER { 0 }
+
+typedef struct {
+    atomic_uint seq;
+    atomic_uint arrived;
+    unsigned count;
+} pthread_barrier_t;
+
+typedef struct {
+    int pshared;
+} pthread_barrierattr_t;
+
+typedef struct {
+    atomic_uint state;
+} pthread_once_t;
+
+#define PTHREAD_ONCE_INIT { 0 }
+
+typedef unsigned pthread_key_t;
+
+
+// Thread attributes
+int pthread_attr_destroy(pthread_attr_t *attr);
+int pthread_attr_getdetachstate(const pthread_attr_t *attr, int *detachstate);
+int pthread_attr_getstacksize(const pthread_attr_t *attr, size_t *stacksize);
+int pthread_attr_init(pthread_attr_t *attr);
+int pthread_attr_setdetachstate(pthread_attr_t *attr, int detachstate);
+int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize);
+
+// Threads
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg);
+int pthread_detach(pthread_t thread);
+int pthread_equal(pthread_t t1, pthread_t t2);
+void pthread_exit(void *value_ptr) __attribute__((noreturn));
+int pthread_join(pthread_t thread, void **value_ptr);
+pthread_t pthread_self(void);
+
+// Mutexes
+int pthread_mutex_destroy(pthread_mutex_t *mutex);
+int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr);
+int pthread_mutex_lock(pthread_mutex_t *mutex);
+int pthread_mutex_timedlock(pthread_mutex_t *mutex, const struct timespec *abstime);
+int pthread_mutex_trylock(pthread_mutex_t *mutex);
+int pthread_mutex_unlock(pthread_mutex_t *mutex);
+int pthread_mutexattr_destroy(pthread_mutexattr_t *attr);
+int pthread_mutexattr_gettype(const pthread_mutexattr_t *attr, int *type);
+int pthread_mutexattr_init(pthread_mutexattr_t *attr);
+int pthread_mutexattr_settype(pthread_mutexattr_t *attr, int type);
+
+// Condition variables
+int pthread_cond_broadcast(pthread_cond_t *cond);
+int pthread_cond_destroy(pthread_cond_t *cond);
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr);
+int pthread_cond_signal(pthread_cond_t *cond);
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime);
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+int pthread_condattr_destroy(pthread_condattr_t *attr);
+int pthread_condattr_getclock(const pthread_condattr_t *attr, clockid_t *clock_id);
+int pthread_condattr_init(pthread_condattr_t *attr);
+int pthread_condattr_setclock(pthread_condattr_t *attr, clockid_t clock_id);
+
+// Read-write locks
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock);
+int pthread_rwlock_init(pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr);
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_timedrdlock(pthread_rwlock_t *rwlock, const struct timespec *abstime);
+int pthread_rwlock_timedwrlock(pthread_rwlock_t *rwlock, const struct timespec *abstime);
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock);
+int pthread_rwlockattr_destroy(pthread_rwlockattr_t *attr);
+int pthread_rwlockattr_init(pthread_rwlockattr_t *attr);
+
+// Barriers
+int pthread_barrier_destroy(pthread_barrier_t *barrier);
+int pthread_barrier_init(pthread_barrier_t *barrier, const pthread_barrierattr_t *attr, unsigned count);
+int pthread_barrier_wait(pthread_barrier_t *barrier);
+int pthread_barrierattr_destroy(pthread_barrierattr_t *attr);
+int pthread_barrierattr_init(pthread_barrierattr_t *attr);
+
+// Dynamic package initialization
+int pthread_once(pthread_once_t *once_control, void (*init_routine)(void));
+
+// Thread-specific data
+void *pthread_getspecific(pthread_key_t key);
+int pthread_key_create(pthread_key_t *key, void (*destructor)(void *));
+int pthread_key_delete(pthread_key_t key);
+int pthread_setspecific(pthread_key_t key, const void *value);
@@ -15,6 +15,25 @@
 #define MAP_FIXED 0x0400                 // Interpret addr exactly.
 #define MAP_PRIVATE 0x0200               // Changes are private.
 #define MAP_SHARED 0x0100                // Share changes.
+#define MAP_ANONYMOUS 0x0800             // Map zeroed memory not backed by a file. Not POSIX.
+#define MAP_ANON MAP_ANONYMOUS
+
+// advice options
+#define MADV_NORMAL 0                   // No special treatment.
+#define MADV_RANDOM 1                   // Expect random page references.
+#define MADV_SEQUENTIAL 2               // Expect sequential page references.
+#define MADV_WILLNEED 3                 // Will need these pages.
+#define MADV_DONTNEED 4                 // Discard the contents of these pages. Not POSIX.
+
+// Granularity of anonymous mappings
+#ifndef MMAP_PAGE_SIZE
+#define MMAP_PAGE_SIZE 1024
+#endif
+
+// Number of pages that anonymous mappings allocate from the heap at a time
+#ifndef MMAP_CHUNK_PAGES
+#define MMAP_CHUNK_PAGES 16
+#endif
 
 #define MAP_FAILED NULL
 
@@ -22,3 +41,9 @@
 void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off);
 
 int munmap(void *addr, size_t len);
+
+int madvise(void *addr, size_t len, int advice);
+
+int shm_open(const char *name, int oflag, mode_t mode);
+
+int shm_unlink(const char *name);
@@ -0,0 +1,36 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+
+#define SFD_CLOEXEC     O_CLOEXEC
+#define SFD_NONBLOCK    O_NONBLOCK
+
+
+struct signalfd_siginfo {
+    uint32_t ssi_signo;                 // Signal number
+    int32_t ssi_errno;                  // Error number (unused)
+    int32_t ssi_code;                   // Signal code
+    uint32_t ssi_pid;                   // PID of sender
+    uint32_t ssi_uid;                   // Real UID of sender (unused)
+    int32_t ssi_fd;                     // File descriptor (unused)
+    uint32_t ssi_tid;                   // Kernel timer ID (unused)
+    uint32_t ssi_band;                  // Band event (unused)
+    uint32_t ssi_overrun;               // Timer overrun count (unused)
+    uint32_t ssi_trapno;                // Trap number (unused)
+    int32_t ssi_status;                 // Exit status or signal (unused)
+    int32_t ssi_int;                    // Integer sent by sigqueue (unused)
+    uint64_t ssi_ptr;                   // Pointer sent by sigqueue (unused)
+    uint64_t ssi_utime;                 // User CPU time consumed (unused)
+    uint64_t ssi_stime;                 // System CPU time consumed (unused)
+    uint64_t ssi_addr;                  // Address that generated signal (unused)
+    uint16_t ssi_addr_lsb;              // Least significant bit of address (unused)
+    uint8_t pad[46];
+};
+
+
+int signalfd(int fd, const sigset_t *mask, int flags);
@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #if MORELIB_LWIP
 #include "lwip/opt.h"
@@ -21,6 +22,7 @@
 // POSIX options
 #define SO_ACCEPTCONN   0x0002          // Socket is accepting connections.
 #define SO_BROADCAST    0x0020          // Transmission of broadcast messages is supported.
+#define SO_BUSY_POLL    0x100e          // Microseconds to busy poll before blocking.
 #define SO_DEBUG        0x0001          // Debugging information is being recorded.
 #define SO_DOMAIN       0x100c          // Socket domain.
 #define SO_DONTROUTE    0x0010          // Bypass normal routing.
@@ -28,6 +30,7 @@
 #define SO_KEEPALIVE    0x0008          // Connections are kept alive with periodic messages.
 #define SO_LINGER       0x0080          // Socket lingers on close.
 #define SO_OOBINLINE    0x0100          // Out-of-band data is transmitted in line.
+#define SO_PEERCRED     0x100f          // Credentials of the connected peer.
 #define SO_PROTOCOL     0x100d          // Socket protocol.
 #define SO_RCVBUF       0x1002          // Receive buffer size.
 #define SO_RCVLOWAT     0x1004          // Receive ``low water mark''.
@@ -47,6 +50,19 @@
 
 #define SOMAXCONN 255                   // The maximum backlog queue length.
 
+// flags argument in recv(), recvfrom(), recvmsg(), send(), sendmsg() and sendto() calls
+#define MSG_PEEK        0x01            // Peeks at an incoming message.
+#define MSG_WAITALL     0x02            // Requests that the function block until the full amount of data requested can be returned.
+#define MSG_OOB         0x04            // Requests out-of-band data.
+#define MSG_DONTWAIT    0x08            // Nonblocking request.
+#define MSG_MORE        0x10            // Sender will send more.
+#define MSG_NOSIGNAL    0x20            // No SIGPIPE generated when an attempt to send is made on a stream-oriented socket that is no longer connected.
+#define MSG_CTRUNC      0x40            // Control data truncated.
+#define MSG_TRUNC       0x80            // Normal data truncated.
+
+// cmsg_type argument in control messages at level SOL_SOCKET
+#define SCM_RIGHTS      0x01            // Indicates that the data array contains the access rights to be sent or received.
+
 #define AF_UNSPEC 0                     // Unspecified.
 #define AF_UNIX 1                       // UNIX domain sockets.
 #define AF_INET 2                       // Internet domain sockets for use with IPv4 addresses.
@@ -81,6 +97,39 @@ struct linger {
     int l_linger;                       // Linger time, in seconds.
 };
 
+struct msghdr {
+    void *msg_name;                     // Optional address.
+    socklen_t msg_namelen;              // Size of address.
+    struct iovec *msg_iov;              // Scatter/gather array.
+    int msg_iovlen;                     // Members in msg_iov.
+    void *msg_control;                  // Ancillary data.
+    socklen_t msg_controllen;           // Ancillary data buffer len.
+    int msg_flags;                      // Flags on received message.
+};
+
+struct cmsghdr {
+    socklen_t cmsg_len;                 // Data byte count, including the cmsghdr.
+    int cmsg_level;                     // Originating protocol.
+    int cmsg_type;                      // Protocol-specific type.
+};
+
+struct ucred {
+    pid_t pid;                          // Process ID of the sending process.
+    uid_t uid;                          // User ID of the sending process.
+    gid_t gid;                          // Group ID of the sending process.
+};
+
+#define CMSG_ALIGN(len) (((len) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1))
+#define CMSG_SPACE(len) (CMSG_ALIGN(sizeof(struct cmsghdr)) + CMSG_ALIGN(len))
+#define CMSG_LEN(len) (CMSG_ALIGN(sizeof(struct cmsghdr)) + (len))
+#define CMSG_DATA(cmsg) ((unsigned char *)(cmsg) + CMSG_ALIGN(sizeof(struct cmsghdr)))
+#define CMSG_FIRSTHDR(mhdr) \
+    ((mhdr)->msg_controllen >= sizeof(struct cmsghdr) ? (struct cmsghdr *)(mhdr)->msg_control : NULL)
+#define CMSG_NXTHDR(mhdr, cmsg) \
+    (((unsigned char *)(cmsg) + CMSG_ALIGN((cmsg)->cmsg_len) + sizeof(struct cmsghdr) > \
+      (unsigned char *)(mhdr)->msg_control + (mhdr)->msg_controllen) ? NULL : \
+     (struct cmsghdr *)((unsigned char *)(cmsg) + CMSG_ALIGN((cmsg)->cmsg_len)))
+
 int accept(int fd, struct sockaddr *address, socklen_t *address_len);
 int bind(int fd, const struct sockaddr *address, socklen_t address_len);
 int connect(int fd, const struct sockaddr *address, socklen_t address_len);
@@ -90,9 +139,9 @@ int getsockopt(int fd, int level, int option_name, void *option_value, socklen_t
 int listen(int fd, int backlog);
 ssize_t recv(int fd, void *buffer, size_t length, int flags);
 ssize_t recvfrom(int fd, void *buffer, size_t length, int flags, struct sockaddr *address, socklen_t *address_len);
-// ssize_t recvmsg(int, struct msghdr *, int);
+ssize_t recvmsg(int fd, struct msghdr *message, int flags);
 ssize_t send(int fd, const void *buffer, size_t length, int flags);
-// ssize_t sendmsg(int, const struct msghdr *, int);
+ssize_t sendmsg(int fd, const struct msghdr *message, int flags);
 ssize_t sendto(int fd, const void *message, size_t length, int flags, const struct sockaddr *dest_addr, socklen_t dest_len);
 int setsockopt(int fd, int level, int option_name, const void *option_value, socklen_t option_len);
 int shutdown(int fd, int how);
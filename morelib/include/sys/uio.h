@@ -0,0 +1,12 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <sys/types.h>
+
+
+struct iovec {
+    void *iov_base;                     // Base address of a memory region for input or output.
+    size_t iov_len;                     // The size of the memory pointed to by iov_base.
+};
@@ -5,9 +5,9 @@
 
 #include <sys/socket.h>
 
-// #define UNIX_PATH_MAX	16
+#define UNIX_PATH_MAX 64
 
 struct sockaddr_un {
 	sa_family_t     sun_family;     /* Address family */
-	char            sun_path[];     /* Socket pathname */
-};
\ No newline at end of file
+	char            sun_path[UNIX_PATH_MAX];    /* Socket pathname */
+};
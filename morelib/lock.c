@@ -2,70 +2,132 @@
 // SPDX-License-Identifier: MIT
 
 #include <malloc.h>
+#include <stdatomic.h>
 #include <sys/lock.h>
+#include "morelib/futex.h"
 
 #include "FreeRTOS.h"
-#include "semphr.h"
+#include "task.h"
+
+/* Locks used internally by Picolibc for stdio streams, malloc, and the environment.
+ *
+ * A lock is a futex word with no kernel object behind it, so a zero-initialized lock is ready to
+ * use and an uncontended acquire or release is a single atomic operation. When the lock is held,
+ * an acquirer on another core spins for a short while, since the holder is likely running and
+ * libc critical sections are short, and then blocks on the futex.
+ *
+ * Unlike FreeRTOS mutexes, these locks do not do priority inheritance.
+ */
+
+#ifndef LOCK_SPIN_COUNT
+#define LOCK_SPIN_COUNT (configNUMBER_OF_CORES > 1 ? 64 : 0)
+#endif
 
 struct __lock {
-    SemaphoreHandle_t mutex;
-    StaticSemaphore_t mutex_buffer;
+    atomic_uint state;                  // 0 = unlocked, 1 = locked, 2 = locked with waiters
+    TaskHandle_t owner;                 // owner of a recursive lock
+    uint count;                         // recursion count of a recursive lock
 };
 
 struct __lock __lock___libc_recursive_mutex;
 
-static void check_init(_LOCK_T lock) {
-    assert(lock);
-    if (!lock->mutex) {
-        lock->mutex = xSemaphoreCreateMutexStatic(&lock->mutex_buffer);
+static bool lock_try_acquire(_LOCK_T lock) {
+    uint c = 0;
+    return atomic_compare_exchange_strong_explicit(&lock->state, &c, 1, memory_order_acquire, memory_order_relaxed);
+}
+
+static void lock_acquire(_LOCK_T lock) {
+    if (lock_try_acquire(lock)) {
+        return;
+    }
+    for (int i = 0; i < LOCK_SPIN_COUNT; i++) {
+        if (!atomic_load_explicit(&lock->state, memory_order_relaxed) && lock_try_acquire(lock)) {
+            return;
+        }
+    }
+    // Mark the lock as having waiters, so that the owner wakes a waiter when it releases.
+    while (atomic_exchange_explicit(&lock->state, 2, memory_order_acquire) != 0) {
+        TickType_t xTicksToWait = portMAX_DELAY;
+        futex_wait(&lock->state, 2, &xTicksToWait);
     }
 }
 
-static void check_init_recursive(_LOCK_T lock) {
-    assert(lock);
-    if (!lock->mutex) {
-        lock->mutex = xSemaphoreCreateRecursiveMutexStatic(&lock->mutex_buffer);
+static void lock_release(_LOCK_T lock) {
+    if (atomic_exchange_explicit(&lock->state, 0, memory_order_release) == 2) {
+        futex_wake(&lock->state, 1);
     }
 }
 
+// Returns whether the current task already holds a recursive lock. Before the scheduler starts the
+// current task handle may be NULL, so the owner alone does not tell whether the lock is held.
+static bool lock_is_owner(_LOCK_T lock) {
+    return atomic_load_explicit(&lock->state, memory_order_relaxed) && (lock->owner == xTaskGetCurrentTaskHandle());
+}
+
 void __retarget_lock_init(_LOCK_T *lock) {
     *lock = calloc(1, sizeof(struct __lock));
-    check_init(*lock);
 }
 
 void __retarget_lock_init_recursive(_LOCK_T *lock) {
     *lock = calloc(1, sizeof(struct __lock));
-    check_init_recursive(*lock);
 }
 
 void __retarget_lock_close(_LOCK_T lock) {
-    assert(lock);
-    vSemaphoreDelete(lock->mutex);
+    assert(!lock || !atomic_load(&lock->state));
     free(lock);
 }
 
 void __retarget_lock_close_recursive(_LOCK_T lock) {
-    assert(lock);
-    vSemaphoreDelete(lock->mutex);
+    assert(!lock || !atomic_load(&lock->state));
     free(lock);
 }
 
 void __retarget_lock_acquire(_LOCK_T lock) {
-    check_init(lock);
-    xSemaphoreTake(lock->mutex, portMAX_DELAY);
+    assert(lock);
+    lock_acquire(lock);
 }
 
 void __retarget_lock_acquire_recursive(_LOCK_T lock) {
-    check_init_recursive(lock);
-    xSemaphoreTakeRecursive(lock->mutex, portMAX_DELAY);
+    assert(lock);
+    if (lock_is_owner(lock)) {
+        lock->count++;
+        return;
+    }
+    lock_acquire(lock);
+    lock->owner = xTaskGetCurrentTaskHandle();
+    lock->count = 1;
+}
+
+int __retarget_lock_try_acquire(_LOCK_T lock) {
+    assert(lock);
+    return lock_try_acquire(lock);
+}
+
+int __retarget_lock_try_acquire_recursive(_LOCK_T lock) {
+    assert(lock);
+    if (lock_is_owner(lock)) {
+        lock->count++;
+        return 1;
+    }
+    if (!lock_try_acquire(lock)) {
+        return 0;
+    }
+    lock->owner = xTaskGetCurrentTaskHandle();
+    lock->count = 1;
+    return 1;
 }
 
 void __retarget_lock_release(_LOCK_T lock) {
-    check_init(lock);
-    xSemaphoreGive(lock->mutex);
+    assert(lock);
+    lock_release(lock);
 }
 
 void __retarget_lock_release_recursive(_LOCK_T lock) {
-    check_init_recursive(lock);
-    xSemaphoreGiveRecursive(lock->mutex);
+    assert(lock);
+    assert(lock_is_owner(lock));
+    if (--lock->count) {
+        return;
+    }
+    lock->owner = NULL;
+    lock_release(lock);
 }
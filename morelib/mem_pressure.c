@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <malloc.h>
+#include <stddef.h>
+#include <string.h>
+#include "morelib/mem_pressure.h"
+#include "morelib/poll.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+
+struct mem_pressure_file {
+    struct poll_file base;
+    struct mem_watcher watcher;
+    uint64_t free;                      // free heap when the watermark was last crossed, or 0 if read
+};
+
+static int mem_pressure_close(void *ctx) {
+    struct mem_pressure_file *file = ctx;
+    mem_watcher_unregister(&file->watcher);
+    free(file);
+    return 0;
+}
+
+static int mem_pressure_read(void *ctx, void *buffer, size_t size) {
+    struct mem_pressure_file *file = ctx;
+    if (size < sizeof(uint64_t)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    TickType_t xTicksToWait = portMAX_DELAY;
+    int ret;
+    do {
+        taskENTER_CRITICAL();
+        if (file->free) {
+            memcpy(buffer, &file->free, sizeof(uint64_t));
+            file->free = 0;
+            poll_file_notify(&file->base, POLLIN, 0);
+            ret = sizeof(uint64_t);
+        }
+        else {
+            errno = EAGAIN;
+            ret = -1;
+        }
+        taskEXIT_CRITICAL();
+    }
+    while (POLL_CHECK(ret, &file->base, POLLIN, &xTicksToWait));
+    return ret;
+}
+
+static const struct vfs_file_vtable mem_pressure_vtable = {
+    .pollable = 1,
+    .close = mem_pressure_close,
+    .read = mem_pressure_read,
+};
+
+static void mem_pressure_notify(struct mem_watcher *watcher, size_t free) {
+    struct mem_pressure_file *file = (void *)watcher - offsetof(struct mem_pressure_file, watcher);
+    if (watcher->below) {
+        taskENTER_CRITICAL();
+        // The free heap may be 0, which would read as no event.
+        file->free = free ? free : 1;
+        poll_file_notify(&file->base, 0, POLLIN);
+        taskEXIT_CRITICAL();
+    }
+}
+
+int mem_pressure_open(size_t low_watermark, int flags) {
+    struct mem_pressure_file *file = calloc(1, sizeof(struct mem_pressure_file));
+    if (!file) {
+        return -1;
+    }
+
+    poll_file_init(&file->base, &mem_pressure_vtable, O_RDONLY | (flags & ~O_ACCMODE), 0);
+    file->watcher.low_watermark = low_watermark;
+    file->watcher.notify = mem_pressure_notify;
+    mem_watcher_register(&file->watcher);
+
+    int ret = poll_file_fd(&file->base);
+    poll_file_release(&file->base);
+    return ret;
+}
@@ -0,0 +1,362 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <unistd.h>
+#include "freertos/heap_trace.h"
+#include "freertos/mem_pressure.h"
+#include "morelib/flash_heap.h"
+#include "morelib/mem_tier.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+
+#ifndef MEM_TIER_MAX_REGIONS
+#define MEM_TIER_MAX_REGIONS 4
+#endif
+
+// A block in a region. Allocated blocks only use the size, and their memory follows the header.
+struct mem_block {
+    size_t size;                        // size of the block including the header
+    struct mem_block *next;             // next free block in address order, only valid when free
+};
+
+#define MEM_BLOCK_HEADER ((sizeof(struct mem_block) + 7) & ~7)
+
+// A region is a first-fit arena with an address-ordered free list, so freed neighbours merge.
+struct mem_region {
+    enum mem_tier tier;
+    char *start;
+    char *end;
+    struct mem_block *free_list;
+};
+
+struct mem_tier_state {
+    size_t used;
+    size_t peak_used;
+    uint32_t num_allocs;
+    uint32_t num_fallbacks;
+};
+
+// Regions are protected by the mutex. Regions are only ever added, so the number of regions is
+// atomic to let mem_tier_of look up a pointer without the mutex.
+static SemaphoreHandle_t mem_tier_mutex;
+static struct mem_region mem_tier_regions[MEM_TIER_MAX_REGIONS];
+static atomic_uint mem_tier_num_regions;
+static bool mem_tier_psram_probed;
+
+// Tier statistics are protected by critical section.
+static struct mem_tier_state mem_tier_states[MEM_NUM_TIERS];
+
+__attribute__((constructor, visibility("hidden")))
+void mem_tier_init(void) {
+    static StaticSemaphore_t xMutexBuffer;
+    mem_tier_mutex = xSemaphoreCreateMutexStatic(&xMutexBuffer);
+}
+
+static void mem_tier_lock(void) {
+    xSemaphoreTake(mem_tier_mutex, portMAX_DELAY);
+}
+
+static void mem_tier_unlock(void) {
+    xSemaphoreGive(mem_tier_mutex);
+}
+
+static struct mem_region *mem_region_of(const void *ptr) {
+    uint num_regions = atomic_load_explicit(&mem_tier_num_regions, memory_order_acquire);
+    for (uint i = 0; i < num_regions; i++) {
+        struct mem_region *region = &mem_tier_regions[i];
+        if (((char *)ptr >= region->start) && ((char *)ptr < region->end)) {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+static void *mem_region_alloc(struct mem_region *region, size_t size) {
+    size_t need = (size + MEM_BLOCK_HEADER + 7) & ~7;
+    if (need < size) {
+        return NULL;
+    }
+    for (struct mem_block **pblock = &region->free_list; *pblock; pblock = &(*pblock)->next) {
+        struct mem_block *block = *pblock;
+        if (block->size < need) {
+            continue;
+        }
+        if (block->size - need >= 2 * MEM_BLOCK_HEADER) {
+            struct mem_block *rest = (void *)block + need;
+            rest->size = block->size - need;
+            rest->next = block->next;
+            *pblock = rest;
+            block->size = need;
+        } else {
+            *pblock = block->next;
+        }
+        return (void *)block + MEM_BLOCK_HEADER;
+    }
+    return NULL;
+}
+
+static void mem_region_free(struct mem_region *region, void *ptr) {
+    struct mem_block *block = ptr - MEM_BLOCK_HEADER;
+    struct mem_block **pblock = &region->free_list;
+    struct mem_block *prev = NULL;
+    while (*pblock && (*pblock < block)) {
+        prev = *pblock;
+        pblock = &(*pblock)->next;
+    }
+    block->next = *pblock;
+    *pblock = block;
+    if (block->next && ((void *)block + block->size == (void *)block->next)) {
+        block->size += block->next->size;
+        block->next = block->next->next;
+    }
+    if (prev && ((void *)prev + prev->size == (void *)block)) {
+        prev->size += block->size;
+        prev->next = block->next;
+    }
+}
+
+static size_t mem_region_largest(struct mem_region *region) {
+    size_t largest = 0;
+    for (struct mem_block *block = region->free_list; block; block = block->next) {
+        if (block->size > largest) {
+            largest = block->size;
+        }
+    }
+    return largest ? largest - MEM_BLOCK_HEADER : 0;
+}
+
+static int mem_tier_add_region_locked(enum mem_tier tier, void *base, size_t size) {
+    uint num_regions = atomic_load_explicit(&mem_tier_num_regions, memory_order_relaxed);
+    if (num_regions == MEM_TIER_MAX_REGIONS) {
+        errno = ENOMEM;
+        return -1;
+    }
+    char *start = (char *)(((uintptr_t)base + 7) & ~(uintptr_t)7);
+    char *end = (char *)(((uintptr_t)base + size) & ~(uintptr_t)7);
+    if (end - start < 2 * MEM_BLOCK_HEADER) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct mem_region *region = &mem_tier_regions[num_regions];
+    region->tier = tier;
+    region->start = start;
+    region->end = end;
+    region->free_list = (struct mem_block *)start;
+    region->free_list->size = end - start;
+    region->free_list->next = NULL;
+    atomic_store_explicit(&mem_tier_num_regions, num_regions + 1, memory_order_release);
+    return 0;
+}
+
+int mem_tier_add_region(enum mem_tier tier, void *base, size_t size) {
+    if ((tier == MEM_TIER_SRAM) || ((uint)tier >= MEM_NUM_TIERS)) {
+        errno = EINVAL;
+        return -1;
+    }
+    mem_tier_lock();
+    int ret = mem_tier_add_region_locked(tier, base, size);
+    mem_tier_unlock();
+    return ret;
+}
+
+size_t mem_tier_psram_size(const void *base, size_t device_size) {
+    size_t size = device_size / 2;
+    const char *str = getenv("PSRAM_HEAP_SIZE");
+    if (str) {
+        char *end;
+        size_t value = strtoul(str, &end, 0);
+        if (!*end) {
+            size = value;
+        }
+    }
+
+    // Programs already loaded into PSRAM end where the next flash heap header would go.
+    size_t avail = device_size;
+    const flash_heap_header_t *tail = flash_heap_next_header(FLASH_HEAP_DEVICE_PSRAM);
+    if (tail) {
+        size_t used = (const void *)(tail + 1) - base;
+        avail = (used < device_size) ? device_size - used : 0;
+    }
+    return MIN(size, avail);
+}
+
+// Claims the top of /dev/psram for the PSRAM tier. Must be called with the mutex held.
+static void mem_tier_probe_psram(void) {
+    mem_tier_psram_probed = true;
+    int fd = open("/dev/psram", O_RDWR);
+    if (fd < 0) {
+        return;
+    }
+    size_t size;
+    if (ioctl(fd, BLKGETSIZE, &size) >= 0) {
+        size <<= 9;
+        char *base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        size_t heap_size = base ? mem_tier_psram_size(base, size) : 0;
+        if (base && heap_size) {
+            mem_tier_add_region_locked(MEM_TIER_PSRAM, base + size - heap_size, heap_size);
+        }
+    }
+    close(fd);
+}
+
+// Returns the size of an allocation as counted in the statistics.
+static size_t mem_tier_block_size(struct mem_region *region, void *ptr) {
+    return region ? ((struct mem_block *)(ptr - MEM_BLOCK_HEADER))->size : malloc_usable_size(ptr);
+}
+
+// Counts an allocation of size bytes from a tier. A fallback is a MEM_BULK allocation that SRAM served.
+static void mem_tier_count(enum mem_tier tier, size_t size, bool fallback) {
+    struct mem_tier_state *state = &mem_tier_states[tier];
+    taskENTER_CRITICAL();
+    state->used += size;
+    if (state->used > state->peak_used) {
+        state->peak_used = state->used;
+    }
+    state->num_allocs++;
+    if (fallback) {
+        mem_tier_states[MEM_TIER_PSRAM].num_fallbacks++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+static void *mem_tier_alloc_psram(size_t size) {
+    void *ptr = NULL;
+    mem_tier_lock();
+    if (!mem_tier_psram_probed) {
+        mem_tier_probe_psram();
+    }
+    uint num_regions = atomic_load_explicit(&mem_tier_num_regions, memory_order_relaxed);
+    for (uint i = 0; (i < num_regions) && !ptr; i++) {
+        struct mem_region *region = &mem_tier_regions[i];
+        if (region->tier == MEM_TIER_PSRAM) {
+            ptr = mem_region_alloc(region, size);
+        }
+    }
+    mem_tier_unlock();
+    return ptr;
+}
+
+void *mem_tier_malloc(size_t size, enum mem_hint hint) {
+    if (hint == MEM_AUTO) {
+        hint = (size >= MEM_TIER_BULK_THRESHOLD) ? MEM_BULK : MEM_FAST;
+    }
+    if (hint == MEM_BULK) {
+        void *ptr = mem_tier_alloc_psram(size);
+        if (ptr) {
+            mem_tier_count(MEM_TIER_PSRAM, mem_tier_block_size(mem_region_of(ptr), ptr), false);
+            return ptr;
+        }
+    }
+    void *ptr = malloc(size);
+    while (!ptr && mem_pressure_reclaim(size)) {
+        ptr = malloc(size);
+    }
+    mem_pressure_poll();
+    if (ptr) {
+        mem_tier_count(MEM_TIER_SRAM, malloc_usable_size(ptr), hint == MEM_BULK);
+    }
+    return ptr;
+}
+
+void *mem_tier_calloc(size_t num, size_t size, enum mem_hint hint) {
+    size_t total;
+    if (__builtin_mul_overflow(num, size, &total)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *ptr = mem_tier_malloc(total, hint);
+    if (ptr) {
+        memset(ptr, 0, total);
+    }
+    return ptr;
+}
+
+enum mem_tier mem_tier_of(const void *ptr) {
+    struct mem_region *region = mem_region_of(ptr);
+    return region ? region->tier : MEM_TIER_SRAM;
+}
+
+void mem_tier_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    struct mem_region *region = mem_region_of(ptr);
+    enum mem_tier tier = region ? region->tier : MEM_TIER_SRAM;
+    size_t size = mem_tier_block_size(region, ptr);
+    taskENTER_CRITICAL();
+    mem_tier_states[tier].used -= size;
+    taskEXIT_CRITICAL();
+    if (region) {
+        mem_tier_lock();
+        mem_region_free(region, ptr);
+        mem_tier_unlock();
+    } else {
+        free(ptr);
+    }
+}
+
+void *mem_tier_realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return mem_tier_malloc(size, MEM_AUTO);
+    }
+    struct mem_region *region = mem_region_of(ptr);
+    size_t old_size = mem_tier_block_size(region, ptr) - (region ? MEM_BLOCK_HEADER : 0);
+    if (size <= old_size) {
+        return ptr;
+    }
+    void *new_ptr = mem_tier_malloc(size, region ? MEM_BULK : MEM_FAST);
+    if (new_ptr) {
+        memcpy(new_ptr, ptr, old_size);
+        mem_tier_free(ptr);
+    }
+    return new_ptr;
+}
+
+int mem_tier_get_stats(enum mem_tier tier, struct mem_tier_stats *stats) {
+    if ((uint)tier >= MEM_NUM_TIERS) {
+        errno = EINVAL;
+        return -1;
+    }
+    stats->size = 0;
+    stats->largest_free = 0;
+    if (tier == MEM_TIER_SRAM) {
+        struct heap_info info;
+        heap_get_info(&info);
+        stats->size = info.total_free;
+        stats->largest_free = info.largest_free;
+    } else {
+        mem_tier_lock();
+        uint num_regions = atomic_load_explicit(&mem_tier_num_regions, memory_order_relaxed);
+        for (uint i = 0; i < num_regions; i++) {
+            struct mem_region *region = &mem_tier_regions[i];
+            if (region->tier == tier) {
+                stats->size += region->end - region->start;
+                size_t largest = mem_region_largest(region);
+                if (largest > stats->largest_free) {
+                    stats->largest_free = largest;
+                }
+            }
+        }
+        mem_tier_unlock();
+    }
+    taskENTER_CRITICAL();
+    struct mem_tier_state *state = &mem_tier_states[tier];
+    stats->used = state->used;
+    stats->peak_used = state->peak_used;
+    stats->num_allocs = state->num_allocs;
+    stats->num_fallbacks = state->num_fallbacks;
+    taskEXIT_CRITICAL();
+    return 0;
+}
@@ -3,41 +3,281 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
 #include <sys/mman.h>
+#include <sys/param.h>
+#include "morelib/mem_tier.h"
 #include "morelib/vfs.h"
 
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+
+// A mapping of a file that must be unmapped. Mappings of files without a munmap function are static.
+struct mmap_region {
+    struct mmap_region *next;
+    void *addr;
+    size_t len;
+    struct vfs_file *file;
+};
+
+// A run of pages that anonymous mappings are allocated from. Large transient buffers come from
+// chunks instead of the malloc heap, so they are allocated and freed in whole pages, and a chunk
+// goes back to the heap in one piece once all of its pages are unmapped.
+struct mmap_chunk {
+    struct mmap_chunk *next;
+    char *pages;
+    uint num_pages;
+    uint num_free;
+    uint32_t used[];                    // bitmap of mapped pages
+};
+
+static SemaphoreHandle_t mmap_mutex;
+static struct mmap_region *mmap_regions;
+static struct mmap_chunk *mmap_chunks;
+
+__attribute__((constructor, visibility("hidden")))
+void mmap_init(void) {
+    static StaticSemaphore_t xMutexBuffer;
+    mmap_mutex = xSemaphoreCreateMutexStatic(&xMutexBuffer);
+}
+
 void *vfs_mmap(void *addr, size_t len, int prot, int flags, struct vfs_file *file, off_t off) {
     if (!len || (off < 0)) {
         errno = EINVAL;
         return NULL;
-    }    
-    if (file->func->mmap) {
-        return file->func->mmap(file, addr, len, prot, flags, off);
-    } else {
+    }
+    if (!file->func->mmap) {
         errno = ENODEV;
         return NULL;
     }
+    void *ret = file->func->mmap(file, addr, len, prot, flags, off);
+    if (!ret || !file->func->munmap) {
+        return ret;
+    }
+
+    // The region keeps the file open until it is unmapped.
+    struct mmap_region *region = malloc(sizeof(struct mmap_region));
+    if (!region) {
+        file->func->munmap(file, ret, len);
+        return NULL;
+    }
+    region->addr = ret;
+    region->len = len;
+    region->file = vfs_copy_file(file);
+    xSemaphoreTake(mmap_mutex, portMAX_DELAY);
+    region->next = mmap_regions;
+    mmap_regions = region;
+    xSemaphoreGive(mmap_mutex);
+    return ret;
+}
+
+static bool mmap_page_used(struct mmap_chunk *chunk, uint page) {
+    return chunk->used[page / 32] & (1u << (page % 32));
+}
+
+static void mmap_set_pages(struct mmap_chunk *chunk, uint page, uint num_pages, bool used) {
+    for (uint i = page; i < page + num_pages; i++) {
+        if (mmap_page_used(chunk, i) != used) {
+            chunk->used[i / 32] ^= 1u << (i % 32);
+            chunk->num_free += used ? -1 : 1;
+        }
+    }
+}
+
+// Finds a run of free pages in a chunk and marks it used. Must be called with the mutex held.
+static void *mmap_chunk_alloc(struct mmap_chunk *chunk, uint num_pages) {
+    if (chunk->num_free < num_pages) {
+        return NULL;
+    }
+    uint run = 0;
+    for (uint i = 0; i < chunk->num_pages; i++) {
+        run = mmap_page_used(chunk, i) ? 0 : run + 1;
+        if (run == num_pages) {
+            uint page = i + 1 - num_pages;
+            mmap_set_pages(chunk, page, num_pages, true);
+            return chunk->pages + page * MMAP_PAGE_SIZE;
+        }
+    }
+    return NULL;
+}
+
+// Returns the chunk that contains an address and the range of its pages that [addr, addr + len)
+// covers. Must be called with the mutex held.
+static struct mmap_chunk *mmap_chunk_of(void *addr, size_t len, uint *page, uint *num_pages) {
+    for (struct mmap_chunk *chunk = mmap_chunks; chunk; chunk = chunk->next) {
+        size_t off = (char *)addr - chunk->pages;
+        if (((char *)addr >= chunk->pages) && (off < chunk->num_pages * MMAP_PAGE_SIZE)) {
+            *page = off / MMAP_PAGE_SIZE;
+            *num_pages = MIN(len / MMAP_PAGE_SIZE + ((len % MMAP_PAGE_SIZE) != 0), chunk->num_pages - *page);
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+static bool mmap_page_aligned(struct mmap_chunk *chunk, void *addr) {
+    return ((char *)addr - chunk->pages) % MMAP_PAGE_SIZE == 0;
+}
+
+static struct mmap_chunk *mmap_chunk_create(uint num_pages) {
+    num_pages = MAX(num_pages, MMAP_CHUNK_PAGES);
+    size_t header = (offsetof(struct mmap_chunk, used) + (num_pages + 31) / 32 * sizeof(uint32_t) + 7) & ~7;
+    if (num_pages > (SIZE_MAX - header) / MMAP_PAGE_SIZE) {
+        return NULL;
+    }
+    struct mmap_chunk *chunk = mem_tier_malloc(header + num_pages * MMAP_PAGE_SIZE, MEM_BULK);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->pages = (char *)chunk + header;
+    chunk->num_pages = num_pages;
+    chunk->num_free = num_pages;
+    memset(chunk->used, 0, (num_pages + 31) / 32 * sizeof(uint32_t));
+    return chunk;
+}
+
+static void *mmap_anonymous(size_t len) {
+    if (len > SIZE_MAX - MMAP_PAGE_SIZE) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    uint num_pages = (len + MMAP_PAGE_SIZE - 1) / MMAP_PAGE_SIZE;
+    void *ret = NULL;
+    xSemaphoreTake(mmap_mutex, portMAX_DELAY);
+    for (struct mmap_chunk *chunk = mmap_chunks; chunk && !ret; chunk = chunk->next) {
+        ret = mmap_chunk_alloc(chunk, num_pages);
+    }
+    xSemaphoreGive(mmap_mutex);
+
+    if (!ret) {
+        // The heap is not touched with the mutex held, since claiming PSRAM maps a file.
+        struct mmap_chunk *chunk = mmap_chunk_create(num_pages);
+        if (!chunk) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        xSemaphoreTake(mmap_mutex, portMAX_DELAY);
+        chunk->next = mmap_chunks;
+        mmap_chunks = chunk;
+        ret = mmap_chunk_alloc(chunk, num_pages);
+        xSemaphoreGive(mmap_mutex);
+    }
+    memset(ret, 0, num_pages * MMAP_PAGE_SIZE);
+    return ret;
+}
+
+// Unmaps pages of an anonymous mapping. Returns false if addr is not in a chunk.
+static bool munmap_anonymous(void *addr, size_t len, int *ret) {
+    uint page, num_pages;
+    xSemaphoreTake(mmap_mutex, portMAX_DELAY);
+    struct mmap_chunk *chunk = mmap_chunk_of(addr, len, &page, &num_pages);
+    if (chunk && !mmap_page_aligned(chunk, addr)) {
+        xSemaphoreGive(mmap_mutex);
+        errno = EINVAL;
+        *ret = -1;
+        return true;
+    }
+    if (chunk) {
+        mmap_set_pages(chunk, page, num_pages, false);
+        if (chunk->num_free < chunk->num_pages) {
+            chunk = NULL;
+        } else {
+            struct mmap_chunk **pchunk = &mmap_chunks;
+            while (*pchunk != chunk) {
+                pchunk = &(*pchunk)->next;
+            }
+            *pchunk = chunk->next;
+        }
+        xSemaphoreGive(mmap_mutex);
+        mem_tier_free(chunk);
+        *ret = 0;
+        return true;
+    }
+    xSemaphoreGive(mmap_mutex);
+    return false;
 }
 
 void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t off) {
+    if (flags & MAP_ANONYMOUS) {
+        if (!len || (flags & MAP_FIXED)) {
+            errno = EINVAL;
+            return NULL;
+        }
+        return mmap_anonymous(len);
+    }
     struct vfs_file *file = vfs_acquire_file(fd, 0);
     if (!file) {
         return NULL;
     }
+    void *ret = NULL;
     int fd_flags = (file->flags + 1) & O_ACCMODE;
     if (!(fd_flags & FREAD)) {
         errno = EACCES;
-        return NULL;
+        goto exit;
     }
     if (!(fd_flags & FWRITE) && (prot & PROT_WRITE)) {
         errno = EACCES;
-        return NULL;
+        goto exit;
     }
-    void *ret = vfs_mmap(addr, len, prot, flags, file, off);
+    ret = vfs_mmap(addr, len, prot, flags, file, off);
+
+exit:
     vfs_release_file(file);
     return ret;
 }
 
 int munmap(void *addr, size_t len) {
-    return 0;
+    int ret;
+    if (munmap_anonymous(addr, len, &ret)) {
+        return ret;
+    }
+    xSemaphoreTake(mmap_mutex, portMAX_DELAY);
+    struct mmap_region **pregion = &mmap_regions;
+    struct mmap_region *region = NULL;
+    while (*pregion) {
+        if ((*pregion)->addr == addr) {
+            region = *pregion;
+            *pregion = region->next;
+            break;
+        }
+        pregion = &(*pregion)->next;
+    }
+    xSemaphoreGive(mmap_mutex);
+
+    if (!region) {
+        // Static mappings do not need to be unmapped.
+        return 0;
+    }
+    ret = region->file->func->munmap(region->file, region->addr, region->len);
+    vfs_release_file(region->file);
+    free(region);
+    return ret;
+}
+
+int madvise(void *addr, size_t len, int advice) {
+    if ((uint)advice > MADV_DONTNEED) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (advice != MADV_DONTNEED) {
+        return 0;
+    }
+    // Discarded pages of anonymous mappings read back as zero. File mappings are direct views of
+    // their device and have nothing to discard.
+    int ret = 0;
+    uint page, num_pages;
+    xSemaphoreTake(mmap_mutex, portMAX_DELAY);
+    struct mmap_chunk *chunk = mmap_chunk_of(addr, len, &page, &num_pages);
+    if (chunk && !mmap_page_aligned(chunk, addr)) {
+        errno = EINVAL;
+        ret = -1;
+    } else if (chunk) {
+        memset(chunk->pages + page * MMAP_PAGE_SIZE, 0, num_pages * MMAP_PAGE_SIZE);
+    }
+    xSemaphoreGive(mmap_mutex);
+    return ret;
 }
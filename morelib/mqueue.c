@@ -0,0 +1,477 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <mqueue.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "morelib/poll.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+
+struct mq_message {
+    struct mq_message *next;
+    unsigned prio;
+    size_t size;
+    char data[];
+};
+
+struct mqueue {
+    struct mqueue *next;                // list of named queues
+    char *name;                         // NULL once unlinked
+    struct mq_file *files;              // open descriptions of this queue
+    struct mq_message *messages;        // highest priority first, FIFO within a priority
+    struct mq_message *free_messages;
+    long maxmsg;
+    long msgsize;
+    long curmsgs;
+    int num_receivers;                  // tasks blocked in mq_receive
+    struct mq_file *notify_file;        // description registered by mq_notify, or NULL
+    struct sigevent notify;
+    char storage[];                     // message slots, preallocated so that sending never allocates
+};
+
+struct mq_file {
+    struct poll_file base;
+    struct mq_file *next;
+    struct mqueue *queue;
+};
+
+// All message queue state is protected by one mutex, since opening and unlinking touch the name list.
+static SemaphoreHandle_t mq_mutex;
+static struct mqueue *mq_queues;
+
+__attribute__((constructor, visibility("hidden")))
+void mq_init(void) {
+    static StaticSemaphore_t xMutexBuffer;
+    mq_mutex = xSemaphoreCreateMutexStatic(&xMutexBuffer);
+}
+
+static void mq_lock(void) {
+    xSemaphoreTake(mq_mutex, portMAX_DELAY);
+}
+
+static void mq_unlock(void) {
+    xSemaphoreGive(mq_mutex);
+}
+
+static const struct vfs_file_vtable mq_vtable;
+
+static struct mq_file *mq_acquire(mqd_t mqdes, int flags) {
+    struct mq_file *file = (void *)poll_file_acquire(mqdes, flags);
+    if (!file) {
+        return NULL;
+    }
+    if (file->base.base.func != &mq_vtable) {
+        poll_file_release(&file->base);
+        errno = EBADF;
+        return NULL;
+    }
+    return file;
+}
+
+static size_t mq_slot_size(long msgsize) {
+    size_t align = __alignof__(struct mq_message);
+    return (sizeof(struct mq_message) + msgsize + align - 1) & ~(align - 1);
+}
+
+static struct mqueue *mq_alloc(const char *name, long maxmsg, long msgsize) {
+    size_t slot_size = mq_slot_size(msgsize);
+    if ((size_t)maxmsg > (SIZE_MAX - sizeof(struct mqueue)) / slot_size) {
+        errno = EINVAL;
+        return NULL;
+    }
+    struct mqueue *queue = calloc(1, sizeof(struct mqueue) + maxmsg * slot_size);
+    if (!queue) {
+        return NULL;
+    }
+    queue->name = strdup(name);
+    if (!queue->name) {
+        free(queue);
+        return NULL;
+    }
+    queue->maxmsg = maxmsg;
+    queue->msgsize = msgsize;
+    for (long i = maxmsg - 1; i >= 0; i--) {
+        struct mq_message *message = (void *)(queue->storage + i * slot_size);
+        message->next = queue->free_messages;
+        queue->free_messages = message;
+    }
+    return queue;
+}
+
+static struct mqueue *mq_find(const char *name) {
+    for (struct mqueue *queue = mq_queues; queue; queue = queue->next) {
+        if (strcmp(queue->name, name) == 0) {
+            return queue;
+        }
+    }
+    return NULL;
+}
+
+// Removes a queue from the name list. Must be called with the mq mutex held.
+static void mq_remove(struct mqueue *queue) {
+    struct mqueue **pqueue = &mq_queues;
+    while (*pqueue) {
+        if (*pqueue == queue) {
+            *pqueue = queue->next;
+            break;
+        }
+        pqueue = &(*pqueue)->next;
+    }
+    free(queue->name);
+    queue->name = NULL;
+}
+
+// Updates the readiness of every open description of a queue. Must be called with the mq mutex held.
+static void mq_update(struct mqueue *queue) {
+    uint set = (queue->curmsgs ? POLLIN | POLLRDNORM : 0) | ((queue->curmsgs < queue->maxmsg) ? POLLOUT | POLLWRNORM : 0);
+    for (struct mq_file *file = queue->files; file; file = file->next) {
+        poll_file_notify(&file->base, POLLFILE & ~set, set);
+    }
+}
+
+static int mq_close_file(void *ctx) {
+    struct mq_file *file = ctx;
+    struct mqueue *queue = file->queue;
+    mq_lock();
+    struct mq_file **pfile = &queue->files;
+    while (*pfile) {
+        if (*pfile == file) {
+            *pfile = file->next;
+            break;
+        }
+        pfile = &(*pfile)->next;
+    }
+    if (queue->notify_file == file) {
+        queue->notify_file = NULL;
+    }
+    bool unused = !queue->files && !queue->name;
+    mq_unlock();
+
+    if (unused) {
+        free(queue);
+    }
+    free(file);
+    return 0;
+}
+
+static const struct vfs_file_vtable mq_vtable = {
+    .close = mq_close_file,
+    .pollable = 1,
+};
+
+mqd_t mq_open(const char *name, int oflag, ...) {
+    struct mq_attr *attr = NULL;
+    if (oflag & O_CREAT) {
+        va_list args;
+        va_start(args, oflag);
+        va_arg(args, mode_t);
+        attr = va_arg(args, struct mq_attr *);
+        va_end(args);
+    }
+    if (name[0] != '/') {
+        errno = EINVAL;
+        return -1;
+    }
+    if (strnlen(name, NAME_MAX + 1) > NAME_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    struct mq_file *file = calloc(1, sizeof(struct mq_file));
+    if (!file) {
+        return -1;
+    }
+    poll_file_init(&file->base, &mq_vtable, oflag & (O_ACCMODE | O_NONBLOCK | O_CLOEXEC), 0);
+
+    mq_lock();
+    struct mqueue *queue = mq_find(name);
+    if (queue && ((oflag & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL))) {
+        errno = EEXIST;
+        goto error;
+    }
+    if (!queue && !(oflag & O_CREAT)) {
+        errno = ENOENT;
+        goto error;
+    }
+    if (!queue) {
+        long maxmsg = attr ? attr->mq_maxmsg : MQ_DEFAULT_MAXMSG;
+        long msgsize = attr ? attr->mq_msgsize : MQ_DEFAULT_MSGSIZE;
+        if ((maxmsg <= 0) || (msgsize <= 0)) {
+            errno = EINVAL;
+            goto error;
+        }
+        queue = mq_alloc(name, maxmsg, msgsize);
+        if (!queue) {
+            goto error;
+        }
+        queue->next = mq_queues;
+        mq_queues = queue;
+    }
+    file->queue = queue;
+    file->next = queue->files;
+    queue->files = file;
+    mq_update(queue);
+    mq_unlock();
+
+    int ret = poll_file_fd(&file->base);
+    poll_file_release(&file->base);
+    return ret;
+
+error:
+    mq_unlock();
+    free(file);
+    return -1;
+}
+
+int mq_close(mqd_t mqdes) {
+    struct mq_file *file = mq_acquire(mqdes, 0);
+    if (!file) {
+        return -1;
+    }
+    poll_file_release(&file->base);
+    return close(mqdes);
+}
+
+int mq_unlink(const char *name) {
+    mq_lock();
+    struct mqueue *queue = mq_find(name);
+    bool unused = false;
+    if (queue) {
+        mq_remove(queue);
+        unused = !queue->files;
+    }
+    mq_unlock();
+
+    if (!queue) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (unused) {
+        free(queue);
+    }
+    return 0;
+}
+
+// Converts an absolute timeout to ticks from now.
+static int mq_timeout(const struct timespec *abstime, TickType_t *pxTicksToWait) {
+    *pxTicksToWait = portMAX_DELAY;
+    if (!abstime) {
+        return 0;
+    }
+    if ((abstime->tv_nsec < 0) || (abstime->tv_nsec >= 1000000000)) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    *pxTicksToWait = 0;
+    if (timespeccmp(abstime, &now, >)) {
+        struct timespec ts;
+        timespecsub(abstime, &now, &ts);
+        const long ns_per_tick = 1000000000 / configTICK_RATE_HZ;
+        *pxTicksToWait = ts.tv_sec * configTICK_RATE_HZ + (ts.tv_nsec + ns_per_tick - 1) / ns_per_tick;
+    }
+    return 0;
+}
+
+int mq_timedsend(mqd_t mqdes, const char *msg_ptr, size_t msg_len, unsigned msg_prio, const struct timespec *abstime) {
+    if (msg_prio >= MQ_PRIO_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    TickType_t xTicksToWait;
+    if (mq_timeout(abstime, &xTicksToWait) < 0) {
+        return -1;
+    }
+    struct mq_file *file = mq_acquire(mqdes, FWRITE);
+    if (!file) {
+        return -1;
+    }
+    struct mqueue *queue = file->queue;
+    if (msg_len > (size_t)queue->msgsize) {
+        poll_file_release(&file->base);
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    struct sigevent notify = { .sigev_notify = SIGEV_NONE };
+    int ret;
+    do {
+        mq_lock();
+        struct mq_message *message = queue->free_messages;
+        if (message) {
+            queue->free_messages = message->next;
+            message->prio = msg_prio;
+            message->size = msg_len;
+            memcpy(message->data, msg_ptr, msg_len);
+            struct mq_message **pmessage = &queue->messages;
+            while (*pmessage && ((*pmessage)->prio >= msg_prio)) {
+                pmessage = &(*pmessage)->next;
+            }
+            message->next = *pmessage;
+            *pmessage = message;
+
+            // A registered notification fires when a message arrives on an empty queue that no task is waiting on.
+            if ((queue->curmsgs++ == 0) && queue->notify_file && !queue->num_receivers) {
+                notify = queue->notify;
+                queue->notify_file = NULL;
+            }
+            mq_update(queue);
+            ret = 0;
+        } else {
+            errno = EAGAIN;
+            ret = -1;
+        }
+        mq_unlock();
+    }
+    while (POLL_CHECK(ret, &file->base, POLLOUT, &xTicksToWait));
+    poll_file_release(&file->base);
+
+    if (notify.sigev_notify == SIGEV_SIGNAL) {
+        kill(0, notify.sigev_signo);
+    }
+    return ret;
+}
+
+int mq_send(mqd_t mqdes, const char *msg_ptr, size_t msg_len, unsigned msg_prio) {
+    return mq_timedsend(mqdes, msg_ptr, msg_len, msg_prio, NULL);
+}
+
+ssize_t mq_timedreceive(mqd_t mqdes, char *msg_ptr, size_t msg_len, unsigned *msg_prio, const struct timespec *abstime) {
+    TickType_t xTicksToWait;
+    if (mq_timeout(abstime, &xTicksToWait) < 0) {
+        return -1;
+    }
+    struct mq_file *file = mq_acquire(mqdes, FREAD);
+    if (!file) {
+        return -1;
+    }
+    struct mqueue *queue = file->queue;
+    if (msg_len < (size_t)queue->msgsize) {
+        poll_file_release(&file->base);
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    bool waiting = false;
+    int ret;
+    do {
+        mq_lock();
+        if (waiting) {
+            queue->num_receivers--;
+            waiting = false;
+        }
+        struct mq_message *message = queue->messages;
+        if (message) {
+            queue->messages = message->next;
+            memcpy(msg_ptr, message->data, message->size);
+            if (msg_prio) {
+                *msg_prio = message->prio;
+            }
+            ret = message->size;
+            message->next = queue->free_messages;
+            queue->free_messages = message;
+            queue->curmsgs--;
+            mq_update(queue);
+        } else {
+            errno = EAGAIN;
+            ret = -1;
+            if (!(file->base.base.flags & FNONBLOCK)) {
+                queue->num_receivers++;
+                waiting = true;
+            }
+        }
+        mq_unlock();
+    }
+    while (POLL_CHECK(ret, &file->base, POLLIN, &xTicksToWait));
+
+    if (waiting) {
+        mq_lock();
+        queue->num_receivers--;
+        mq_unlock();
+    }
+    poll_file_release(&file->base);
+    return ret;
+}
+
+ssize_t mq_receive(mqd_t mqdes, char *msg_ptr, size_t msg_len, unsigned *msg_prio) {
+    return mq_timedreceive(mqdes, msg_ptr, msg_len, msg_prio, NULL);
+}
+
+int mq_notify(mqd_t mqdes, const struct sigevent *notification) {
+    if (notification && (notification->sigev_notify != SIGEV_NONE) && (notification->sigev_notify != SIGEV_SIGNAL)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (notification && (notification->sigev_notify == SIGEV_SIGNAL) && ((uint)notification->sigev_signo >= NSIG)) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct mq_file *file = mq_acquire(mqdes, 0);
+    if (!file) {
+        return -1;
+    }
+
+    struct mqueue *queue = file->queue;
+    int ret = 0;
+    mq_lock();
+    if (!notification) {
+        if (queue->notify_file == file) {
+            queue->notify_file = NULL;
+        }
+    } else if (queue->notify_file) {
+        errno = EBUSY;
+        ret = -1;
+    } else {
+        queue->notify_file = file;
+        queue->notify = *notification;
+    }
+    mq_unlock();
+    poll_file_release(&file->base);
+    return ret;
+}
+
+static void mq_getattr_internal(struct mq_file *file, struct mq_attr *mqstat) {
+    struct mqueue *queue = file->queue;
+    mqstat->mq_flags = file->base.base.flags & O_NONBLOCK;
+    mqstat->mq_maxmsg = queue->maxmsg;
+    mqstat->mq_msgsize = queue->msgsize;
+    mqstat->mq_curmsgs = queue->curmsgs;
+}
+
+int mq_getattr(mqd_t mqdes, struct mq_attr *mqstat) {
+    struct mq_file *file = mq_acquire(mqdes, 0);
+    if (!file) {
+        return -1;
+    }
+    mq_lock();
+    mq_getattr_internal(file, mqstat);
+    mq_unlock();
+    poll_file_release(&file->base);
+    return 0;
+}
+
+int mq_setattr(mqd_t mqdes, const struct mq_attr *mqstat, struct mq_attr *omqstat) {
+    struct mq_file *file = mq_acquire(mqdes, 0);
+    if (!file) {
+        return -1;
+    }
+    mq_lock();
+    if (omqstat) {
+        mq_getattr_internal(file, omqstat);
+    }
+    // Only the O_NONBLOCK flag can be changed. The other attributes are fixed when the queue is created.
+    file->base.base.flags = (file->base.base.flags & ~O_NONBLOCK) | (mqstat->mq_flags & O_NONBLOCK);
+    mq_unlock();
+    poll_file_release(&file->base);
+    return 0;
+}
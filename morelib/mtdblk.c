@@ -4,11 +4,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <malloc.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#include "freertos/mem_pressure.h"
 #include "morelib/ioctl.h"
 #include "morelib/mtd.h"
 #include "morelib/mtdblk.h"
@@ -19,123 +22,721 @@
 
 static struct mtdblk_file *mtdblk_files[MTDBLK_NUM_DEVICES];
 
+static void mtdblk_drop(struct mtdblk_file *file, bool all);
+#if MTDBLK_FTL
+static void mtdblk_ftl_free(struct mtdblk_ftl *ftl);
+#endif
+
 static void mtdblk_file_deinit(struct mtdblk_file *file) {
     if (file->file) {
         vfs_release_file(file->file);
     }
     file->file = NULL;
-    for (size_t i = 0; i < MTDBLK_NUM_CACHE_ENTRIES; i++) {
-        free(file->cache[i].page);
-        file->cache[i].page = NULL;
-    }
+    mtdblk_drop(file, true);
+    free(file->cache);
+    file->cache = NULL;
+    #if MTDBLK_FTL
+    mtdblk_ftl_free(file->ftl);
+    file->ftl = NULL;
+    #endif
     vSemaphoreDelete(file->mutex);
 }
 
-static void *mtdblk_put_page(struct mtdblk_file *file, size_t cache_index) {
-    assert(cache_index < MTDBLK_NUM_CACHE_ENTRIES);
-    struct mtdblk_cache_entry *entry = &file->cache[cache_index];
-    assert(entry->page);
-    #ifndef NDEBUG
-    // printf("mtdblk%d wrote page %u\n", file->index, file->cache[cache_index].num);
-    #endif
+static void mtdblk_touch(struct mtdblk_file *file, struct mtdblk_cache_entry *entry) {
+    entry->tick = ++file->next_tick;
+}
+
+// Returns the first entry of the set that a block maps to.
+static struct mtdblk_cache_entry *mtdblk_set_of(struct mtdblk_file *file, size_t page_num) {
+    size_t num_sets = file->num_entries / file->num_ways;
+    return &file->cache[(page_num % num_sets) * file->num_ways];
+}
+
+static struct mtdblk_cache_entry *mtdblk_lookup(struct mtdblk_file *file, size_t page_num) {
+    struct mtdblk_cache_entry *set = mtdblk_set_of(file, page_num);
+    for (size_t i = 0; i < file->num_ways; i++) {
+        if (set[i].page && (set[i].num == page_num)) {
+            file->stats.hits++;
+            mtdblk_touch(file, &set[i]);
+            return &set[i];
+        }
+    }
+    return NULL;
+}
+
+#if MTDBLK_FTL
+/* Flash translation layer
+ *
+ * Each erase block starts with a header, padded to the write size, followed by sector slots. The
+ * header holds the erase count of the block, the sequence number it was given when it was opened
+ * for writing, and a tag per slot with the sector number the slot holds. Values are stored with
+ * their complement, so a value whose programming was cut short does not verify, and unprogrammed
+ * values read as all ones. A sector is only found at mount if its tag verifies, and of several
+ * copies of a sector, the one in the block with the highest sequence number, or in the highest
+ * slot of that block, is current.
+ */
+#define MTDBLK_FTL_MAGIC 0x314c5446     // "FTL1"
+#define MTDBLK_FTL_UNMAPPED UINT32_MAX
+
+#define MTDBLK_FTL_FREE 0               // erased, with a header but no sequence number
+#define MTDBLK_FTL_USED 1               // opened for writing
+#define MTDBLK_FTL_DIRTY 2              // must be erased before it is used
+
+struct mtdblk_ftl_header {
+    uint32_t magic;
+    uint32_t erase_count;
+    uint32_t seq;
+    uint32_t seq_check;                 // ~seq
+    uint32_t tags[][2];                 // sector number and its complement, per slot
+};
+
+static void mtdblk_ftl_free(struct mtdblk_ftl *ftl) {
+    if (ftl) {
+        free(ftl->map);
+        free(ftl->blocks);
+        free(ftl->buffer);
+        free(ftl);
+    }
+}
+
+// Allocates a translation layer for the geometry of an MTD device.
+static struct mtdblk_ftl *mtdblk_ftl_alloc(const struct mtd_info *mtd_info) {
+    size_t write_size = MAX(mtd_info->writesize, 1);
+    size_t sector_size = MAX(MTDBLK_FTL_SECTOR_SIZE, write_size);
+    size_t erase_size = mtd_info->erasesize;
+    uint num_blocks = erase_size ? mtd_info->size / erase_size : 0;
+    uint num_slots = 0;
+    size_t header_size = 0;
+    for (;;) {
+        size_t size = sizeof(struct mtdblk_ftl_header) + (num_slots + 1) * sizeof(uint32_t[2]);
+        size = (size + write_size - 1) / write_size * write_size;
+        if (size + (num_slots + 1) * sector_size > erase_size) {
+            break;
+        }
+        num_slots++;
+        header_size = size;
+    }
+    if (!num_slots || (num_blocks <= MTDBLK_FTL_SPARE_BLOCKS)) {
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    struct mtdblk_ftl *ftl = calloc(1, sizeof(struct mtdblk_ftl));
+    if (!ftl) {
+        return NULL;
+    }
+    ftl->erase_size = erase_size;
+    ftl->write_size = write_size;
+    ftl->sector_size = sector_size;
+    ftl->header_size = header_size;
+    ftl->num_blocks = num_blocks;
+    ftl->num_slots = num_slots;
+    ftl->num_sectors = (num_blocks - MTDBLK_FTL_SPARE_BLOCKS) * num_slots;
+    ftl->head = num_blocks;
+    ftl->map = malloc(ftl->num_sectors * sizeof(uint32_t));
+    ftl->blocks = calloc(num_blocks, sizeof(struct mtdblk_ftl_block));
+    ftl->buffer = malloc(MAX(sector_size + write_size, header_size));
+    if (!ftl->map || !ftl->blocks || !ftl->buffer) {
+        mtdblk_ftl_free(ftl);
+        return NULL;
+    }
+    memset(ftl->map, 0xff, ftl->num_sectors * sizeof(uint32_t));
+    return ftl;
+}
+
+static off_t mtdblk_ftl_slot_offset(struct mtdblk_ftl *ftl, uint32_t slot) {
+    return (off_t)(slot / ftl->num_slots) * ftl->erase_size + ftl->header_size + (slot % ftl->num_slots) * ftl->sector_size;
+}
+
+// Programs words of a block header. The rest of the write page is left as ones, which programming
+// does not change.
+static int mtdblk_ftl_program_header(struct mtdblk_file *file, uint block, size_t offset, const uint32_t *words, size_t num_words) {
+    struct mtdblk_ftl *ftl = file->ftl;
+    uint8_t *page = ftl->buffer + ftl->sector_size;
+    size_t page_offset = offset / ftl->write_size * ftl->write_size;
+    assert(offset + num_words * sizeof(uint32_t) <= page_offset + ftl->write_size);
+    memset(page, 0xff, ftl->write_size);
+    memcpy(page + offset - page_offset, words, num_words * sizeof(uint32_t));
+    return vfs_pwrite(file->file, page, ftl->write_size, (off_t)block * ftl->erase_size + page_offset) < 0 ? -1 : 0;
+}
+
+// Erases a block and writes its header with the next erase count.
+static int mtdblk_ftl_erase(struct mtdblk_file *file, uint block) {
+    struct mtdblk_ftl *ftl = file->ftl;
     struct erase_info erase_info = {
-        entry->num * file->block_size,
-        file->block_size,
+        block * ftl->erase_size,
+        ftl->erase_size,
     };
     if (vfs_ioctl(file->file, MEMERASE, &erase_info) < 0) {
-        return NULL;
+        return -1;
     }
-    if (vfs_pwrite(file->file, entry->page, file->block_size, entry->num * file->block_size) < 0) {
-        return NULL;
+    file->stats.erases++;
+    ftl->blocks[block].erase_count++;
+    ftl->blocks[block].num_valid = 0;
+    uint32_t words[] = { MTDBLK_FTL_MAGIC, ftl->blocks[block].erase_count };
+    if (mtdblk_ftl_program_header(file, block, 0, words, 2) < 0) {
+        return -1;
+    }
+    ftl->blocks[block].state = MTDBLK_FTL_FREE;
+    return 0;
+}
+
+// Opens the free block with the lowest erase count for writing, so wear is spread over the
+// blocks that are rewritten.
+static int mtdblk_ftl_open_head(struct mtdblk_file *file) {
+    struct mtdblk_ftl *ftl = file->ftl;
+    uint block = ftl->num_blocks;
+    for (uint i = 0; i < ftl->num_blocks; i++) {
+        if ((ftl->blocks[i].state != MTDBLK_FTL_USED) &&
+            ((block == ftl->num_blocks) || (ftl->blocks[i].erase_count < ftl->blocks[block].erase_count))) {
+            block = i;
+        }
+    }
+    assert(block < ftl->num_blocks);
+    if ((ftl->blocks[block].state == MTDBLK_FTL_DIRTY) && (mtdblk_ftl_erase(file, block) < 0)) {
+        return -1;
+    }
+    uint32_t seq = ftl->next_seq++;
+    uint32_t words[] = { seq, ~seq };
+    if (mtdblk_ftl_program_header(file, block, offsetof(struct mtdblk_ftl_header, seq), words, 2) < 0) {
+        // The sequence number may be partly programmed.
+        ftl->blocks[block].state = MTDBLK_FTL_DIRTY;
+        return -1;
+    }
+    ftl->blocks[block].seq = seq;
+    ftl->blocks[block].state = MTDBLK_FTL_USED;
+    ftl->num_free--;
+    ftl->head = block;
+    ftl->head_slot = 0;
+    return 0;
+}
+
+static int mtdblk_ftl_collect(struct mtdblk_file *file);
+
+// Makes sure the head block has a free slot. The last two free blocks are kept for garbage
+// collection, which may take one of them. If power is cut before the victim is freed, the block it
+// took is still in use at mount, so the other one lets the next collection move the victim's
+// sectors and finish.
+static int mtdblk_ftl_reserve(struct mtdblk_file *file) {
+    struct mtdblk_ftl *ftl = file->ftl;
+    while ((ftl->head == ftl->num_blocks) || (ftl->head_slot == ftl->num_slots)) {
+        if (ftl->num_free > (ftl->collecting ? 0 : 2)) {
+            if (mtdblk_ftl_open_head(file) < 0) {
+                return -1;
+            }
+        } else if (ftl->collecting) {
+            errno = ENOSPC;
+            return -1;
+        } else if (mtdblk_ftl_collect(file) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Writes a sector to the next slot of the head block, then programs its tag.
+static int mtdblk_ftl_write(struct mtdblk_file *file, uint32_t sector, const void *data) {
+    struct mtdblk_ftl *ftl = file->ftl;
+    if (mtdblk_ftl_reserve(file) < 0) {
+        return -1;
+    }
+    uint block = ftl->head;
+    uint slot = ftl->head_slot++;
+    uint32_t slot_num = block * ftl->num_slots + slot;
+    if (vfs_pwrite(file->file, data, ftl->sector_size, mtdblk_ftl_slot_offset(ftl, slot_num)) < 0) {
+        return -1;
+    }
+    file->stats.programs++;
+    uint32_t tag[] = { sector, ~sector };
+    if (mtdblk_ftl_program_header(file, block, sizeof(struct mtdblk_ftl_header) + slot * sizeof(uint32_t[2]), tag, 2) < 0) {
+        return -1;
     }
-    return entry->page;
+
+    uint32_t old = ftl->map[sector];
+    if (old != MTDBLK_FTL_UNMAPPED) {
+        ftl->blocks[old / ftl->num_slots].num_valid--;
+    }
+    ftl->map[sector] = slot_num;
+    ftl->blocks[block].num_valid++;
+    return 0;
 }
 
-static void *mtdblk_evict_page(struct mtdblk_file *file) {
-    size_t index = 0;
-    while (file->cache[index].page == NULL) {
-        if (++index == MTDBLK_NUM_CACHE_ENTRIES) {
-            errno = ENOMEM;
-            return NULL;
+static void mtdblk_ftl_erase_counts(struct mtdblk_ftl *ftl, uint32_t *min, uint32_t *max) {
+    *min = UINT32_MAX;
+    *max = 0;
+    for (uint i = 0; i < ftl->num_blocks; i++) {
+        *min = MIN(*min, ftl->blocks[i].erase_count);
+        *max = MAX(*max, ftl->blocks[i].erase_count);
+    }
+}
+
+// Frees a block by moving its current sectors to the head. The victim is usually the block with
+// the fewest current sectors. Every other time, if erase counts have drifted apart, it is the least
+// worn block instead, whose data is likely cold, so the block goes back into rotation.
+static int mtdblk_ftl_collect(struct mtdblk_file *file) {
+    struct mtdblk_ftl *ftl = file->ftl;
+    uint32_t min_erase_count, max_erase_count;
+    mtdblk_ftl_erase_counts(ftl, &min_erase_count, &max_erase_count);
+    bool level = ftl->static_turn && (max_erase_count - min_erase_count > MTDBLK_FTL_WEAR_THRESHOLD);
+    ftl->static_turn = !ftl->static_turn;
+
+    uint victim = ftl->num_blocks;
+    for (uint i = 0; i < ftl->num_blocks; i++) {
+        const struct mtdblk_ftl_block *b = &ftl->blocks[i];
+        if ((b->state != MTDBLK_FTL_USED) || (i == ftl->head)) {
+            continue;
+        }
+        if (victim == ftl->num_blocks) {
+            victim = i;
+            continue;
         }
+        const struct mtdblk_ftl_block *v = &ftl->blocks[victim];
+        if (level ? (b->erase_count < v->erase_count) :
+            ((b->num_valid < v->num_valid) || ((b->num_valid == v->num_valid) && (b->erase_count < v->erase_count)))) {
+            victim = i;
+        }
+    }
+    if (victim == ftl->num_blocks) {
+        errno = ENOSPC;
+        return -1;
     }
-    size_t oldest_index = index++;
-    while (index < MTDBLK_NUM_CACHE_ENTRIES) {
-        if ((file->cache[index].page != NULL) && (file->cache[index].tick < file->cache[oldest_index].tick)) {
-            oldest_index = index;
+
+    int ret = 0;
+    ftl->collecting = true;
+    for (uint slot = 0; (slot < ftl->num_slots) && ftl->blocks[victim].num_valid; slot++) {
+        uint32_t slot_num = victim * ftl->num_slots + slot;
+        uint32_t tag[2];
+        off_t tag_offset = (off_t)victim * ftl->erase_size + sizeof(struct mtdblk_ftl_header) + slot * sizeof(tag);
+        if (vfs_pread(file->file, tag, sizeof(tag), tag_offset) < 0) {
+            ret = -1;
+            break;
         }
-        index++;
+        uint32_t sector = tag[0];
+        if ((sector != ~tag[1]) || (sector >= ftl->num_sectors) || (ftl->map[sector] != slot_num)) {
+            continue;
+        }
+        if ((vfs_pread(file->file, ftl->buffer, ftl->sector_size, mtdblk_ftl_slot_offset(ftl, slot_num)) < 0) ||
+            (mtdblk_ftl_write(file, sector, ftl->buffer) < 0)) {
+            ret = -1;
+            break;
+        }
+        file->stats.gc_moves++;
+    }
+    ftl->collecting = false;
+    if (ret < 0) {
+        return -1;
     }
+    // The block is erased when it is next opened. Until then, its sectors are older than the copies
+    // that were just written, so they are ignored at mount.
+    assert(!ftl->blocks[victim].num_valid);
+    ftl->blocks[victim].state = MTDBLK_FTL_DIRTY;
+    ftl->num_free++;
+    return 0;
+}
 
-    void *cached_page = mtdblk_put_page(file, oldest_index);
-    file->cache[oldest_index].page = NULL;
-    return cached_page;
+// Reads part of a sector. Sectors that were never written read as erased.
+static int mtdblk_ftl_read(struct mtdblk_file *file, uint32_t sector, void *buffer, size_t offset, size_t len) {
+    struct mtdblk_ftl *ftl = file->ftl;
+    uint32_t slot_num = ftl->map[sector];
+    if (slot_num == MTDBLK_FTL_UNMAPPED) {
+        memset(buffer, 0xff, len);
+        return 0;
+    }
+    return vfs_pread(file->file, buffer, len, mtdblk_ftl_slot_offset(ftl, slot_num) + offset) < 0 ? -1 : 0;
 }
 
-static void *mtdblk_get_page(struct mtdblk_file *file, size_t pos) {
-    assert(pos < file->size);
-    size_t offset = pos % file->block_size;
-    size_t page_num = pos / file->block_size;
-    size_t index = page_num % MTDBLK_NUM_CACHE_ENTRIES;
-    struct mtdblk_cache_entry *entry = &file->cache[index];
-    if (!entry->page) {
-        entry->page = malloc(file->block_size);
-        if (!entry->page) {
-            entry->page = mtdblk_evict_page(file);
+static void mtdblk_ftl_discard(struct mtdblk_ftl *ftl, uint32_t begin, uint32_t end) {
+    for (uint32_t sector = begin; sector < MIN(end, ftl->num_sectors); sector++) {
+        uint32_t slot_num = ftl->map[sector];
+        if (slot_num != MTDBLK_FTL_UNMAPPED) {
+            ftl->blocks[slot_num / ftl->num_slots].num_valid--;
+            ftl->map[sector] = MTDBLK_FTL_UNMAPPED;
         }
-        if (!entry->page) {
-            return NULL;
+    }
+}
+
+// Rebuilds the sector map from the block headers. Returns the number of blocks that have a header.
+static int mtdblk_ftl_scan(struct mtdblk_file *file, struct mtdblk_ftl *ftl) {
+    struct mtdblk_ftl_header *header = (struct mtdblk_ftl_header *)ftl->buffer;
+    uint num_formatted = 0;
+    uint64_t erase_total = 0;
+    for (uint block = 0; block < ftl->num_blocks; block++) {
+        struct mtdblk_ftl_block *b = &ftl->blocks[block];
+        if (vfs_pread(file->file, header, ftl->header_size, (off_t)block * ftl->erase_size) < 0) {
+            return -1;
+        }
+        if (header->magic != MTDBLK_FTL_MAGIC) {
+            b->state = MTDBLK_FTL_DIRTY;
+            b->erase_count = UINT32_MAX;
+            continue;
+        }
+        num_formatted++;
+        b->erase_count = header->erase_count;
+        erase_total += header->erase_count;
+        if ((header->seq == UINT32_MAX) && (header->seq_check == UINT32_MAX)) {
+            b->state = MTDBLK_FTL_FREE;
+            continue;
+        }
+        if (header->seq != ~header->seq_check) {
+            b->state = MTDBLK_FTL_DIRTY;
+            continue;
+        }
+        b->state = MTDBLK_FTL_USED;
+        b->seq = header->seq;
+        ftl->next_seq = MAX(ftl->next_seq, header->seq + 1);
+        for (uint slot = 0; slot < ftl->num_slots; slot++) {
+            uint32_t sector = header->tags[slot][0];
+            if ((sector != ~header->tags[slot][1]) || (sector >= ftl->num_sectors)) {
+                continue;
+            }
+            uint32_t old = ftl->map[sector];
+            if (old != MTDBLK_FTL_UNMAPPED) {
+                // Slots of a block are filled in order, so a later slot of the same block is newer.
+                struct mtdblk_ftl_block *old_b = &ftl->blocks[old / ftl->num_slots];
+                if ((old_b != b) && (old_b->seq > b->seq)) {
+                    continue;
+                }
+                old_b->num_valid--;
+            }
+            ftl->map[sector] = block * ftl->num_slots + slot;
+            b->num_valid++;
         }
-        entry->num = ~page_num;
-    } else if (page_num != entry->num) {
-        mtdblk_put_page(file, index);
     }
-    if (page_num != entry->num) {
-        if (vfs_pread(file->file, entry->page, file->block_size, page_num * file->block_size) < 0) {
-            free(entry->page);
-            entry->page = NULL;
-            return NULL;
+
+    // Blocks without a header lost their erase count, so assume they are as worn as the rest.
+    uint32_t erase_average = num_formatted ? erase_total / num_formatted : 0;
+    for (uint block = 0; block < ftl->num_blocks; block++) {
+        struct mtdblk_ftl_block *b = &ftl->blocks[block];
+        if (b->state != MTDBLK_FTL_USED) {
+            ftl->num_free++;
+        }
+        if (b->erase_count == UINT32_MAX) {
+            b->erase_count = erase_average;
+        }
+    }
+    // Partly filled blocks may have a slot whose data was programmed but not its tag, so writing
+    // starts in a new block.
+    ftl->head = ftl->num_blocks;
+    return num_formatted;
+}
+
+// Switches a device to sectors of the translation layer.
+static void mtdblk_ftl_attach(struct mtdblk_file *file, struct mtdblk_ftl *ftl) {
+    file->ftl = ftl;
+    file->block_size = ftl->sector_size;
+    file->sector_size = ftl->sector_size;
+    file->size = (off_t)ftl->num_sectors * ftl->sector_size;
+}
+
+// Uses the translation layer if the device was formatted for it.
+static int mtdblk_ftl_mount(struct mtdblk_file *file, const struct mtd_info *mtd_info) {
+    if ((mtd_info->flags & (MTD_BIT_WRITEABLE | MTD_NO_ERASE)) != MTD_BIT_WRITEABLE) {
+        return 0;
+    }
+    struct mtdblk_ftl *ftl = mtdblk_ftl_alloc(mtd_info);
+    if (!ftl) {
+        return errno == ENOSPC ? 0 : -1;
+    }
+    int ret = mtdblk_ftl_scan(file, ftl);
+    if (ret <= 0) {
+        mtdblk_ftl_free(ftl);
+        return ret;
+    }
+    mtdblk_ftl_attach(file, ftl);
+    return 0;
+}
+
+// Erases every block and writes its header, keeping the erase counts of a previous format.
+static int mtdblk_ftl_format(struct mtdblk_file *file) {
+    struct mtd_info mtd_info;
+    if (vfs_ioctl(file->file, MEMGETINFO, &mtd_info) < 0) {
+        return -1;
+    }
+    if ((mtd_info.flags & (MTD_BIT_WRITEABLE | MTD_NO_ERASE)) != MTD_BIT_WRITEABLE) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct mtdblk_ftl *ftl = mtdblk_ftl_alloc(&mtd_info);
+    if (!ftl) {
+        return -1;
+    }
+    if (file->ftl) {
+        memcpy(ftl->blocks, file->ftl->blocks, ftl->num_blocks * sizeof(struct mtdblk_ftl_block));
+    } else if (mtdblk_ftl_scan(file, ftl) < 0) {
+        mtdblk_ftl_free(ftl);
+        return -1;
+    }
+
+    // The cache holds blocks of the old layout. Its entries are empty after this, so they can hold
+    // sectors of the new size.
+    mtdblk_drop(file, true);
+    mtdblk_ftl_free(file->ftl);
+    file->ftl = ftl;
+    memset(ftl->map, 0xff, ftl->num_sectors * sizeof(uint32_t));
+    ftl->head = ftl->num_blocks;
+    ftl->num_free = ftl->num_blocks;
+    for (uint block = 0; block < ftl->num_blocks; block++) {
+        if (mtdblk_ftl_erase(file, block) < 0) {
+            // The device stays formatted, with blocks that are erased when they are opened.
+            ftl->blocks[block].state = MTDBLK_FTL_DIRTY;
         }
-        entry->num = page_num;
     }
-    if (entry->tick < file->next_tick) {
-        entry->tick = ++file->next_tick;
+    mtdblk_ftl_attach(file, ftl);
+    return 0;
+}
+#endif
+
+// Reads part of a block of the device.
+static int mtdblk_read_block(struct mtdblk_file *file, size_t page_num, void *buffer, size_t offset, size_t len) {
+    #if MTDBLK_FTL
+    if (file->ftl) {
+        return mtdblk_ftl_read(file, page_num, buffer, offset, len);
+    }
+    #endif
+    return vfs_pread(file->file, buffer, len, page_num * file->block_size + offset) < 0 ? -1 : 0;
+}
+
+// Returns true if a sector can be programmed over the data in flash, which is the case when
+// programming only clears bits.
+static bool mtdblk_programmable(struct mtdblk_file *file, struct mtdblk_cache_entry *entry, size_t sector) {
+    const uint8_t *data = entry->page + sector * file->sector_size;
+    off_t offset = entry->num * file->block_size + sector * file->sector_size;
+    uint8_t buffer[64];
+    for (size_t pos = 0; pos < file->sector_size; pos += sizeof(buffer)) {
+        size_t len = MIN(sizeof(buffer), file->sector_size - pos);
+        if (vfs_pread(file->file, buffer, len, offset + pos) < 0) {
+            return false;
+        }
+        for (size_t i = 0; i < len; i++) {
+            if (~buffer[i] & data[pos + i]) {
+                return false;
+            }
+        }
     }
-    return entry->page + offset;
+    return true;
 }
 
-static void *mtdblk_find_page(struct mtdblk_file *file, size_t pos, size_t *len) {
-    assert(pos < file->size);
-    if (file->block_size > 1) {
-        size_t offset = pos % file->block_size;
-        *len = file->block_size - offset;
-        size_t page_num = pos / file->block_size;
-        size_t cache_index = page_num % MTDBLK_NUM_CACHE_ENTRIES;
-        struct mtdblk_cache_entry *entry = &file->cache[cache_index];
-        return (entry->page && (entry->num == page_num)) ? entry->page + offset : NULL;
+static int mtdblk_write_back(struct mtdblk_file *file, struct mtdblk_cache_entry *entry) {
+    assert(entry->page);
+    if (!entry->dirty) {
+        return 0;
     }
-    else {
-        *len = -1;
+    #if MTDBLK_FTL
+    if (file->ftl) {
+        if (mtdblk_ftl_write(file, entry->num, entry->page) < 0) {
+            return -1;
+        }
+        file->stats.writebacks++;
+        entry->dirty = 0;
+        return 0;
+    }
+    #endif
+    size_t num_sectors = file->block_size / file->sector_size;
+    bool in_place = file->flags & (MTD_NO_ERASE | MTD_BIT_WRITEABLE);
+    if (!(file->flags & MTD_NO_ERASE)) {
+        for (size_t i = 0; (i < num_sectors) && in_place; i++) {
+            if (entry->dirty & (1u << i)) {
+                in_place = mtdblk_programmable(file, entry, i);
+            }
+        }
+    }
+
+    off_t offset = entry->num * file->block_size;
+    if (in_place) {
+        for (size_t i = 0; i < num_sectors; i++) {
+            if (entry->dirty & (1u << i)) {
+                if (vfs_pwrite(file->file, entry->page + i * file->sector_size, file->sector_size, offset + i * file->sector_size) < 0) {
+                    return -1;
+                }
+                file->stats.programs++;
+            }
+        }
+    } else {
+        struct erase_info erase_info = {
+            offset,
+            file->block_size,
+        };
+        if (vfs_ioctl(file->file, MEMERASE, &erase_info) < 0) {
+            return -1;
+        }
+        file->stats.erases++;
+        if (vfs_pwrite(file->file, entry->page, file->block_size, offset) < 0) {
+            return -1;
+        }
+        file->stats.programs += num_sectors;
+    }
+    file->stats.writebacks++;
+    entry->dirty = 0;
+    return 0;
+}
+
+// Writes back an entry and takes its page. Returns NULL if the write back fails.
+static void *mtdblk_evict(struct mtdblk_file *file, struct mtdblk_cache_entry *entry) {
+    if (!entry->dirty) {
+        file->stats.clean_evictions++;
+    }
+    if (mtdblk_write_back(file, entry) < 0) {
         return NULL;
     }
+    void *page = entry->page;
+    entry->page = NULL;
+    return page;
 }
 
+// Takes the page of the least recently used entry of any set, for when no page can be allocated.
+static void *mtdblk_steal_page(struct mtdblk_file *file) {
+    struct mtdblk_cache_entry *oldest = NULL;
+    for (size_t i = 0; i < file->num_entries; i++) {
+        struct mtdblk_cache_entry *entry = &file->cache[i];
+        if (entry->page && (!oldest || (entry->tick < oldest->tick))) {
+            oldest = entry;
+        }
+    }
+    if (!oldest) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return mtdblk_evict(file, oldest);
+}
+
+// Returns the entry that caches a block, reading the block into the least recently used entry of
+// its set if needed. The block is not read if the caller overwrites all of it.
+static struct mtdblk_cache_entry *mtdblk_get_entry(struct mtdblk_file *file, size_t page_num, bool read) {
+    struct mtdblk_cache_entry *entry = mtdblk_lookup(file, page_num);
+    if (entry) {
+        return entry;
+    }
+
+    struct mtdblk_cache_entry *set = mtdblk_set_of(file, page_num);
+    entry = &set[0];
+    for (size_t i = 0; (i < file->num_ways) && entry->page; i++) {
+        if (!set[i].page || (set[i].tick < entry->tick)) {
+            entry = &set[i];
+        }
+    }
+    void *page;
+    if (entry->page) {
+        page = mtdblk_evict(file, entry);
+    } else {
+        page = malloc(file->block_size);
+        if (!page) {
+            page = mtdblk_steal_page(file);
+        }
+    }
+    if (!page) {
+        return NULL;
+    }
+
+    if (read && (mtdblk_read_block(file, page_num, page, 0, file->block_size) < 0)) {
+        free(page);
+        return NULL;
+    }
+    file->stats.misses++;
+    entry->num = page_num;
+    entry->page = page;
+    entry->dirty = 0;
+    mtdblk_touch(file, entry);
+    return entry;
+}
+
+// Writes back every dirty entry.
 static int mtdblk_flush(struct mtdblk_file *file) {
     int ret = 0;
-    for (size_t i = 0; i < MTDBLK_NUM_CACHE_ENTRIES; i++) {
-        if (file->cache[i].page) {
-            void *page = mtdblk_put_page(file, i);
-            if (page) {
-                file->cache[i].page = NULL;
-                free(page);
-            } else {
-                ret = -1;
-            }
+    for (size_t i = 0; i < file->num_entries; i++) {
+        if (file->cache[i].page && (mtdblk_write_back(file, &file->cache[i]) < 0)) {
+            ret = -1;
         }
     }
     return vfs_fsync(file->file) < 0 ? -1 : ret;
 }
 
+// Frees the pages of clean entries, or of all entries, discarding dirty data.
+static void mtdblk_drop(struct mtdblk_file *file, bool all) {
+    for (size_t i = 0; i < file->num_entries; i++) {
+        struct mtdblk_cache_entry *entry = &file->cache[i];
+        if (all || !entry->dirty) {
+            free(entry->page);
+            entry->page = NULL;
+            entry->dirty = 0;
+        }
+    }
+}
+
+static void mtdblk_mark_dirty(struct mtdblk_file *file, struct mtdblk_cache_entry *entry, size_t offset, size_t len) {
+    size_t first = offset / file->sector_size;
+    size_t last = (offset + len - 1) / file->sector_size;
+    for (size_t i = first; i <= last; i++) {
+        entry->dirty |= 1u << i;
+    }
+}
+
+static size_t mtdblk_num_cached(struct mtdblk_file *file) {
+    size_t num_cached = 0;
+    for (size_t i = 0; i < file->num_entries; i++) {
+        num_cached += file->cache[i].page != NULL;
+    }
+    return num_cached;
+}
+
+static int mtdblk_set_cache(struct mtdblk_file *file, size_t num_entries) {
+    size_t num_ways = MIN(num_entries, MTDBLK_CACHE_WAYS);
+    num_entries -= num_ways ? num_entries % num_ways : 0;
+    if (!num_entries) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct mtdblk_cache_entry *cache = calloc(num_entries, sizeof(struct mtdblk_cache_entry));
+    if (!cache) {
+        return -1;
+    }
+    int ret = 0;
+    if (file->cache) {
+        ret = mtdblk_flush(file);
+        mtdblk_drop(file, false);
+        if (mtdblk_num_cached(file)) {
+            // A dirty page could not be written back, so keep the old cache to not lose its data.
+            free(cache);
+            return -1;
+        }
+        free(file->cache);
+    }
+    file->cache = cache;
+    file->num_entries = num_entries;
+    file->num_ways = num_ways;
+    return ret;
+}
+
+// Writes back and frees the cached pages of every device that is not in use.
+static size_t mtdblk_shrink(struct mem_shrinker *shrinker, size_t size) {
+    size_t freed = 0;
+    if (!dev_try_lock()) {
+        return 0;
+    }
+    for (size_t i = 0; (i < MTDBLK_NUM_DEVICES) && (freed < size); i++) {
+        struct mtdblk_file *file = mtdblk_files[i];
+        if (file && xSemaphoreTake(file->mutex, 0)) {
+            size_t num_cached = mtdblk_num_cached(file);
+            mtdblk_flush(file);
+            mtdblk_drop(file, false);
+            freed += (num_cached - mtdblk_num_cached(file)) * file->block_size;
+            xSemaphoreGive(file->mutex);
+        }
+    }
+    dev_unlock();
+    return freed;
+}
+
+static struct mem_shrinker mtdblk_shrinker = {
+    .name = "mtdblk",
+    .priority = MEM_SHRINKER_PRIORITY_WRITEBACK,
+    .shrink = mtdblk_shrink,
+};
+
+__attribute__((constructor, visibility("hidden")))
+void mtdblk_init(void) {
+    mem_shrinker_register(&mtdblk_shrinker);
+}
+
 static int mtdblk_close(void *ctx) {
     struct mtdblk_file *file = ctx;
     int ret = mtdblk_flush(file);
@@ -194,6 +795,7 @@ static int mtdblk_ioctl(void *ctx, unsigned long request, va_list args) {
 
         case BLKFLSBUF: {
             ret = mtdblk_flush(file);
+            mtdblk_drop(file, false);
             break;
         }
 
@@ -208,16 +810,61 @@ static int mtdblk_ioctl(void *ctx, unsigned long request, va_list args) {
             uint64_t *range = va_arg(args, uint64_t *);
             size_t begin = (range[0] + file->block_size - 1) / file->block_size;
             size_t end = (range[0] + range[1]) / file->block_size;
-            for (size_t i = 0; i < MTDBLK_NUM_CACHE_ENTRIES; i++) {
-                if (file->cache[i].page && (file->cache[i].num >= begin) && (file->cache[i].num < end)) {
-                    file->cache[i].page = NULL;
-                    free(file->cache[i].page);
+            for (size_t i = 0; i < file->num_entries; i++) {
+                struct mtdblk_cache_entry *entry = &file->cache[i];
+                if (entry->page && (entry->num >= begin) && (entry->num < end)) {
+                    free(entry->page);
+                    entry->page = NULL;
+                    entry->dirty = 0;
                 }
             }
+            #if MTDBLK_FTL
+            if (file->ftl) {
+                mtdblk_ftl_discard(file->ftl, begin, end);
+            }
+            #endif
+            ret = 0;
+            break;
+        }
+
+        case MTDBLKGETCACHE: {
+            int *num_entries = va_arg(args, int *);
+            *num_entries = file->num_entries;
             ret = 0;
             break;
         }
 
+        case MTDBLKSETCACHE: {
+            const int *num_entries = va_arg(args, const int *);
+            if (*num_entries <= 0) {
+                errno = EINVAL;
+                break;
+            }
+            ret = mtdblk_set_cache(file, *num_entries);
+            break;
+        }
+
+        case MTDBLKGETSTATS: {
+            struct mtdblk_stats *stats = va_arg(args, struct mtdblk_stats *);
+            *stats = file->stats;
+            #if MTDBLK_FTL
+            if (file->ftl) {
+                mtdblk_ftl_erase_counts(file->ftl, &stats->min_erase_count, &stats->max_erase_count);
+            }
+            #endif
+            ret = 0;
+            break;
+        }
+
+        case MTDBLKFTLFORMAT: {
+            #if MTDBLK_FTL
+            ret = mtdblk_ftl_format(file);
+            #else
+            errno = ENOTSUP;
+            #endif
+            break;
+        }
+
         case MEMGETINFO:
         case MEMERASE:
         case MEMWRITEOOB:
@@ -270,6 +917,13 @@ exit:
 
 static void *mtdblk_mmap(void *ctx, void *addr, size_t len, int prot, int flags, off_t off) {
     struct mtdblk_file *file = ctx;
+    #if MTDBLK_FTL
+    if (file->ftl) {
+        // Sectors are not laid out in order on the device.
+        errno = ENODEV;
+        return NULL;
+    }
+    #endif
     return vfs_mmap(addr, len, prot, flags, file->file, off);
 }
 
@@ -277,11 +931,20 @@ static int mtdblk_rread(struct mtdblk_file *file, void *buffer, size_t size, off
     size = MIN(size, file->size - *offset);
     size_t remaining = size;
     while (remaining > 0) {
-        size_t len;
-        void *page = mtdblk_find_page(file, *offset, &len);
-        len = MIN(len, remaining);
-        if (page) {
-            memcpy(buffer, page, len);
+        size_t len = remaining;
+        struct mtdblk_cache_entry *entry = NULL;
+        size_t page_offset = 0;
+        if (file->block_size > 1) {
+            page_offset = *offset % file->block_size;
+            len = MIN(file->block_size - page_offset, remaining);
+            entry = mtdblk_lookup(file, *offset / file->block_size);
+        }
+        if (entry) {
+            memcpy(buffer, entry->page + page_offset, len);
+        } else if (file->block_size > 1) {
+            if (mtdblk_read_block(file, *offset / file->block_size, buffer, page_offset, len) < 0) {
+                return -1;
+            }
         } else {
             int ret = vfs_pread(file->file, buffer, len, *offset);
             if (ret < 0) {
@@ -328,17 +991,16 @@ static int mtdblk_rwrite(struct mtdblk_file *file, const void *buffer, size_t si
 
     size_t remaining = size;
     while (remaining > 0) {
-        size_t len;
-        void *page = mtdblk_find_page(file, *offset, &len);
-        if (!page && (file->block_size > 1)) {
-            page = mtdblk_get_page(file, *offset);
-            if (!page) {
+        size_t len = remaining;
+        if (file->block_size > 1) {
+            size_t page_offset = *offset % file->block_size;
+            len = MIN(file->block_size - page_offset, remaining);
+            struct mtdblk_cache_entry *entry = mtdblk_get_entry(file, *offset / file->block_size, len < file->block_size);
+            if (!entry) {
                 return -1;
             }
-        }
-        len = MIN(len, remaining);
-        if (page) {
-            memcpy(page, buffer, len);
+            memcpy(entry->page + page_offset, buffer, len);
+            mtdblk_mark_dirty(file, entry, page_offset, len);
         } else {
             int ret = vfs_pwrite(file->file, buffer, len, *offset);
             if (ret < 0) {
@@ -405,7 +1067,14 @@ static int mtdblk_file_init(struct mtdblk_file *file, int index, dev_t device) {
     }
     file->size = mtd_info.size;
     file->block_size = mtd_info.erasesize;
-    return 0;
+    file->sector_size = MAX(MAX(mtd_info.writesize, file->block_size / 32), 1);
+    file->flags = mtd_info.flags;
+    #if MTDBLK_FTL
+    if (mtdblk_ftl_mount(file, &mtd_info) < 0) {
+        return -1;
+    }
+    #endif
+    return mtdblk_set_cache(file, MTDBLK_NUM_CACHE_ENTRIES);
 }
 
 static void *mtdblk_open(const void *ctx, dev_t dev, int flags) {
@@ -3,9 +3,10 @@
 
 #include <errno.h>
 #include <fcntl.h>
-#include <malloc.h>
 #include <unistd.h>
+#include "morelib/fcntl.h"
 #include "morelib/pipe.h"
+#include "morelib/pool.h"
 #include "morelib/ring.h"
 
 #include "FreeRTOS.h"
@@ -24,8 +25,24 @@ struct pipe {
     ring_t ring;
     struct pipe_file files[2];
     StaticSemaphore_t mutex_buffer;
+    char buffer[1u << PIPE_DEFAULT_LOG2_SIZE];  // buffer of the default size, so a new pipe is one allocation
 };
 
+POOL_DEFINE(pipe_pool, struct pipe, PIPE_POOL_SIZE)
+
+static void pipe_ring_init(struct pipe *pipe, ring_t *ring) {
+    ring->buffer = pipe->buffer;
+    ring->size = sizeof(pipe->buffer);
+    ring->read_index = 0;
+    ring->write_index = 0;
+}
+
+static void pipe_ring_free(struct pipe *pipe) {
+    if (pipe->ring.buffer != pipe->buffer) {
+        ring_free(&pipe->ring);
+    }
+}
+
 static void pipe_lock(struct pipe *pipe) {
     xSemaphoreTake(pipe->mutex, portMAX_DELAY);
 }
@@ -43,8 +60,8 @@ static int pipe_close(void *ctx) {
     pipe_unlock(pipe);
     if (ref_count == 0) {
         vSemaphoreDelete(pipe->mutex);
-        ring_free(&pipe->ring);
-        free(pipe);
+        pipe_ring_free(pipe);
+        pool_free(pipe);
     }
     return 0;
 }
@@ -117,20 +134,83 @@ static const struct vfs_file_vtable pipe_vtable = {
     .write = pipe_write,
 };
 
-int pipe_pair(struct poll_file *pipes[2]) {
-    struct pipe *pipe = malloc(sizeof(struct pipe));
+static struct pipe *pipe_from_file(struct vfs_file *file) {
+    if (file->func != &pipe_vtable) {
+        errno = EBADF;
+        return NULL;
+    }
+    return ((struct pipe_file *)file)->pipe;
+}
+
+int pipe_get_size(struct vfs_file *file) {
+    struct pipe *pipe = pipe_from_file(file);
+    if (!pipe) {
+        return -1;
+    }
+    pipe_lock(pipe);
+    int ret = pipe->ring.size;
+    pipe_unlock(pipe);
+    return ret;
+}
+
+int pipe_set_size(struct vfs_file *file, int size) {
+    struct pipe *pipe = pipe_from_file(file);
     if (!pipe) {
         return -1;
     }
-    if (!ring_alloc(&pipe->ring, 9)) {
-        free(pipe);
+    if (size <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (size > PIPE_MAX_SIZE) {
+        errno = EPERM;
+        return -1;
+    }
+    uint log2_size = (size > 1) ? 32 - __builtin_clz(size - 1) : 0;
+
+    pipe_lock(pipe);
+    ring_t *ring = &pipe->ring;
+    size_t count = ring_read_count(ring);
+    int ret = -1;
+    if (count > (1u << log2_size)) {
+        errno = EBUSY;
+        goto end;
+    }
+    if ((1u << log2_size) != ring->size) {
+        ring_t new_ring;
+        if (log2_size == PIPE_DEFAULT_LOG2_SIZE) {
+            pipe_ring_init(pipe, &new_ring);
+        } else if (!ring_alloc(&new_ring, log2_size)) {
+            goto end;
+        }
+        ring_read(ring, new_ring.buffer, count);
+        new_ring.write_index = count;
+        pipe_ring_free(pipe);
+        *ring = new_ring;
+    }
+    // Recompute both ends from the resized ring rather than leaving the events of the old one.
+    uint readable = ring_read_count(ring) ? POLLIN | POLLRDNORM : 0;
+    poll_file_notify(&pipe->files[0].base, (POLLIN | POLLRDNORM) & ~readable, readable);
+    uint writable = ring_write_count(ring) ? POLLOUT | POLLWRNORM : 0;
+    poll_file_notify(&pipe->files[1].base, (POLLOUT | POLLWRNORM) & ~writable, writable);
+    ret = ring->size;
+
+    end:
+    pipe_unlock(pipe);
+    return ret;
+}
+
+int pipe_pair(struct poll_file *pipes[2], int flags) {
+    struct pipe *pipe = pool_alloc(&pipe_pool);
+    if (!pipe) {
         return -1;
     }
+    pipe_ring_init(pipe, &pipe->ring);
     pipe->mutex = xSemaphoreCreateMutexStatic(&pipe->mutex_buffer);
     pipe->ref_count = 0;
     for (int i = 0; i < 2; i++) {
         struct pipe_file *file = &pipe->files[i];
-        poll_file_init(&file->base, &pipe_vtable, O_RDONLY + i, i ? (POLLOUT | POLLWRNORM) : 0);
+        poll_file_init(&file->base, &pipe_vtable, (O_RDONLY + i) | (flags & ~O_ACCMODE), i ? (POLLOUT | POLLWRNORM) : 0);
         file->pipe = pipe;
         file->closed = 0;
         pipe->ref_count++;
@@ -139,9 +219,13 @@ int pipe_pair(struct poll_file *pipes[2]) {
     return 0;
 }
 
-int pipe(int fildes[2]) {
-    struct poll_file *pipes[2]; 
-    if (pipe_pair(pipes) < 0) {
+int pipe2(int fildes[2], int flags) {
+    if (flags & ~(O_CLOEXEC | O_NONBLOCK)) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct poll_file *pipes[2];
+    if (pipe_pair(pipes, flags) < 0) {
         return -1;
     }
     for (int i = 0; i < 2; i++) {
@@ -156,3 +240,7 @@ int pipe(int fildes[2]) {
     }
     return ret;
 }
+
+int pipe(int fildes[2]) {
+    return pipe2(fildes, 0);
+}
@@ -3,6 +3,9 @@
 
 #include <errno.h>
 #include <malloc.h>
+#include <sys/param.h>
+#include <time.h>
+#include "freertos/trace.h"
 #include "morelib/poll.h"
 #include "morelib/thread.h"
 
@@ -69,6 +72,9 @@ void poll_file_init(struct poll_file *file, const struct vfs_file_vtable *func,
     vfs_file_init(&file->base, func, flags);
     file->waiters = NULL;
     file->events = events;
+    file->busy_poll = 0;
+    file->busy_poll_hits = 0;
+    file->busy_poll_misses = 0;
 }
 
 struct poll_file *poll_file_acquire(int fd, int flags) {
@@ -132,6 +138,56 @@ uint poll_file_poll(struct poll_file *file) {
     return revents;
 }
 
+static bool poll_busy_ready(struct ppoll_waiter *descs, size_t num_descs, struct poll_file **ready) {
+    for (size_t i = 0; i < num_descs; i++) {
+        struct poll_file *file = descs[i].file;
+        // An aligned word read is atomic, so spinning does not need to enter the critical section.
+        if (file && (*(volatile int *)&file->events & descs[i].base.events)) {
+            *ready = file;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Spins until one of the waiters' files is ready or the largest busy poll budget among the files
+// runs out. Returns 1 if a file became ready, in which case the caller need not block, or 0 if the
+// caller should block. Returns -1 with errno set to EINTR if the thread is interrupted while
+// spinning, since the interrupt is consumed and would not abort the blocking call that follows.
+static int poll_busy_wait(struct ppoll_waiter *descs, size_t num_descs) {
+    uint budget = 0;
+    for (size_t i = 0; i < num_descs; i++) {
+        if (descs[i].file) {
+            budget = MAX(budget, descs[i].file->busy_poll);
+        }
+    }
+    struct poll_file *ready;
+    if (!budget || poll_busy_ready(descs, num_descs, &ready)) {
+        return 0;
+    }
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        if (poll_busy_ready(descs, num_descs, &ready)) {
+            ready->busy_poll_hits++;
+            return 1;
+        }
+        if (thread_check_interrupted()) {
+            return -1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+    while ((now.tv_sec - start.tv_sec) * 1000000LL + (now.tv_nsec - start.tv_nsec) / 1000 < budget);
+
+    for (size_t i = 0; i < num_descs; i++) {
+        if (descs[i].file && descs[i].file->busy_poll) {
+            descs[i].file->busy_poll_misses++;
+        }
+    }
+    return 0;
+}
+
 int poll_file_wait(struct poll_file *file, uint events, TickType_t *pxTicksToWait) {
     if (file->base.flags & FNONBLOCK) {
         errno = EAGAIN;
@@ -141,11 +197,15 @@ int poll_file_wait(struct poll_file *file, uint events, TickType_t *pxTicksToWai
     struct ppoll_waiter desc;
     poll_waiter_init(&desc.base, events, ppoll_notify);
     desc.task = xTaskGetCurrentTaskHandle();
-    desc.file = NULL;
+    desc.file = file;
+    int ret = poll_busy_wait(&desc, 1);
+    if (ret) {
+        return ret;
+    }
     ulTaskNotifyTake(pdTRUE, 0);
     poll_waiter_add(file, &desc.base);
 
-    int ret = poll_wait(pxTicksToWait);
+    ret = poll_wait(pxTicksToWait);
     if (ret == 0) {
         errno = ETIMEDOUT;
         ret = -1;
@@ -156,10 +216,15 @@ int poll_file_wait(struct poll_file *file, uint events, TickType_t *pxTicksToWai
 }
 
 
-int poll(struct pollfd fds[], nfds_t nfds, int timeout) {
-    struct ppoll_waiter *descs = calloc(nfds, sizeof(struct ppoll_waiter));
-    if (!descs) {
-        return -1;
+static int poll_internal(struct pollfd fds[], nfds_t nfds, int timeout) {
+    // Polling a few files, the common case, does not allocate.
+    struct ppoll_waiter stack_descs[POLL_STACK_NFDS] = { 0 };
+    struct ppoll_waiter *descs = stack_descs;
+    if (nfds > POLL_STACK_NFDS) {
+        descs = calloc(nfds, sizeof(struct ppoll_waiter));
+        if (!descs) {
+            return -1;
+        }
     }
 
     ulTaskNotifyTake(pdTRUE, 0);
@@ -187,7 +252,13 @@ int poll(struct pollfd fds[], nfds_t nfds, int timeout) {
     }
 
     TickType_t xTicksToWait = (timeout < 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout);
-    int ret = num_waiters ? poll_wait(&xTicksToWait) : 0;
+    int ret = 0;
+    if (num_waiters && timeout) {
+        ret = poll_busy_wait(descs, nfds);
+    }
+    if (!ret && num_waiters) {
+        ret = poll_wait(&xTicksToWait);
+    }
     int errcode = errno;
 
     size_t num_fds = 0;
@@ -201,7 +272,9 @@ int poll(struct pollfd fds[], nfds_t nfds, int timeout) {
             num_fds++;
         }
     }
-    free(descs);
+    if (descs != stack_descs) {
+        free(descs);
+    }
 
     if (ret < 0) {
         errno = errcode;
@@ -212,6 +285,13 @@ int poll(struct pollfd fds[], nfds_t nfds, int timeout) {
     }
 }
 
+int poll(struct pollfd fds[], nfds_t nfds, int timeout) {
+    TRACE_SYSCALL(TRACE_SYS_POLL, nfds);
+    int ret = poll_internal(fds, nfds, timeout);
+    TRACE_SYSCALL_RETURN(TRACE_SYS_POLL, ret);
+    return ret;
+}
+
 
 #include <sys/select.h>
 
@@ -0,0 +1,131 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <assert.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <string.h>
+#include "morelib/pool.h"
+
+
+// Pools are only ever pushed onto the list, so it can be walked without a lock.
+static _Atomic(struct pool *) pool_list;
+
+static uint pool_next_head(uint head, uint index) {
+    return (((head >> 16) + 1) << 16) | index;
+}
+
+// Adds a pool to the list on its first allocation. Returns false if another task is adding it, in
+// which case the caller must not hand out pool storage, since pool_free could not find it yet.
+static bool pool_register(struct pool *pool) {
+    uint state = atomic_load_explicit(&pool->state, memory_order_acquire);
+    if (state == POOL_REGISTERED) {
+        return true;
+    }
+    if ((state != POOL_UNREGISTERED) || !atomic_compare_exchange_strong(&pool->state, &state, POOL_REGISTERING)) {
+        return false;
+    }
+    assert(pool->capacity <= 0xffff);
+    pool->next = atomic_load_explicit(&pool_list, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&pool_list, &pool->next, pool, memory_order_release, memory_order_relaxed)) {
+        ;
+    }
+    atomic_store_explicit(&pool->state, POOL_REGISTERED, memory_order_release);
+    return true;
+}
+
+// Takes an object from the storage that has never been allocated, or returns NULL if there is none.
+static void *pool_carve(struct pool *pool) {
+    uint num_carved = atomic_load_explicit(&pool->num_carved, memory_order_relaxed);
+    while (num_carved < pool->capacity) {
+        if (atomic_compare_exchange_weak_explicit(&pool->num_carved, &num_carved, num_carved + 1, memory_order_relaxed, memory_order_relaxed)) {
+            return pool->objects + num_carved * pool->size;
+        }
+    }
+    return NULL;
+}
+
+void *pool_alloc(struct pool *pool) {
+    if (!pool_register(pool)) {
+        atomic_fetch_add_explicit(&pool->num_fallbacks, 1, memory_order_relaxed);
+        return malloc(pool->size);
+    }
+    uint head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    void *ptr;
+    uint new_head;
+    do {
+        uint index = head & 0xffff;
+        if (!index) {
+            ptr = pool_carve(pool);
+            if (!ptr) {
+                atomic_fetch_add_explicit(&pool->num_fallbacks, 1, memory_order_relaxed);
+                return malloc(pool->size);
+            }
+            break;
+        }
+        ptr = pool->objects + (index - 1) * pool->size;
+        // The object may be popped and reused by another task between the loads, in which case
+        // the generation in the head has changed and the exchange fails.
+        new_head = pool_next_head(head, atomic_load_explicit((atomic_uint *)ptr, memory_order_relaxed));
+    }
+    while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, new_head, memory_order_acquire, memory_order_acquire));
+
+    uint used = atomic_fetch_add_explicit(&pool->num_used, 1, memory_order_relaxed) + 1;
+    uint peak = atomic_load_explicit(&pool->peak_used, memory_order_relaxed);
+    while ((used > peak) && !atomic_compare_exchange_weak_explicit(&pool->peak_used, &peak, used, memory_order_relaxed, memory_order_relaxed)) {
+        ;
+    }
+    return ptr;
+}
+
+void *pool_calloc(struct pool *pool) {
+    void *ptr = pool_alloc(pool);
+    if (ptr) {
+        memset(ptr, 0, pool->size);
+    }
+    return ptr;
+}
+
+static struct pool *pool_of(void *ptr) {
+    for (struct pool *pool = atomic_load_explicit(&pool_list, memory_order_acquire); pool; pool = pool->next) {
+        if (((char *)ptr >= pool->objects) && ((char *)ptr < pool->objects + pool->capacity * pool->size)) {
+            return pool;
+        }
+    }
+    return NULL;
+}
+
+void pool_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    struct pool *pool = pool_of(ptr);
+    if (!pool) {
+        free(ptr);
+        return;
+    }
+    // Counting before pushing keeps the count from exceeding the capacity.
+    atomic_fetch_sub_explicit(&pool->num_used, 1, memory_order_relaxed);
+    uint index = ((char *)ptr - pool->objects) / pool->size + 1;
+    uint head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    do {
+        atomic_store_explicit((atomic_uint *)ptr, head & 0xffff, memory_order_relaxed);
+    }
+    while (!atomic_compare_exchange_weak_explicit(&pool->head, &head, pool_next_head(head, index), memory_order_release, memory_order_relaxed));
+}
+
+void pool_get_stats(struct pool *pool, struct pool_stats *stats) {
+    stats->capacity = pool->capacity;
+    stats->num_used = atomic_load_explicit(&pool->num_used, memory_order_relaxed);
+    stats->peak_used = atomic_load_explicit(&pool->peak_used, memory_order_relaxed);
+    stats->num_fallbacks = atomic_load_explicit(&pool->num_fallbacks, memory_order_relaxed);
+}
+
+void pool_report(FILE *stream) {
+    fprintf(stream, "%-24s %6s %6s %6s %9s\n", "POOL", "SIZE", "USED", "PEAK", "FALLBACKS");
+    for (struct pool *pool = atomic_load_explicit(&pool_list, memory_order_acquire); pool; pool = pool->next) {
+        struct pool_stats stats;
+        pool_get_stats(pool, &stats);
+        fprintf(stream, "%-24s %6u %6u %6u %9u\n", pool->name, stats.capacity, stats.num_used, stats.peak_used, stats.num_fallbacks);
+    }
+}
@@ -0,0 +1,648 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include "morelib/futex.h"
+#include "morelib/thread.h"
+
+/* Synchronization objects keep their state in an atomic word. Uncontended operations are a single
+ * atomic instruction, and FreeRTOS is only entered through futex_wait/futex_wake when a task has to
+ * block. The functions with a pxTicksToWait parameter try once without blocking if it is NULL.
+ */
+
+// Converts an absolute timeout on a clock to ticks from now.
+static int pthread_timeout(clockid_t clock_id, const struct timespec *abstime, TickType_t *pxTicksToWait) {
+    if ((abstime->tv_nsec < 0) || (abstime->tv_nsec >= 1000000000)) {
+        return EINVAL;
+    }
+    struct timespec now;
+    if (clock_gettime(clock_id, &now) < 0) {
+        return errno;
+    }
+    *pxTicksToWait = 0;
+    if (timespeccmp(abstime, &now, >)) {
+        struct timespec ts;
+        timespecsub(abstime, &now, &ts);
+        const long ns_per_tick = 1000000000 / configTICK_RATE_HZ;
+        *pxTicksToWait = ts.tv_sec * configTICK_RATE_HZ + (ts.tv_nsec + ns_per_tick - 1) / ns_per_tick;
+    }
+    return 0;
+}
+
+// Waits on a futex word. Returns 0 when woken or the word changed, or ETIMEDOUT.
+static int pthread_futex_wait(atomic_uint *addr, uint expected, TickType_t *pxTicksToWait) {
+    if ((futex_wait(addr, expected, pxTicksToWait) < 0) && (errno == ETIMEDOUT)) {
+        return ETIMEDOUT;
+    }
+    return 0;
+}
+
+
+// Thread attributes
+int pthread_attr_destroy(pthread_attr_t *attr) {
+    return 0;
+}
+
+int pthread_attr_getdetachstate(const pthread_attr_t *attr, int *detachstate) {
+    *detachstate = attr->detachstate;
+    return 0;
+}
+
+int pthread_attr_getstacksize(const pthread_attr_t *attr, size_t *stacksize) {
+    *stacksize = attr->stacksize;
+    return 0;
+}
+
+int pthread_attr_init(pthread_attr_t *attr) {
+    attr->stacksize = PTHREAD_STACK_DEFAULT;
+    attr->detachstate = PTHREAD_CREATE_JOINABLE;
+    return 0;
+}
+
+int pthread_attr_setdetachstate(pthread_attr_t *attr, int detachstate) {
+    if ((detachstate != PTHREAD_CREATE_JOINABLE) && (detachstate != PTHREAD_CREATE_DETACHED)) {
+        return EINVAL;
+    }
+    attr->detachstate = detachstate;
+    return 0;
+}
+
+int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize) {
+    if (stacksize < PTHREAD_STACK_MIN) {
+        return EINVAL;
+    }
+    attr->stacksize = stacksize;
+    return 0;
+}
+
+
+// Threads
+struct pthread_start {
+    void *(*start_routine)(void *);
+    void *arg;
+};
+
+static void pthread_entry(void *pvParameters) {
+    struct pthread_start start = *(struct pthread_start *)pvParameters;
+    free(pvParameters);
+    pthread_exit(start.start_routine(start.arg));
+}
+
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr, void *(*start_routine)(void *), void *arg) {
+    struct pthread_start *start = malloc(sizeof(struct pthread_start));
+    if (!start) {
+        return EAGAIN;
+    }
+    start->start_routine = start_routine;
+    start->arg = arg;
+
+    // New threads inherit the priority of their creator.
+    size_t stacksize = attr ? attr->stacksize : PTHREAD_STACK_DEFAULT;
+    thread_t *new_thread = thread_create(pthread_entry, THREAD_NAME_PTHREAD, stacksize / sizeof(StackType_t), start, uxTaskPriorityGet(NULL));
+    if (!new_thread) {
+        free(start);
+        return EAGAIN;
+    }
+    *thread = new_thread;
+    if (attr && (attr->detachstate == PTHREAD_CREATE_DETACHED)) {
+        thread_detach(new_thread);
+    }
+    return 0;
+}
+
+int pthread_detach(pthread_t thread) {
+    thread_detach(thread);
+    return 0;
+}
+
+int pthread_equal(pthread_t t1, pthread_t t2) {
+    return thread_equal(t1, t2);
+}
+
+static void pthread_key_run_destructors(void);
+
+void pthread_exit(void *value_ptr) {
+    pthread_key_run_destructors();
+    thread_t *thread = thread_current();
+    if (thread) {
+        thread->result = value_ptr;
+        thread_exit();
+    } else {
+        vTaskDelete(NULL);
+    }
+    __builtin_unreachable();
+}
+
+int pthread_join(pthread_t thread, void **value_ptr) {
+    if (thread == thread_current()) {
+        return EDEADLK;
+    }
+    // pthread_join is not a cancellation point, so retry if the thread is interrupted.
+    while (thread_join(thread, portMAX_DELAY) < 0) {
+        if (errno != EINTR) {
+            return errno;
+        }
+    }
+    if (value_ptr) {
+        *value_ptr = thread->result;
+    }
+    thread_detach(thread);
+    return 0;
+}
+
+pthread_t pthread_self(void) {
+    return thread_current();
+}
+
+
+// Mutexes
+int pthread_mutex_destroy(pthread_mutex_t *mutex) {
+    return atomic_load_explicit(&mutex->state, memory_order_relaxed) ? EBUSY : 0;
+}
+
+int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr) {
+    atomic_init(&mutex->state, 0);
+    mutex->type = attr ? attr->type : PTHREAD_MUTEX_DEFAULT;
+    mutex->owner = NULL;
+    mutex->count = 0;
+    return 0;
+}
+
+// Locks the futex word of a mutex after the fast path failed.
+static int pthread_mutex_lock_contended(pthread_mutex_t *mutex, TickType_t *pxTicksToWait) {
+    // Mark the mutex as having waiters, so that the owner wakes a waiter when it unlocks.
+    while (atomic_exchange_explicit(&mutex->state, 2, memory_order_acquire) != 0) {
+        if (pthread_futex_wait(&mutex->state, 2, pxTicksToWait)) {
+            return ETIMEDOUT;
+        }
+    }
+    return 0;
+}
+
+static int pthread_mutex_lock_internal(pthread_mutex_t *mutex, TickType_t *pxTicksToWait) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if ((mutex->type != PTHREAD_MUTEX_NORMAL) && (mutex->owner == self)) {
+        if (mutex->type != PTHREAD_MUTEX_RECURSIVE) {
+            return EDEADLK;
+        }
+        if (mutex->count == UINT_MAX) {
+            return EAGAIN;
+        }
+        mutex->count++;
+        return 0;
+    }
+
+    uint c = 0;
+    if (!atomic_compare_exchange_strong_explicit(&mutex->state, &c, 1, memory_order_acquire, memory_order_relaxed)) {
+        if (!pxTicksToWait) {
+            return EBUSY;
+        }
+        int ret = pthread_mutex_lock_contended(mutex, pxTicksToWait);
+        if (ret) {
+            return ret;
+        }
+    }
+    mutex->owner = self;
+    mutex->count = 1;
+    return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+    TickType_t xTicksToWait = portMAX_DELAY;
+    return pthread_mutex_lock_internal(mutex, &xTicksToWait);
+}
+
+int pthread_mutex_timedlock(pthread_mutex_t *mutex, const struct timespec *abstime) {
+    TickType_t xTicksToWait;
+    int ret = pthread_mutex_lock_internal(mutex, NULL);
+    if (ret != EBUSY) {
+        return ret;
+    }
+    ret = pthread_timeout(CLOCK_REALTIME, abstime, &xTicksToWait);
+    return ret ? ret : pthread_mutex_lock_internal(mutex, &xTicksToWait);
+}
+
+int pthread_mutex_trylock(pthread_mutex_t *mutex) {
+    return pthread_mutex_lock_internal(mutex, NULL);
+}
+
+int pthread_mutex_unlock(pthread_mutex_t *mutex) {
+    if (mutex->type != PTHREAD_MUTEX_NORMAL) {
+        if (mutex->owner != xTaskGetCurrentTaskHandle()) {
+            return EPERM;
+        }
+        if (--mutex->count) {
+            return 0;
+        }
+    }
+    mutex->owner = NULL;
+    if (atomic_exchange_explicit(&mutex->state, 0, memory_order_release) == 2) {
+        futex_wake(&mutex->state, 1);
+    }
+    return 0;
+}
+
+int pthread_mutexattr_destroy(pthread_mutexattr_t *attr) {
+    return 0;
+}
+
+int pthread_mutexattr_gettype(const pthread_mutexattr_t *attr, int *type) {
+    *type = attr->type;
+    return 0;
+}
+
+int pthread_mutexattr_init(pthread_mutexattr_t *attr) {
+    attr->type = PTHREAD_MUTEX_DEFAULT;
+    return 0;
+}
+
+int pthread_mutexattr_settype(pthread_mutexattr_t *attr, int type) {
+    if ((type < PTHREAD_MUTEX_NORMAL) || (type > PTHREAD_MUTEX_RECURSIVE)) {
+        return EINVAL;
+    }
+    attr->type = type;
+    return 0;
+}
+
+
+// Condition variables
+int pthread_cond_broadcast(pthread_cond_t *cond) {
+    atomic_fetch_add(&cond->seq, 1);
+    futex_wake(&cond->seq, INT_MAX);
+    return 0;
+}
+
+int pthread_cond_destroy(pthread_cond_t *cond) {
+    return 0;
+}
+
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr) {
+    atomic_init(&cond->seq, 0);
+    cond->clock = attr ? attr->clock : CLOCK_REALTIME;
+    return 0;
+}
+
+int pthread_cond_signal(pthread_cond_t *cond) {
+    atomic_fetch_add(&cond->seq, 1);
+    futex_wake(&cond->seq, 1);
+    return 0;
+}
+
+static int pthread_cond_wait_internal(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t *pxTicksToWait) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if ((mutex->type != PTHREAD_MUTEX_NORMAL) && (mutex->owner != self)) {
+        return EPERM;
+    }
+
+    // A signal after the sequence number is read changes it, so the wait below does not block.
+    uint seq = atomic_load(&cond->seq);
+    unsigned count = mutex->count;
+    mutex->owner = NULL;
+    if (atomic_exchange_explicit(&mutex->state, 0, memory_order_release) == 2) {
+        futex_wake(&mutex->state, 1);
+    }
+
+    int ret = pthread_futex_wait(&cond->seq, seq, pxTicksToWait);
+
+    // Other tasks woken by a broadcast may be waiting for the mutex, so lock it as contended.
+    TickType_t xTicksToWait = portMAX_DELAY;
+    pthread_mutex_lock_contended(mutex, &xTicksToWait);
+    mutex->owner = self;
+    mutex->count = count;
+    return ret;
+}
+
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime) {
+    TickType_t xTicksToWait;
+    int ret = pthread_timeout(cond->clock, abstime, &xTicksToWait);
+    return ret ? ret : pthread_cond_wait_internal(cond, mutex, &xTicksToWait);
+}
+
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
+    TickType_t xTicksToWait = portMAX_DELAY;
+    return pthread_cond_wait_internal(cond, mutex, &xTicksToWait);
+}
+
+int pthread_condattr_destroy(pthread_condattr_t *attr) {
+    return 0;
+}
+
+int pthread_condattr_getclock(const pthread_condattr_t *attr, clockid_t *clock_id) {
+    *clock_id = attr->clock;
+    return 0;
+}
+
+int pthread_condattr_init(pthread_condattr_t *attr) {
+    attr->clock = CLOCK_REALTIME;
+    return 0;
+}
+
+int pthread_condattr_setclock(pthread_condattr_t *attr, clockid_t clock_id) {
+    if ((clock_id != CLOCK_REALTIME) && (clock_id != CLOCK_MONOTONIC)) {
+        return EINVAL;
+    }
+    attr->clock = clock_id;
+    return 0;
+}
+
+
+// Read-write locks
+#define RWLOCK_WRITER 0x80000000u
+#define RWLOCK_WAITERS 0x40000000u
+#define RWLOCK_READERS 0x3fffffffu
+
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock) {
+    return atomic_load_explicit(&rwlock->state, memory_order_relaxed) ? EBUSY : 0;
+}
+
+int pthread_rwlock_init(pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr) {
+    atomic_init(&rwlock->state, 0);
+    return 0;
+}
+
+static int pthread_rwlock_rdlock_internal(pthread_rwlock_t *rwlock, TickType_t *pxTicksToWait) {
+    uint s = atomic_load_explicit(&rwlock->state, memory_order_relaxed);
+    for (;;) {
+        if (!(s & RWLOCK_WRITER)) {
+            if ((s & RWLOCK_READERS) == RWLOCK_READERS) {
+                return EAGAIN;
+            }
+            if (atomic_compare_exchange_weak_explicit(&rwlock->state, &s, s + 1, memory_order_acquire, memory_order_relaxed)) {
+                return 0;
+            }
+            continue;
+        }
+        if (!pxTicksToWait) {
+            return EBUSY;
+        }
+        if (!(s & RWLOCK_WAITERS) && !atomic_compare_exchange_weak_explicit(&rwlock->state, &s, s | RWLOCK_WAITERS, memory_order_relaxed, memory_order_relaxed)) {
+            continue;
+        }
+        if (pthread_futex_wait(&rwlock->state, s | RWLOCK_WAITERS, pxTicksToWait)) {
+            return ETIMEDOUT;
+        }
+        s = atomic_load_explicit(&rwlock->state, memory_order_relaxed);
+    }
+}
+
+static int pthread_rwlock_wrlock_internal(pthread_rwlock_t *rwlock, TickType_t *pxTicksToWait) {
+    uint s = atomic_load_explicit(&rwlock->state, memory_order_relaxed);
+    for (;;) {
+        if (!(s & ~RWLOCK_WAITERS)) {
+            if (atomic_compare_exchange_weak_explicit(&rwlock->state, &s, s | RWLOCK_WRITER, memory_order_acquire, memory_order_relaxed)) {
+                return 0;
+            }
+            continue;
+        }
+        if (!pxTicksToWait) {
+            return EBUSY;
+        }
+        if (!(s & RWLOCK_WAITERS) && !atomic_compare_exchange_weak_explicit(&rwlock->state, &s, s | RWLOCK_WAITERS, memory_order_relaxed, memory_order_relaxed)) {
+            continue;
+        }
+        if (pthread_futex_wait(&rwlock->state, s | RWLOCK_WAITERS, pxTicksToWait)) {
+            return ETIMEDOUT;
+        }
+        s = atomic_load_explicit(&rwlock->state, memory_order_relaxed);
+    }
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock) {
+    TickType_t xTicksToWait = portMAX_DELAY;
+    return pthread_rwlock_rdlock_internal(rwlock, &xTicksToWait);
+}
+
+int pthread_rwlock_timedrdlock(pthread_rwlock_t *rwlock, const struct timespec *abstime) {
+    TickType_t xTicksToWait;
+    int ret = pthread_rwlock_rdlock_internal(rwlock, NULL);
+    if (ret != EBUSY) {
+        return ret;
+    }
+    ret = pthread_timeout(CLOCK_REALTIME, abstime, &xTicksToWait);
+    return ret ? ret : pthread_rwlock_rdlock_internal(rwlock, &xTicksToWait);
+}
+
+int pthread_rwlock_timedwrlock(pthread_rwlock_t *rwlock, const struct timespec *abstime) {
+    TickType_t xTicksToWait;
+    int ret = pthread_rwlock_wrlock_internal(rwlock, NULL);
+    if (ret != EBUSY) {
+        return ret;
+    }
+    ret = pthread_timeout(CLOCK_REALTIME, abstime, &xTicksToWait);
+    return ret ? ret : pthread_rwlock_wrlock_internal(rwlock, &xTicksToWait);
+}
+
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock) {
+    return pthread_rwlock_rdlock_internal(rwlock, NULL);
+}
+
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock) {
+    return pthread_rwlock_wrlock_internal(rwlock, NULL);
+}
+
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock) {
+    uint s = atomic_load_explicit(&rwlock->state, memory_order_relaxed);
+    uint new_s;
+    do {
+        if ((s & RWLOCK_WRITER) || ((s & RWLOCK_READERS) == 1)) {
+            new_s = 0;
+        } else if (s & RWLOCK_READERS) {
+            new_s = s - 1;
+        } else {
+            return EPERM;
+        }
+    }
+    while (!atomic_compare_exchange_weak_explicit(&rwlock->state, &s, new_s, memory_order_release, memory_order_relaxed));
+
+    // Wake all waiters when the lock becomes free. Those that cannot get the lock set the waiters flag again.
+    if ((s & RWLOCK_WAITERS) && !new_s) {
+        futex_wake(&rwlock->state, INT_MAX);
+    }
+    return 0;
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock) {
+    TickType_t xTicksToWait = portMAX_DELAY;
+    return pthread_rwlock_wrlock_internal(rwlock, &xTicksToWait);
+}
+
+int pthread_rwlockattr_destroy(pthread_rwlockattr_t *attr) {
+    return 0;
+}
+
+int pthread_rwlockattr_init(pthread_rwlockattr_t *attr) {
+    attr->pshared = PTHREAD_PROCESS_PRIVATE;
+    return 0;
+}
+
+
+// Barriers
+int pthread_barrier_destroy(pthread_barrier_t *barrier) {
+    return atomic_load_explicit(&barrier->arrived, memory_order_relaxed) ? EBUSY : 0;
+}
+
+int pthread_barrier_init(pthread_barrier_t *barrier, const pthread_barrierattr_t *attr, unsigned count) {
+    if (!count) {
+        return EINVAL;
+    }
+    atomic_init(&barrier->seq, 0);
+    atomic_init(&barrier->arrived, 0);
+    barrier->count = count;
+    return 0;
+}
+
+int pthread_barrier_wait(pthread_barrier_t *barrier) {
+    uint seq = atomic_load(&barrier->seq);
+    if (atomic_fetch_add(&barrier->arrived, 1) + 1 == barrier->count) {
+        atomic_store(&barrier->arrived, 0);
+        atomic_fetch_add(&barrier->seq, 1);
+        futex_wake(&barrier->seq, INT_MAX);
+        return PTHREAD_BARRIER_SERIAL_THREAD;
+    }
+    while (atomic_load(&barrier->seq) == seq) {
+        TickType_t xTicksToWait = portMAX_DELAY;
+        pthread_futex_wait(&barrier->seq, seq, &xTicksToWait);
+    }
+    return 0;
+}
+
+int pthread_barrierattr_destroy(pthread_barrierattr_t *attr) {
+    return 0;
+}
+
+int pthread_barrierattr_init(pthread_barrierattr_t *attr) {
+    attr->pshared = PTHREAD_PROCESS_PRIVATE;
+    return 0;
+}
+
+
+// Dynamic package initialization
+#define ONCE_RUNNING 1
+#define ONCE_DONE 2
+
+int pthread_once(pthread_once_t *once_control, void (*init_routine)(void)) {
+    uint s = 0;
+    if (atomic_compare_exchange_strong_explicit(&once_control->state, &s, ONCE_RUNNING, memory_order_acquire, memory_order_acquire)) {
+        init_routine();
+        atomic_store_explicit(&once_control->state, ONCE_DONE, memory_order_release);
+        futex_wake(&once_control->state, INT_MAX);
+        return 0;
+    }
+    while (s != ONCE_DONE) {
+        TickType_t xTicksToWait = portMAX_DELAY;
+        pthread_futex_wait(&once_control->state, ONCE_RUNNING, &xTicksToWait);
+        s = atomic_load_explicit(&once_control->state, memory_order_acquire);
+    }
+    return 0;
+}
+
+
+// Thread-specific data
+// Keys are protected by critical section. Values are stored in an array in each task's TLS, allocated on first use.
+// Each value is tagged with the generation of its key when it was set. Deleting a key starts a new
+// generation, so a key created later in the same slot reads as NULL in every thread.
+struct pthread_value {
+    void *value;
+    uint generation;
+};
+
+static void (*pthread_key_destructors[PTHREAD_KEYS_MAX])(void *);
+static uint pthread_key_generations[PTHREAD_KEYS_MAX];
+static uint pthread_keys_used;
+
+static_assert(PTHREAD_KEYS_MAX <= sizeof(pthread_keys_used) * 8);
+
+static bool pthread_key_valid(pthread_key_t key) {
+    return (key < PTHREAD_KEYS_MAX) && (pthread_keys_used & (1u << key));
+}
+
+static void pthread_key_run_destructors(void) {
+    struct pthread_value *values = pvTaskGetThreadLocalStoragePointer(NULL, TLS_INDEX_PTHREAD);
+    if (!values) {
+        return;
+    }
+    bool called = true;
+    for (int i = 0; called && (i < PTHREAD_DESTRUCTOR_ITERATIONS); i++) {
+        called = false;
+        for (pthread_key_t key = 0; key < PTHREAD_KEYS_MAX; key++) {
+            taskENTER_CRITICAL();
+            void (*destructor)(void *) = pthread_key_valid(key) ? pthread_key_destructors[key] : NULL;
+            uint generation = pthread_key_generations[key];
+            taskEXIT_CRITICAL();
+            void *value = values[key].value;
+            if (value && destructor && (values[key].generation == generation)) {
+                values[key].value = NULL;
+                destructor(value);
+                called = true;
+            }
+        }
+    }
+    vTaskSetThreadLocalStoragePointer(NULL, TLS_INDEX_PTHREAD, NULL);
+    free(values);
+}
+
+void *pthread_getspecific(pthread_key_t key) {
+    struct pthread_value *values = pvTaskGetThreadLocalStoragePointer(NULL, TLS_INDEX_PTHREAD);
+    if (!values || (key >= PTHREAD_KEYS_MAX)) {
+        return NULL;
+    }
+    // Using a key while another thread deletes it is undefined, so the generation is read without
+    // the critical section.
+    return (values[key].generation == pthread_key_generations[key]) ? values[key].value : NULL;
+}
+
+int pthread_key_create(pthread_key_t *key, void (*destructor)(void *)) {
+    int ret = EAGAIN;
+    taskENTER_CRITICAL();
+    for (pthread_key_t i = 0; i < PTHREAD_KEYS_MAX; i++) {
+        if (!(pthread_keys_used & (1u << i))) {
+            pthread_keys_used |= 1u << i;
+            pthread_key_destructors[i] = destructor;
+            *key = i;
+            ret = 0;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+    return ret;
+}
+
+int pthread_key_delete(pthread_key_t key) {
+    int ret = EINVAL;
+    taskENTER_CRITICAL();
+    if (pthread_key_valid(key)) {
+        pthread_keys_used &= ~(1u << key);
+        pthread_key_destructors[key] = NULL;
+        pthread_key_generations[key]++;
+        ret = 0;
+    }
+    taskEXIT_CRITICAL();
+    return ret;
+}
+
+int pthread_setspecific(pthread_key_t key, const void *value) {
+    taskENTER_CRITICAL();
+    bool valid = pthread_key_valid(key);
+    uint generation = valid ? pthread_key_generations[key] : 0;
+    taskEXIT_CRITICAL();
+    if (!valid) {
+        return EINVAL;
+    }
+    struct pthread_value *values = pvTaskGetThreadLocalStoragePointer(NULL, TLS_INDEX_PTHREAD);
+    if (!values) {
+        values = calloc(PTHREAD_KEYS_MAX, sizeof(struct pthread_value));
+        if (!values) {
+            return ENOMEM;
+        }
+        vTaskSetThreadLocalStoragePointer(NULL, TLS_INDEX_PTHREAD, values);
+    }
+    values[key].value = (void *)value;
+    values[key].generation = generation;
+    return 0;
+}
@@ -23,33 +23,51 @@ void ring_free(ring_t *ring) {
     }
 }
 
+static void ring_copy_in(const struct ring_segment segs[2], const void *buffer) {
+    memcpy(segs[0].ptr, buffer, segs[0].size);
+    memcpy(segs[1].ptr, buffer + segs[0].size, segs[1].size);
+}
+
+static void ring_copy_out(const struct ring_segment segs[2], void *buffer) {
+    memcpy(buffer, segs[0].ptr, segs[0].size);
+    memcpy(buffer + segs[0].size, segs[1].ptr, segs[1].size);
+}
+
 size_t ring_write(ring_t *ring, const void *buffer, size_t buffer_size) {
-    size_t max_index = ring->read_index + ring->size;
-    size_t write_count = 0;
-    while ((ring->write_index < max_index) && (write_count < buffer_size)) {
-        size_t size;
-        void *write_ptr = ring_at(ring, ring->write_index, &size);
-        size = MIN(size, max_index - ring->write_index);
-        size = MIN(size, buffer_size - write_count);
-        memcpy(write_ptr, buffer + write_count, size);
-        ring->write_index += size;
-        write_count += size;
-    }
+    struct ring_segment segs[2];
+    size_t write_count = ring_segments(ring, ring->write_index, MIN(ring_write_count(ring), buffer_size), segs);
+    ring_copy_in(segs, buffer);
+    ring_commit(ring, write_count);
     return write_count;
 }
 
 size_t ring_read(ring_t *ring, void *buffer, size_t buffer_size) {
-    size_t max_index = ring->write_index;
-    size_t read_count = 0;
-    while ((ring->read_index < max_index) && (read_count < buffer_size)) {
-        size_t size;
-        const void *read_ptr = ring_at(ring, ring->read_index, &size);
-        size = MIN(size, max_index - ring->read_index);
-        size = MIN(size, buffer_size - read_count);
-        memcpy(buffer + read_count, read_ptr, size);
-        ring->read_index += size;
-        read_count += size;
-    }
+    struct ring_segment segs[2];
+    size_t read_count = ring_segments(ring, ring->read_index, MIN(ring_read_count(ring), buffer_size), segs);
+    ring_copy_out(segs, buffer);
+    ring_consume(ring, read_count);
+    return read_count;
+}
+
+size_t ring_spsc_write(ring_t *ring, const void *buffer, size_t buffer_size) {
+    // The acquire load of read_index orders the copy after the consumer has finished reading the space.
+    // The count is loaded once, since MIN would evaluate it again after the consumer may have freed
+    // more space than buffer_size.
+    size_t free_count = ring_spsc_write_count(ring);
+    struct ring_segment segs[2];
+    size_t write_count = ring_segments(ring, ring->write_index, MIN(free_count, buffer_size), segs);
+    ring_copy_in(segs, buffer);
+    // The release store publishes the copied data before the new index.
+    ring_spsc_commit(ring, write_count);
+    return write_count;
+}
+
+size_t ring_spsc_read(ring_t *ring, void *buffer, size_t buffer_size) {
+    size_t used_count = ring_spsc_read_count(ring);
+    struct ring_segment segs[2];
+    size_t read_count = ring_segments(ring, ring->read_index, MIN(used_count, buffer_size), segs);
+    ring_copy_out(segs, buffer);
+    ring_spsc_consume(ring, read_count);
     return read_count;
 }
 
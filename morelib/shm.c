@@ -0,0 +1,260 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include "morelib/mem_tier.h"
+#include "morelib/shm.h"
+#include "morelib/vfs.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+
+struct shm_object {
+    struct shm_object *next;            // list of named objects
+    char *name;                         // NULL once unlinked
+    int ref_count;                      // open files, plus one while named
+    void *data;
+    size_t size;
+    int num_mappings;                   // while mapped, data must not move
+};
+
+struct shm_file {
+    struct vfs_file base;
+    struct shm_object *object;
+};
+
+// All shared memory state is protected by one mutex, since opening and unlinking touch the name list.
+static SemaphoreHandle_t shm_mutex;
+static struct shm_object *shm_objects;
+
+__attribute__((constructor, visibility("hidden")))
+void shm_init(void) {
+    static StaticSemaphore_t xMutexBuffer;
+    shm_mutex = xSemaphoreCreateMutexStatic(&xMutexBuffer);
+}
+
+static void shm_lock(void) {
+    xSemaphoreTake(shm_mutex, portMAX_DELAY);
+}
+
+static void shm_unlock(void) {
+    xSemaphoreGive(shm_mutex);
+}
+
+__attribute__((weak))
+void *shm_storage_alloc(size_t size) {
+    return mem_tier_malloc(size, MEM_AUTO);
+}
+
+__attribute__((weak))
+void shm_storage_free(void *ptr) {
+    mem_tier_free(ptr);
+}
+
+static struct shm_object *shm_find(const char *name) {
+    for (struct shm_object *object = shm_objects; object; object = object->next) {
+        if (strcmp(object->name, name) == 0) {
+            return object;
+        }
+    }
+    return NULL;
+}
+
+// Drops a reference to an object. Must be called with the shm mutex held. Returns true if the object should be freed.
+static bool shm_object_release(struct shm_object *object) {
+    return --object->ref_count == 0;
+}
+
+static void shm_object_free(struct shm_object *object) {
+    shm_storage_free(object->data);
+    free(object);
+}
+
+// Resizes an object. Must be called with the shm mutex held.
+static int shm_object_resize(struct shm_object *object, size_t size) {
+    if (size == object->size) {
+        return 0;
+    }
+    if (object->num_mappings) {
+        errno = EBUSY;
+        return -1;
+    }
+    void *data = NULL;
+    if (size) {
+        data = shm_storage_alloc(size);
+        if (!data) {
+            errno = ENOMEM;
+            return -1;
+        }
+        size_t keep = MIN(size, object->size);
+        if (keep) {
+            memcpy(data, object->data, keep);
+        }
+        memset(data + keep, 0, size - keep);
+    }
+    shm_storage_free(object->data);
+    object->data = data;
+    object->size = size;
+    return 0;
+}
+
+static int shm_close(void *ctx) {
+    struct shm_file *file = ctx;
+    shm_lock();
+    bool unused = shm_object_release(file->object);
+    shm_unlock();
+    if (unused) {
+        shm_object_free(file->object);
+    }
+    free(file);
+    return 0;
+}
+
+static int shm_fstat(void *ctx, struct stat *pstat) {
+    struct shm_file *file = ctx;
+    shm_lock();
+    pstat->st_mode = S_IFREG;
+    pstat->st_size = file->object->size;
+    shm_unlock();
+    return 0;
+}
+
+static int shm_ftruncate(void *ctx, off_t length) {
+    struct shm_file *file = ctx;
+    shm_lock();
+    int ret = shm_object_resize(file->object, length);
+    shm_unlock();
+    return ret;
+}
+
+static void *shm_mmap(void *ctx, void *addr, size_t len, int prot, int flags, off_t off) {
+    struct shm_file *file = ctx;
+    if (!(flags & MAP_SHARED)) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+    void *ret = NULL;
+    shm_lock();
+    struct shm_object *object = file->object;
+    if ((off >= object->size) || (len > object->size - off)) {
+        errno = ENXIO;
+    } else if ((flags & MAP_FIXED) && (addr != object->data + off)) {
+        errno = EINVAL;
+    } else {
+        object->num_mappings++;
+        ret = object->data + off;
+    }
+    shm_unlock();
+    return ret;
+}
+
+static int shm_munmap(void *ctx, void *addr, size_t len) {
+    struct shm_file *file = ctx;
+    shm_lock();
+    file->object->num_mappings--;
+    shm_unlock();
+    return 0;
+}
+
+static const struct vfs_file_vtable shm_vtable = {
+    .close = shm_close,
+    .fstat = shm_fstat,
+    .ftruncate = shm_ftruncate,
+    .mmap = shm_mmap,
+    .munmap = shm_munmap,
+};
+
+int shm_open(const char *name, int oflag, mode_t mode) {
+    if (name[0] != '/') {
+        errno = EINVAL;
+        return -1;
+    }
+    if (strnlen(name, NAME_MAX + 1) > NAME_MAX) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if ((oflag & O_ACCMODE) == O_WRONLY) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct shm_file *file = calloc(1, sizeof(struct shm_file));
+    if (!file) {
+        return -1;
+    }
+    vfs_file_init(&file->base, &shm_vtable, oflag & (O_ACCMODE | O_CLOEXEC));
+
+    shm_lock();
+    struct shm_object *object = shm_find(name);
+    if (object && ((oflag & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL))) {
+        errno = EEXIST;
+        goto error;
+    }
+    if (!object && !(oflag & O_CREAT)) {
+        errno = ENOENT;
+        goto error;
+    }
+    if (object && (oflag & O_TRUNC) && ((oflag & O_ACCMODE) == O_RDWR) && (shm_object_resize(object, 0) < 0)) {
+        goto error;
+    }
+    if (!object) {
+        object = calloc(1, sizeof(struct shm_object));
+        if (!object) {
+            goto error;
+        }
+        object->name = strdup(name);
+        if (!object->name) {
+            free(object);
+            goto error;
+        }
+        object->ref_count = 1;
+        object->next = shm_objects;
+        shm_objects = object;
+    }
+    object->ref_count++;
+    file->object = object;
+    shm_unlock();
+
+    int ret = vfs_replace(-1, &file->base);
+    vfs_release_file(&file->base);
+    return ret;
+
+error:
+    shm_unlock();
+    free(file);
+    return -1;
+}
+
+int shm_unlink(const char *name) {
+    shm_lock();
+    struct shm_object *object = shm_find(name);
+    bool unused = false;
+    if (object) {
+        struct shm_object **pobject = &shm_objects;
+        while (*pobject != object) {
+            pobject = &(*pobject)->next;
+        }
+        *pobject = object->next;
+        free(object->name);
+        object->name = NULL;
+        unused = shm_object_release(object);
+    }
+    shm_unlock();
+
+    if (!object) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (unused) {
+        shm_object_free(object);
+    }
+    return 0;
+}
@@ -2,18 +2,83 @@
 // SPDX-License-Identifier: MIT
 
 #include <errno.h>
+#include <malloc.h>
 #include <signal.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include "morelib/poll.h"
+#include "morelib/signal.h"
 
 #include "FreeRTOS.h"
+#include "task.h"
 #include "timers.h"
 
 
+struct signalfd_file {
+    struct poll_file base;
+    struct signalfd_file *next;         // protected by critical section
+    sigset_t mask;                      // protected by critical section
+};
+
+struct signal_info {
+    int code;
+    int pid;
+};
+
+// Signal state is protected by critical section since signals can be sent from interrupts.
+static sigset_t signal_blocked;
+static sigset_t signal_pending;
+static struct signal_info signal_infos[NSIG];
+static struct signalfd_file *signal_fds;
+
+static inline sigset_t signal_bit(int sig) {
+    return (sigset_t)1 << sig;
+}
+
+static void signal_update_fds(BaseType_t *pxHigherPriorityTaskWoken) {
+    struct signalfd_file *file = signal_fds;
+    while (file) {
+        if (signal_pending & file->mask) {
+            poll_file_notify_from_isr(&file->base, 0, POLLIN | POLLRDNORM, pxHigherPriorityTaskWoken);
+        } else {
+            poll_file_notify_from_isr(&file->base, POLLIN | POLLRDNORM, 0, pxHigherPriorityTaskWoken);
+        }
+        file = file->next;
+    }
+}
+
+// Marks a blocked signal as pending. Returns false if the signal is not blocked and should be raised instead.
+static bool signal_queue(int sig, int code, int pid, BaseType_t *pxHigherPriorityTaskWoken) {
+    sigset_t bit = signal_bit(sig);
+    if (!(signal_blocked & bit)) {
+        return false;
+    }
+    if (!(signal_pending & bit)) {
+        signal_pending |= bit;
+        signal_infos[sig].code = code;
+        signal_infos[sig].pid = pid;
+        signal_update_fds(pxHigherPriorityTaskWoken);
+    }
+    return true;
+}
+
 int kill(int pid, int sig) {
     if (pid != 0) {
         errno = EINVAL;
         return -1;
     }
-    return raise(sig);
+    if ((uint)sig >= NSIG) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sig == 0) {
+        return 0;
+    }
+    int sender = getpid();
+    taskENTER_CRITICAL();
+    bool queued = signal_queue(sig, SI_USER, sender, NULL);
+    taskEXIT_CRITICAL();
+    return queued ? 0 : raise(sig);
 }
 
 static void pending_kill_from_isr(void *pvParameter1, uint32_t ulParameter2) {
@@ -23,6 +88,14 @@ static void pending_kill_from_isr(void *pvParameter1, uint32_t ulParameter2) {
 }
 
 void kill_from_isr(int pid, int sig, BaseType_t *pxHigherPriorityTaskWoken) {
+    // Blocked signals are queued directly without deferring to the timer task.
+    UBaseType_t uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+    bool queued = (pid == 0) && ((uint)sig < NSIG) && signal_queue(sig, SI_USER, 0, pxHigherPriorityTaskWoken);
+    taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
+    if (queued) {
+        return;
+    }
+
     BaseType_t ret = xTimerPendFunctionCallFromISR(
         pending_kill_from_isr,
         (void *)pid,
@@ -32,3 +105,151 @@ void kill_from_isr(int pid, int sig, BaseType_t *pxHigherPriorityTaskWoken) {
         assert(0);
     }
 }
+
+int sigpending(sigset_t *set) {
+    taskENTER_CRITICAL();
+    *set = signal_pending;
+    taskEXIT_CRITICAL();
+    return 0;
+}
+
+int sigprocmask(int how, const sigset_t *set, sigset_t *oset) {
+    taskENTER_CRITICAL();
+    sigset_t old_blocked = signal_blocked;
+    if (set) {
+        switch (how) {
+            case SIG_BLOCK:
+                signal_blocked |= *set;
+                break;
+            case SIG_UNBLOCK:
+                signal_blocked &= ~*set;
+                break;
+            case SIG_SETMASK:
+                signal_blocked = *set;
+                break;
+            default:
+                taskEXIT_CRITICAL();
+                errno = EINVAL;
+                return -1;
+        }
+    }
+    signal_blocked &= ~(signal_bit(SIGKILL) | signal_bit(SIGSTOP));
+
+    // Deliver any pending signals that are no longer blocked.
+    sigset_t deliver = signal_pending & ~signal_blocked;
+    if (deliver) {
+        signal_pending &= ~deliver;
+        signal_update_fds(NULL);
+    }
+    taskEXIT_CRITICAL();
+
+    if (oset) {
+        *oset = old_blocked;
+    }
+    for (int sig = 1; deliver && (sig < NSIG); sig++) {
+        if (deliver & signal_bit(sig)) {
+            deliver &= ~signal_bit(sig);
+            raise(sig);
+        }
+    }
+    return 0;
+}
+
+
+static const struct vfs_file_vtable signalfd_vtable;
+
+static int signalfd_close(void *ctx) {
+    struct signalfd_file *file = ctx;
+    taskENTER_CRITICAL();
+    struct signalfd_file **pfile = &signal_fds;
+    while (*pfile) {
+        if (*pfile == file) {
+            *pfile = file->next;
+            break;
+        }
+        pfile = &(*pfile)->next;
+    }
+    taskEXIT_CRITICAL();
+    free(file);
+    return 0;
+}
+
+static int signalfd_read(void *ctx, void *buffer, size_t size) {
+    struct signalfd_file *file = ctx;
+    if (size < sizeof(struct signalfd_siginfo)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    TickType_t xTicksToWait = portMAX_DELAY;
+    int ret;
+    do {
+        struct signalfd_siginfo *info = buffer;
+        ret = 0;
+        taskENTER_CRITICAL();
+        sigset_t ready = signal_pending & file->mask;
+        while (ready && (size - ret >= sizeof(struct signalfd_siginfo))) {
+            int sig = __builtin_ctzl(ready);
+            ready &= ~signal_bit(sig);
+            signal_pending &= ~signal_bit(sig);
+            memset(info, 0, sizeof(struct signalfd_siginfo));
+            info->ssi_signo = sig;
+            info->ssi_code = signal_infos[sig].code;
+            info->ssi_pid = signal_infos[sig].pid;
+            info++;
+            ret += sizeof(struct signalfd_siginfo);
+        }
+        if (ret) {
+            signal_update_fds(NULL);
+        } else {
+            errno = EAGAIN;
+            ret = -1;
+        }
+        taskEXIT_CRITICAL();
+    }
+    while (POLL_CHECK(ret, &file->base, POLLIN, &xTicksToWait));
+    return ret;
+}
+
+static const struct vfs_file_vtable signalfd_vtable = {
+    .close = signalfd_close,
+    .pollable = 1,
+    .read = signalfd_read,
+};
+
+int signalfd(int fd, const sigset_t *mask, int flags) {
+    sigset_t new_mask = *mask & ~(signal_bit(SIGKILL) | signal_bit(SIGSTOP));
+    if (fd >= 0) {
+        struct signalfd_file *file = (void *)poll_file_acquire(fd, FREAD);
+        if (!file) {
+            return -1;
+        }
+        if (file->base.base.func != &signalfd_vtable) {
+            poll_file_release(&file->base);
+            errno = EINVAL;
+            return -1;
+        }
+        taskENTER_CRITICAL();
+        file->mask = new_mask;
+        signal_update_fds(NULL);
+        taskEXIT_CRITICAL();
+        poll_file_release(&file->base);
+        return fd;
+    }
+
+    struct signalfd_file *file = calloc(1, sizeof(struct signalfd_file));
+    if (!file) {
+        return -1;
+    }
+    poll_file_init(&file->base, &signalfd_vtable, O_RDONLY | (flags & ~O_ACCMODE), 0);
+    taskENTER_CRITICAL();
+    file->mask = new_mask;
+    file->next = signal_fds;
+    signal_fds = file;
+    signal_update_fds(NULL);
+    taskEXIT_CRITICAL();
+
+    int ret = poll_file_fd(&file->base);
+    poll_file_release(&file->base);
+    return ret;
+}
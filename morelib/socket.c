@@ -5,6 +5,7 @@
 #include <fcntl.h>
 #include <malloc.h>
 #include <string.h>
+#include "morelib/pool.h"
 #include "morelib/socket.h"
 
 
@@ -23,17 +24,30 @@ struct socket *socket_acquire(int fd) {
     return NULL;
 }
 
-void *socket_alloc(size_t size, const struct socket_vtable *vtable, int domain, int type, int protocol) {
-    struct socket *socket = calloc(1, size);
-    if (!socket) {
-        return NULL;
-    }
+static void socket_init(struct socket *socket, const struct socket_vtable *vtable, int domain, int type, int protocol) {
     poll_file_init(&socket->base, &socket_vtable, O_RDWR, 0);
     socket->func = vtable;
     socket->mutex = xSemaphoreCreateMutexStatic(&socket->xMutexBuffer);
     socket->domain = domain;
     socket->type = type;
     socket->protocol = protocol;
+}
+
+void *socket_alloc(size_t size, const struct socket_vtable *vtable, int domain, int type, int protocol) {
+    struct socket *socket = calloc(1, size);
+    if (!socket) {
+        return NULL;
+    }
+    socket_init(socket, vtable, domain, type, protocol);
+    return socket;
+}
+
+void *socket_alloc_pooled(struct pool *pool, const struct socket_vtable *vtable, int domain, int type, int protocol) {
+    struct socket *socket = pool_calloc(pool);
+    if (!socket) {
+        return NULL;
+    }
+    socket_init(socket, vtable, domain, type, protocol);
     return socket;
 }
 
@@ -64,6 +78,10 @@ int socket_getsockopt(struct socket *socket, int level, int option_name, void *o
                 socket_getintopt(option_value, option_len, socket->type);
                 return 0;
             }
+            case SO_BUSY_POLL: {
+                socket_getintopt(option_value, option_len, socket->base.busy_poll);
+                return 0;
+            }
             default: {
                 break;
             }
@@ -97,6 +115,18 @@ int socket_setsockopt(struct socket *socket, int level, int option_name, const v
                 errno = ENOPROTOOPT;
                 return -1;
             }
+            case SO_BUSY_POLL: {
+                int value;
+                if (socket_setintopt(option_value, option_len, &value) < 0) {
+                    return -1;
+                }
+                if (value < 0) {
+                    errno = EINVAL;
+                    return -1;
+                }
+                socket->base.busy_poll = value;
+                return 0;
+            }
             default: {
                 break;
             }
@@ -110,6 +140,46 @@ int socket_setsockopt(struct socket *socket, int level, int option_name, const v
     return socket->func->setsockopt(socket, level, option_name, option_value, option_len);
 }
 
+int socket_recvmsg(struct socket *socket, struct msghdr *message, int flags) {
+    if (socket->func->recvmsg) {
+        return socket->func->recvmsg(socket, message, flags);
+    }
+    // Without native support, only a single buffer and no ancillary data can be received.
+    if (message->msg_iovlen > 1) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    void *buf = message->msg_iovlen ? message->msg_iov[0].iov_base : NULL;
+    size_t len = message->msg_iovlen ? message->msg_iov[0].iov_len : 0;
+    int ret = socket_recvfrom(socket, buf, len, flags, message->msg_name, &message->msg_namelen);
+    message->msg_controllen = 0;
+    message->msg_flags = 0;
+    return ret;
+}
+
+int socket_sendmsg(struct socket *socket, const struct msghdr *message, int flags) {
+    if (socket->func->sendmsg) {
+        return socket->func->sendmsg(socket, message, flags);
+    }
+    if ((message->msg_iovlen > 1) || message->msg_controllen) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    const void *buf = message->msg_iovlen ? message->msg_iov[0].iov_base : NULL;
+    size_t len = message->msg_iovlen ? message->msg_iov[0].iov_len : 0;
+    return socket_sendto(socket, buf, len, flags, message->msg_name, message->msg_namelen);
+}
+
+static const struct socket_family *socket_family(int domain) {
+    for (size_t i = 0; i < socket_num_families; i++) {
+        if (socket_families[i]->family == domain) {
+            return socket_families[i];
+        }
+    }
+    errno = EAFNOSUPPORT;
+    return NULL;
+}
+
 // ### socket API
 int accept(int fd, struct sockaddr *address, socklen_t *address_len) {
     struct socket *socket = socket_acquire(fd);
@@ -212,6 +282,26 @@ ssize_t recv(int fd, void *buffer, size_t length, int flags) {
     return recvfrom(fd, buffer, length, flags, NULL, NULL);
 }
 
+ssize_t recvmsg(int fd, struct msghdr *message, int flags) {
+    struct socket *socket = socket_acquire(fd);
+    if (!socket) {
+        return -1;
+    }
+    int ret = socket_recvmsg(socket, message, flags);
+    socket_release(socket);
+    return ret;
+}
+
+ssize_t sendmsg(int fd, const struct msghdr *message, int flags) {
+    struct socket *socket = socket_acquire(fd);
+    if (!socket) {
+        return -1;
+    }
+    int ret = socket_sendmsg(socket, message, flags);
+    socket_release(socket);
+    return ret;
+}
+
 ssize_t sendto(int fd, const void *message, size_t length, int flags, const struct sockaddr *dest_addr, socklen_t dest_len) {
     struct socket *socket = socket_acquire(fd);
     if (!socket) {
@@ -247,15 +337,8 @@ int shutdown(int fd, int how) {
 }
 
 int socket(int domain, int type, int protocol) {
-    const struct socket_family *family = NULL;
-    for (size_t i = 0; i < socket_num_families; i++) {
-        if (socket_families[i]->family == domain) {
-            family = socket_families[i];
-            break;
-        }
-    }
+    const struct socket_family *family = socket_family(domain);
     if (!family) {
-        errno = EAFNOSUPPORT;
         return -1;
     }
 
@@ -268,10 +351,16 @@ int socket(int domain, int type, int protocol) {
     return ret;
 }
 
-__attribute__((weak))
 int socketpair(int domain, int type, int protocol, int socket_vector[2]) {
-    errno = EOPNOTSUPP;
-    return -1;
+    const struct socket_family *family = socket_family(domain);
+    if (!family) {
+        return -1;
+    }
+    if (!family->socketpair) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    return family->socketpair(domain, type, protocol, socket_vector);
 }
 
 static int socket_close(void *ctx) {
@@ -281,7 +370,7 @@ static int socket_close(void *ctx) {
         ret = socket->func->close(socket);
     }
     vSemaphoreDelete(socket->mutex);
-    free(socket);
+    pool_free(socket);
     return ret;
 }
 
@@ -3,14 +3,21 @@
 
 #include <errno.h>
 #include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/trace.h"
 #include "morelib/thread.h"
 
 
-// Global mutex for thread operations
+// Global mutex for thread operations, except interrupt state which is atomic
 static SemaphoreHandle_t thread_mutex;
 
 static thread_t *thread_list;
 
+// Live threads hashed by ID
+static thread_t *thread_buckets[THREAD_NUM_BUCKETS];
+
 __attribute__((constructor, visibility("hidden")))
 void thread_init(void) {
     static StaticSemaphore_t buffer;
@@ -51,12 +58,16 @@ static thread_t *thread_alloc(TaskFunction_t pxTaskCode, void *pvParameters) {
     thread_t *thread = malloc(sizeof(thread_t));
     if (thread) {
         thread->next = NULL;
+        thread->pprev = NULL;
+        thread->bucket_next = NULL;
         thread->ref_count = 1;
         thread->handle = NULL;
         thread->id = -1;
-        thread->state = 0;
+        atomic_init(&thread->state, 0);
+        thread->stack_depth = 0;
         thread->entry = pxTaskCode;
         thread->param = pvParameters;
+        thread->result = NULL;
         thread->joiner = NULL;
     }
     return thread;
@@ -75,32 +86,108 @@ static void thread_initialize(thread_t *thread, TaskHandle_t handle) {
 
     // Insert new thread in list of all threads
     thread->next = thread_list;
+    thread->pprev = &thread_list;
+    if (thread_list) {
+        thread_list->pprev = &thread->next;
+    }
     thread->ref_count++;
     thread_list = thread;
+
+    thread_t **pbucket = &thread_buckets[thread->id % THREAD_NUM_BUCKETS];
+    thread->bucket_next = *pbucket;
+    *pbucket = thread;
+}
+
+// Stack profiling
+static configSTACK_DEPTH_TYPE thread_stack_peak(thread_t *thread) {
+    return thread->stack_depth - uxTaskGetStackHighWaterMark(thread->handle);
+}
+
+// Returns the peak usage for name from a STACK_SIZES list, or 0 if name is not listed. The list
+// holds names as FreeRTOS stores them, truncated to configMAX_TASK_NAME_LEN - 1 characters, so
+// name is truncated the same way.
+static configSTACK_DEPTH_TYPE thread_stack_lookup(const char *sizes, const char *name) {
+    size_t len = strnlen(name, configMAX_TASK_NAME_LEN - 1);
+    while (sizes && *sizes) {
+        if ((strncmp(sizes, name, len) == 0) && (sizes[len] == ':')) {
+            return strtoul(sizes + len + 1, NULL, 10);
+        }
+        sizes = strchr(sizes, ' ');
+        if (sizes) {
+            sizes++;
+        }
+    }
+    return 0;
+}
+
+// Returns true if a name identifies the code a thread runs, and can be stored in STACK_SIZES.
+static bool thread_stack_learnable(const char *name) {
+    return name && *name && !strpbrk(name, " :") && strcmp(name, THREAD_NAME_PTHREAD) && strcmp(name, THREAD_NAME_POOL);
+}
+
+static configSTACK_DEPTH_TYPE thread_stack_depth(const char *name, configSTACK_DEPTH_TYPE usStackDepth) {
+    configSTACK_DEPTH_TYPE depth = MAX(configMINIMAL_STACK_SIZE, usStackDepth);
+    configSTACK_DEPTH_TYPE peak = thread_stack_learnable(name) ? thread_stack_lookup(getenv("STACK_SIZES"), name) : 0;
+    return peak ? MAX(depth, peak + THREAD_STACK_MARGIN) : depth;
 }
 
+#if THREAD_STACK_LEARN
+struct thread_stack_entry {
+    char name[configMAX_TASK_NAME_LEN];
+    configSTACK_DEPTH_TYPE peak;
+};
+
+// Peak usage by thread name, protected by thread mutex
+static struct thread_stack_entry thread_stack_entries[THREAD_STACK_MAX_ENTRIES];
+
+static void thread_stack_record(const char *name, configSTACK_DEPTH_TYPE peak) {
+    assert(thread_check_locked());
+    if (!thread_stack_learnable(name)) {
+        return;
+    }
+    struct thread_stack_entry *free_entry = NULL;
+    for (int i = 0; i < THREAD_STACK_MAX_ENTRIES; i++) {
+        struct thread_stack_entry *entry = &thread_stack_entries[i];
+        if (strncmp(entry->name, name, configMAX_TASK_NAME_LEN - 1) == 0) {
+            entry->peak = MAX(entry->peak, peak);
+            return;
+        }
+        if (!free_entry && !entry->name[0]) {
+            free_entry = entry;
+        }
+    }
+    if (free_entry) {
+        strncpy(free_entry->name, name, configMAX_TASK_NAME_LEN - 1);
+        free_entry->peak = peak;
+    }
+}
+#endif
+
 // __attribute__((noreturn))
 void thread_exit(void) {
     thread_t *thread = thread_current();
 
     // Remove thread from thread list
     thread_lock();
+    #if THREAD_STACK_LEARN
+    thread_stack_record(pcTaskGetName(NULL), thread_stack_peak(thread));
+    #endif
     thread->handle = NULL;
-    thread_t **pthread = &thread_list;
-    while (*pthread) {
-        if (*pthread == thread) {
-            --thread->ref_count;
-            // The thread->next pointer is kept intact so that an iterator currently on this thread
-            // can still advance to other threads. Consequently another ref count needs to be added 
-            // to the next thread in the list.
-            if (thread->next) {
-                thread->next->ref_count++;
-            }
-            *pthread = thread->next;
-            break;
-        }
-        pthread = &(*pthread)->next;
+    --thread->ref_count;
+    // The thread->next pointer is kept intact so that an iterator currently on this thread
+    // can still advance to other threads. Consequently another ref count needs to be added 
+    // to the next thread in the list.
+    if (thread->next) {
+        thread->next->ref_count++;
+        thread->next->pprev = thread->pprev;
+    }
+    *thread->pprev = thread->next;
+
+    thread_t **pbucket = &thread_buckets[thread->id % THREAD_NUM_BUCKETS];
+    while (*pbucket != thread) {
+        pbucket = &(*pbucket)->bucket_next;
     }
+    *pbucket = thread->bucket_next;
 
     if (thread->joiner) {
         xSemaphoreGive(thread->joiner);
@@ -118,9 +205,10 @@ thread_t *thread_create(TaskFunction_t pxTaskCode, const char *pcName, const con
     if (!thread) {
         return NULL;
     }
+    thread->stack_depth = thread_stack_depth(pcName, usStackDepth);
     thread_lock();
     TaskHandle_t handle;
-    if (xTaskCreate(thread_entry, pcName, MAX(configMINIMAL_STACK_SIZE, usStackDepth), thread, uxPriority, &handle) == pdPASS) {
+    if (xTaskCreate(thread_entry, pcName, thread->stack_depth, thread, uxPriority, &handle) == pdPASS) {
         thread_initialize(thread, handle);
         thread_unlock();
     } else {
@@ -136,8 +224,10 @@ thread_t *thread_createStatic(TaskFunction_t pxTaskCode, const char *pcName, con
     if (!thread) {
         return NULL;
     }
+    // The stack buffer has a fixed size, so learned stack sizes do not apply.
+    thread->stack_depth = MAX(configMINIMAL_STACK_SIZE, usStackDepth);
     thread_lock();
-    TaskHandle_t handle = xTaskCreateStatic(thread_entry, pcName, MAX(configMINIMAL_STACK_SIZE, usStackDepth), thread, uxPriority, puxStackBuffer, pxTaskBuffer);
+    TaskHandle_t handle = xTaskCreateStatic(thread_entry, pcName, thread->stack_depth, thread, uxPriority, puxStackBuffer, pxTaskBuffer);
     if (handle) {
         thread_initialize(thread, handle);
         thread_unlock();
@@ -150,21 +240,28 @@ thread_t *thread_createStatic(TaskFunction_t pxTaskCode, const char *pcName, con
 }
 
 
+/* Interrupt state is only changed with atomic operations, so blocking calls do not contend on the
+ * thread mutex. The TASK_INTERRUPT_ABORTING flag is held by an interrupting thread while it aborts
+ * the target's blocking call. The target cannot disable interrupts while the flag is set, so a
+ * late abort never lands on a blocking call made after interrupts are disabled.
+ */
 int thread_enable_interrupt(void) {
     thread_t *thread = thread_current();
     if (!thread) {
         return 0;
     }
-    thread_lock();
-    if (thread->state & TASK_INTERRUPT_SET) {
-        thread->state &= ~TASK_INTERRUPT_SET;
-        thread_unlock();
-        errno = EINTR;
-        return -1;
+    uint state = atomic_load_explicit(&thread->state, memory_order_relaxed);
+    for (;;) {
+        if (state & TASK_INTERRUPT_SET) {
+            if (atomic_compare_exchange_weak(&thread->state, &state, state & ~TASK_INTERRUPT_SET)) {
+                errno = EINTR;
+                return -1;
+            }
+        } else if (atomic_compare_exchange_weak(&thread->state, &state, state | TASK_INTERRUPT_CAN_ABORT)) {
+            TRACE_ENABLE_INTERRUPT();
+            return 0;
+        }
     }
-    thread->state |= TASK_INTERRUPT_CAN_ABORT;
-    thread_unlock();
-    return 0;
 }
 
 void thread_disable_interrupt(void) {
@@ -172,12 +269,17 @@ void thread_disable_interrupt(void) {
     if (!thread) {
         return;
     }
-    // Because thread interrupts are enabled, waiting for the thread mutex may be aborted.
-    // Ignore aborts and keep retrying to acquire mutex.
-    while (!xSemaphoreTake(thread_mutex, portMAX_DELAY)) {
-        ;
+    TRACE_DISABLE_INTERRUPT();
+    uint state = atomic_load_explicit(&thread->state, memory_order_relaxed);
+    for (;;) {
+        if (state & TASK_INTERRUPT_ABORTING) {
+            // Another thread is trying to abort us. Block so that its abort succeeds.
+            vTaskDelay(1);
+            state = atomic_load_explicit(&thread->state, memory_order_relaxed);
+        } else if (atomic_compare_exchange_weak(&thread->state, &state, state & ~TASK_INTERRUPT_CAN_ABORT)) {
+            break;
+        }
     }
-    thread->state &= ~TASK_INTERRUPT_CAN_ABORT;
 
     /* This code sets pxCurrentTCB->ucDelayAborted to pdFALSE. This flag is not useful for us
     because xTaskCheckForTimeOut does not distinguish between timeouts and interruptions. We use
@@ -185,36 +287,41 @@ void thread_disable_interrupt(void) {
     TimeOut_t xTimeOut;
     TickType_t xTicksToWait = portMAX_DELAY;
     xTaskCheckForTimeOut(&xTimeOut, &xTicksToWait);
-    thread_unlock();
 }
 
 void thread_interrupt(thread_t *thread) {
-    thread_lock();
-    thread->state |= TASK_INTERRUPT_SET;
-    if ((thread->state & TASK_INTERRUPT_CAN_ABORT) && thread->handle) {
+    uint state = atomic_load_explicit(&thread->state, memory_order_relaxed);
+    uint new_state;
+    do {
+        new_state = state | TASK_INTERRUPT_SET;
+        if ((state & (TASK_INTERRUPT_CAN_ABORT | TASK_INTERRUPT_ABORTING)) == TASK_INTERRUPT_CAN_ABORT) {
+            new_state |= TASK_INTERRUPT_ABORTING;
+        }
+    }
+    while (!atomic_compare_exchange_weak(&thread->state, &state, new_state));
+
+    if (!(state & TASK_INTERRUPT_ABORTING) && (new_state & TASK_INTERRUPT_ABORTING)) {
+        // The target thread cannot exit while interrupts are enabled, so its handle is valid.
         while (xTaskAbortDelay(thread->handle) == pdFAIL) {
             // If xTaskAbortDelay fails, it means the target thread is in between calling thread_enable_interrupt and starting its blocking call.
             // Wait a minimal amount of time for the target thread to start blocking so that xTaskAbortDelay succeeds.
-            // The target thread cannot disable thread interrupts because we hold the thread lock, so the target thread will eventually block trying to acquire the thread lock.
+            // The target thread cannot disable thread interrupts while the aborting flag is set, so it will eventually block.
             vTaskDelay(1);
         }
+        atomic_fetch_and(&thread->state, ~TASK_INTERRUPT_ABORTING);
     }
-    thread_unlock();
 }
 
 int thread_check_interrupted(void) {
     thread_t *thread = thread_current();
     if (!thread) {
         return 0;
-    }    
-    thread_lock();
-    if (thread->state & TASK_INTERRUPT_SET) {
-        thread->state &= ~TASK_INTERRUPT_SET;
-        thread_unlock();
+    }
+    if (atomic_load_explicit(&thread->state, memory_order_relaxed) & TASK_INTERRUPT_SET) {
+        atomic_fetch_and(&thread->state, ~TASK_INTERRUPT_SET);
         errno = EINTR;
         return -1;
     }
-    thread_unlock();
     return 0;
 }
 
@@ -300,17 +407,103 @@ bool thread_iterate(thread_t **pthread) {
 }
 
 thread_t *thread_lookup(UBaseType_t id) {
-    thread_t *ret = NULL;
+    thread_lock();
+    thread_t *thread = thread_buckets[id % THREAD_NUM_BUCKETS];
+    while (thread && (thread->id != id)) {
+        thread = thread->bucket_next;
+    }
+    if (thread) {
+        thread->ref_count++;
+    }
+    thread_unlock();
+    return thread;
+}
+
+int thread_stack_usage(thread_t *thread, configSTACK_DEPTH_TYPE *size, configSTACK_DEPTH_TYPE *peak) {
+    int ret = 0;
+    thread_lock();
+    if (thread->handle) {
+        *size = thread->stack_depth;
+        *peak = thread_stack_peak(thread);
+    } else {
+        errno = ESRCH;
+        ret = -1;
+    }
+    thread_unlock();
+    return ret;
+}
+
+void thread_stack_report(FILE *stream) {
+    fprintf(stream, "%5s %-*s %6s %6s %4s\n", "ID", configMAX_TASK_NAME_LEN, "NAME", "SIZE", "PEAK", "USE%");
     thread_t *thread = NULL;
-    while (thread_iterate(&thread)) {
-        if (thread->id == id) {
-            ret = thread;
+    for (;;) {
+        thread_t *prev = thread;
+        bool more = thread_iterate(&thread);
+        thread_detach(prev);
+        if (!more) {
             break;
         }
-        thread_detach(thread);
+
+        char name[configMAX_TASK_NAME_LEN] = "";
+        configSTACK_DEPTH_TYPE size = 0, peak = 0;
+        thread_lock();
+        if (thread->handle) {
+            strncpy(name, pcTaskGetName(thread->handle), configMAX_TASK_NAME_LEN - 1);
+            size = thread->stack_depth;
+            peak = thread_stack_peak(thread);
+        }
+        thread_unlock();
+        if (size) {
+            fprintf(stream, "%5u %-*s %6lu %6lu %3lu%%\n", (uint)thread->id, configMAX_TASK_NAME_LEN, name, (unsigned long)size, (unsigned long)peak, (unsigned long)(peak * 100 / size));
+        }
+    }
+}
+
+#if THREAD_STACK_LEARN
+int thread_stack_save(void) {
+    thread_lock();
+    // Keep the peaks recorded on previous boots.
+    const char *sizes = getenv("STACK_SIZES");
+    while (sizes && *sizes) {
+        size_t len = strcspn(sizes, ": ");
+        if ((sizes[len] == ':') && (len < configMAX_TASK_NAME_LEN)) {
+            char name[configMAX_TASK_NAME_LEN];
+            memcpy(name, sizes, len);
+            name[len] = '\0';
+            thread_stack_record(name, strtoul(sizes + len + 1, NULL, 10));
+        }
+        sizes = strchr(sizes, ' ');
+        if (sizes) {
+            sizes++;
+        }
     }
+    for (thread_t *thread = thread_list; thread; thread = thread->next) {
+        if (thread->handle) {
+            thread_stack_record(pcTaskGetName(thread->handle), thread_stack_peak(thread));
+        }
+    }
+
+    size_t size = THREAD_STACK_MAX_ENTRIES * (configMAX_TASK_NAME_LEN + 12);
+    char *value = malloc(size);
+    if (!value) {
+        thread_unlock();
+        return -1;
+    }
+    size_t len = 0;
+    value[0] = '\0';
+    for (int i = 0; i < THREAD_STACK_MAX_ENTRIES; i++) {
+        struct thread_stack_entry *entry = &thread_stack_entries[i];
+        if (entry->name[0]) {
+            len += snprintf(value + len, size - len, "%s%s:%lu", len ? " " : "", entry->name, (unsigned long)entry->peak);
+        }
+    }
+    thread_unlock();
+
+    int ret = setenv("STACK_SIZES", value, 1);
+    free(value);
     return ret;
 }
+#endif
 
 TaskHandle_t thread_suspend(thread_t *thread) {
     thread_lock();
@@ -0,0 +1,313 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <string.h>
+#include "morelib/futex.h"
+#include "morelib/threadpool.h"
+
+
+// Deque functions. Must be called in a critical section.
+static void threadpool_push_back(struct threadpool_worker *worker, struct threadpool_job *job) {
+    job->worker = worker;
+    job->next = NULL;
+    job->prev = worker->tail;
+    if (worker->tail) {
+        worker->tail->next = job;
+    } else {
+        worker->head = job;
+    }
+    worker->tail = job;
+}
+
+static void threadpool_unlink(struct threadpool_job *job) {
+    struct threadpool_worker *worker = job->worker;
+    if (job->prev) {
+        job->prev->next = job->next;
+    } else {
+        worker->head = job->next;
+    }
+    if (job->next) {
+        job->next->prev = job->prev;
+    } else {
+        worker->tail = job->prev;
+    }
+    job->worker = NULL;
+}
+
+// Takes the newest job from a worker's own deque, or else steals the oldest job from another worker.
+// Also returns whether the pool was stopped, in which case no more jobs can be submitted.
+static struct threadpool_job *threadpool_take(struct threadpool_worker *worker, bool *stopped) {
+    struct threadpool *pool = worker->pool;
+    struct threadpool_job *job = NULL;
+    taskENTER_CRITICAL();
+    *stopped = pool->stopped;
+    if (worker->tail) {
+        job = worker->tail;
+    } else {
+        uint index = worker - pool->workers;
+        for (uint i = 1; i < pool->num_workers; i++) {
+            struct threadpool_worker *victim = &pool->workers[(index + i) % pool->num_workers];
+            if (victim->head) {
+                job = victim->head;
+                break;
+            }
+        }
+    }
+    if (job) {
+        threadpool_unlink(job);
+        atomic_store_explicit(&job->state, THREADPOOL_JOB_RUNNING, memory_order_relaxed);
+    }
+    taskEXIT_CRITICAL();
+    return job;
+}
+
+static void threadpool_run(struct threadpool_job *job) {
+    job->result = job->func(job->arg);
+
+    // The job may be freed as soon as it is done, so take a reference to its file first.
+    struct poll_file *file = job->file ? poll_file_copy(job->file) : NULL;
+    atomic_store_explicit(&job->state, THREADPOOL_JOB_DONE, memory_order_release);
+    futex_wake(&job->state, INT_MAX);
+    if (file) {
+        poll_file_notify(file, 0, POLLIN);
+        poll_file_release(file);
+    }
+}
+
+static void threadpool_worker_entry(void *pvParameters) {
+    struct threadpool_worker *worker = pvParameters;
+    struct threadpool *pool = worker->pool;
+    for (;;) {
+        // Read the sequence number before looking for jobs, so that a job submitted after the
+        // search makes the wait below return immediately.
+        uint seq = atomic_load(&pool->seq);
+        bool stopped;
+        struct threadpool_job *job = threadpool_take(worker, &stopped);
+        if (job) {
+            threadpool_run(job);
+            continue;
+        }
+        if (stopped) {
+            break;
+        }
+        atomic_fetch_add(&pool->num_idle, 1);
+        TickType_t xTicksToWait = portMAX_DELAY;
+        futex_wait(&pool->seq, seq, &xTicksToWait);
+        atomic_fetch_sub(&pool->num_idle, 1);
+    }
+}
+
+// Returns the worker that is the current task, or NULL if the current task is not a worker of the pool.
+static struct threadpool_worker *threadpool_current_worker(struct threadpool *pool) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (uint i = 0; i < pool->num_workers; i++) {
+        if (pool->workers[i].thread->handle == self) {
+            return &pool->workers[i];
+        }
+    }
+    return NULL;
+}
+
+static void threadpool_stop(struct threadpool *pool, uint num_workers) {
+    taskENTER_CRITICAL();
+    pool->stopped = true;
+    taskEXIT_CRITICAL();
+    atomic_fetch_add(&pool->seq, 1);
+    futex_wake(&pool->seq, INT_MAX);
+
+    for (uint i = 0; i < num_workers; i++) {
+        thread_t *thread = pool->workers[i].thread;
+        while (thread_join(thread, portMAX_DELAY) < 0) {
+            ;
+        }
+        thread_detach(thread);
+    }
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->num_workers = 0;
+}
+
+int threadpool_init(struct threadpool *pool, uint workers_per_core, configSTACK_DEPTH_TYPE usStackDepth, UBaseType_t uxPriority) {
+    if (!workers_per_core) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(pool, 0, sizeof(struct threadpool));
+    pool->num_workers = workers_per_core * configNUMBER_OF_CORES;
+    pool->workers_per_core = workers_per_core;
+    pool->workers = calloc(pool->num_workers, sizeof(struct threadpool_worker));
+    if (!pool->workers) {
+        return -1;
+    }
+
+    for (uint i = 0; i < pool->num_workers; i++) {
+        struct threadpool_worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->thread = thread_create(threadpool_worker_entry, THREAD_NAME_POOL, usStackDepth, worker, uxPriority);
+        if (!worker->thread) {
+            threadpool_stop(pool, i);
+            errno = ENOMEM;
+            return -1;
+        }
+        #if configUSE_CORE_AFFINITY
+        vTaskCoreAffinitySet(worker->thread->handle, 1u << (i / workers_per_core));
+        #endif
+    }
+    return 0;
+}
+
+void threadpool_deinit(struct threadpool *pool) {
+    threadpool_stop(pool, pool->num_workers);
+}
+
+void threadpool_job_init(struct threadpool_job *job, void *(*func)(void *arg), void *arg) {
+    memset(job, 0, sizeof(struct threadpool_job));
+    job->func = func;
+    job->arg = arg;
+    atomic_init(&job->state, THREADPOOL_JOB_IDLE);
+}
+
+void threadpool_job_deinit(struct threadpool_job *job) {
+    if (job->file) {
+        poll_file_release(job->file);
+        job->file = NULL;
+    }
+}
+
+static int threadpool_file_read(void *ctx, void *buffer, size_t size) {
+    struct poll_file *file = ctx;
+    if (size < sizeof(uint64_t)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    TickType_t xTicksToWait = portMAX_DELAY;
+    int ret;
+    do {
+        if (poll_file_poll(file) & POLLIN) {
+            uint64_t value = 1;
+            memcpy(buffer, &value, sizeof(uint64_t));
+            ret = sizeof(uint64_t);
+        } else {
+            errno = EAGAIN;
+            ret = -1;
+        }
+    }
+    while (POLL_CHECK(ret, file, POLLIN, &xTicksToWait));
+    return ret;
+}
+
+static const struct vfs_file_vtable threadpool_file_vtable = {
+    .pollable = 1,
+    .read = threadpool_file_read,
+};
+
+int threadpool_job_fd(struct threadpool_job *job) {
+    uint state = atomic_load(&job->state);
+    if ((state == THREADPOOL_JOB_QUEUED) || (state == THREADPOOL_JOB_RUNNING)) {
+        errno = EBUSY;
+        return -1;
+    }
+    struct poll_file *file = calloc(1, sizeof(struct poll_file));
+    if (!file) {
+        return -1;
+    }
+    poll_file_init(file, &threadpool_file_vtable, O_RDONLY, (state == THREADPOOL_JOB_DONE) ? POLLIN : 0);
+    int fd = poll_file_fd(file);
+    if (fd < 0) {
+        poll_file_release(file);
+        return -1;
+    }
+    threadpool_job_deinit(job);
+    job->file = file;
+    return fd;
+}
+
+int threadpool_submit(struct threadpool *pool, struct threadpool_job *job) {
+    // Use the current worker's own deque, or else a worker on the current core.
+    struct threadpool_worker *worker = threadpool_current_worker(pool);
+
+    int ret = 0;
+    taskENTER_CRITICAL();
+    uint state = atomic_load_explicit(&job->state, memory_order_relaxed);
+    if (pool->stopped) {
+        errno = ESHUTDOWN;
+        ret = -1;
+    } else if ((state == THREADPOOL_JOB_QUEUED) || (state == THREADPOOL_JOB_RUNNING)) {
+        errno = EBUSY;
+        ret = -1;
+    } else {
+        if (!worker) {
+            uint index = portGET_CORE_ID() * pool->workers_per_core + atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed) % pool->workers_per_core;
+            worker = &pool->workers[index];
+        }
+        atomic_store_explicit(&job->state, THREADPOOL_JOB_QUEUED, memory_order_relaxed);
+        job->pool = pool;
+        if (job->file) {
+            poll_file_notify(job->file, POLLIN, 0);
+        }
+        threadpool_push_back(worker, job);
+    }
+    taskEXIT_CRITICAL();
+    if (ret < 0) {
+        return ret;
+    }
+
+    atomic_fetch_add(&pool->seq, 1);
+    if (atomic_load(&pool->num_idle)) {
+        futex_wake(&pool->seq, 1);
+    }
+    return 0;
+}
+
+int threadpool_cancel(struct threadpool_job *job) {
+    int ret = 0;
+    taskENTER_CRITICAL();
+    if (job->worker) {
+        threadpool_unlink(job);
+        atomic_store_explicit(&job->state, THREADPOOL_JOB_IDLE, memory_order_relaxed);
+    } else if (atomic_load_explicit(&job->state, memory_order_relaxed) == THREADPOOL_JOB_RUNNING) {
+        errno = EBUSY;
+        ret = -1;
+    }
+    taskEXIT_CRITICAL();
+    return ret;
+}
+
+int threadpool_job_wait(struct threadpool_job *job, void **result, TickType_t xTicksToWait) {
+    // A worker runs other jobs while it waits, in case the job is queued behind them.
+    struct threadpool_worker *worker = job->pool ? threadpool_current_worker(job->pool) : NULL;
+    uint state;
+    while ((state = atomic_load_explicit(&job->state, memory_order_acquire)) != THREADPOOL_JOB_DONE) {
+        if (state == THREADPOOL_JOB_IDLE) {
+            errno = EINVAL;
+            return -1;
+        }
+        bool stopped;
+        struct threadpool_job *other = worker ? threadpool_take(worker, &stopped) : NULL;
+        if (other) {
+            threadpool_run(other);
+            continue;
+        }
+        if (thread_enable_interrupt()) {
+            return -1;
+        }
+        int ret = futex_wait(&job->state, state, &xTicksToWait);
+        int err = errno;
+        thread_disable_interrupt();
+        if (thread_check_interrupted()) {
+            return -1;
+        }
+        if ((ret < 0) && (err == ETIMEDOUT)) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+    if (result) {
+        *result = job->result;
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Minimal single-task definitions for building mtdblk.c on the host.
+#include <assert.h>
+#include <stdint.h>
+#include <sys/param.h>
+#include <sys/types.h>
+
+typedef unsigned int uint;
+typedef long BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define portMAX_DELAY ((TickType_t)-1)
+
+#ifndef FREAD
+#define FREAD 1
+#define FWRITE 2
+#endif
@@ -0,0 +1,503 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+/* Runs block write workloads on the host against mtdblk on an emulated NOR flash, and compares
+ * erases, sector programs and estimated flash time with a model of the previous direct-mapped
+ * cache, which erased and programmed every cached block it evicted or flushed. After each workload,
+ * the device is opened again and its contents are checked against what was written.
+ *
+ * Build from this directory:
+ *   cc -O2 -I. -I../../include -I../../../freertos/include -o mtdblk_bench mtdblk_bench.c
+ *
+ * Add -DMTDBLK_FTL=1 to format the device for the flash translation layer and run the workloads
+ * on it.
+ *
+ * Usage:
+ *   mtdblk_bench [ENTRIES]          run every workload with ENTRIES cache entries (default 16)
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "morelib/dev.h"
+#include "morelib/mtd.h"
+#include "morelib/vfs.h"
+#include "freertos/mem_pressure.h"
+
+
+// The emulated flash has the geometry of the RP2 QSPI flash. Programming can only clear bits,
+// and erasing sets a block to 0xff.
+#define FLASH_SIZE (1u << 20)
+#define ERASE_SIZE 4096
+#define WRITE_SIZE 256
+#define NUM_BLOCKS (FLASH_SIZE / ERASE_SIZE)
+
+// Typical NOR timings in microseconds
+#define ERASE_US 45000
+#define PROGRAM_US 700
+
+static uint8_t flash[FLASH_SIZE];
+static uint8_t expected[FLASH_SIZE];            // what the flash must hold after a sync
+static uint32_t flash_erases;
+static uint32_t flash_programs;                 // WRITE_SIZE pages programmed
+static uint32_t flash_wear[NUM_BLOCKS];         // erases of each block
+static long flash_cut = -1;                     // operations until power is cut, or -1
+
+static struct vfs_file flash_file;
+
+static void flash_reset_counts(void) {
+    flash_erases = 0;
+    flash_programs = 0;
+    memset(flash_wear, 0, sizeof(flash_wear));
+}
+
+static void flash_reset(void) {
+    memset(flash, 0xff, sizeof(flash));
+    memset(expected, 0xff, sizeof(expected));
+    flash_reset_counts();
+}
+
+static uint32_t max_wear(const uint32_t *wear) {
+    uint32_t max = 0;
+    for (size_t i = 0; i < NUM_BLOCKS; i++) {
+        max = MAX(max, wear[i]);
+    }
+    return max;
+}
+
+// Counts down to a power cut. The operation that is cut only does half of its work, and every
+// operation after it fails.
+static bool flash_power(size_t *len) {
+    if (flash_cut < 0) {
+        return true;
+    }
+    if (flash_cut == 0) {
+        *len = 0;
+        return false;
+    }
+    if (--flash_cut == 0) {
+        *len /= 2;
+        return false;
+    }
+    return true;
+}
+
+// VFS and device functions that mtdblk.c calls, implemented on the emulated flash
+void vfs_file_init(struct vfs_file *file, const struct vfs_file_vtable *func, int flags) {
+    file->func = func;
+    file->ref_count = 1;
+    file->flags = flags;
+}
+
+void vfs_release_file(struct vfs_file *file) {
+}
+
+void *vfs_copy_file(struct vfs_file *file) {
+    return file;
+}
+
+struct vfs_file *opendev(dev_t dev, int flags) {
+    return &flash_file;
+}
+
+void dev_lock(void) {
+}
+
+bool dev_try_lock(void) {
+    return true;
+}
+
+void dev_unlock(void) {
+}
+
+void mem_shrinker_register(struct mem_shrinker *shrinker) {
+}
+
+int vfs_fsync(struct vfs_file *file) {
+    return 0;
+}
+
+void *vfs_mmap(void *addr, size_t len, int prot, int flags, struct vfs_file *file, off_t off) {
+    return flash + off;
+}
+
+ssize_t vfs_pread(struct vfs_file *file, void *buffer, size_t size, off_t offset) {
+    memcpy(buffer, flash + offset, size);
+    return size;
+}
+
+ssize_t vfs_pwrite(struct vfs_file *file, const void *buffer, size_t size, off_t offset) {
+    assert((offset % WRITE_SIZE == 0) && (size % WRITE_SIZE == 0));
+    const uint8_t *data = buffer;
+    size_t len = size;
+    bool on = flash_power(&len);
+    for (size_t i = 0; i < len; i++) {
+        flash[offset + i] &= data[i];
+    }
+    if (!on) {
+        errno = EIO;
+        return -1;
+    }
+    flash_programs += size / WRITE_SIZE;
+    return size;
+}
+
+int vfs_vioctl(struct vfs_file *file, unsigned long request, va_list args) {
+    switch (request) {
+        case MEMGETINFO: {
+            struct mtd_info *info = va_arg(args, struct mtd_info *);
+            memset(info, 0, sizeof(*info));
+            info->type = MTD_NORFLASH;
+            info->flags = MTD_CAP_NORFLASH;
+            info->size = FLASH_SIZE;
+            info->erasesize = ERASE_SIZE;
+            info->writesize = WRITE_SIZE;
+            return 0;
+        }
+        case MEMERASE: {
+            const struct erase_info *erase_info = va_arg(args, const struct erase_info *);
+            size_t len = erase_info->length;
+            bool on = flash_power(&len);
+            memset(flash + erase_info->start, 0xff, len);
+            if (!on) {
+                errno = EIO;
+                return -1;
+            }
+            flash_erases += erase_info->length / ERASE_SIZE;
+            for (uint32_t pos = erase_info->start; pos < erase_info->start + erase_info->length; pos += ERASE_SIZE) {
+                flash_wear[pos / ERASE_SIZE]++;
+            }
+            return 0;
+        }
+        default:
+            return -1;
+    }
+}
+
+int vfs_ioctl(struct vfs_file *file, unsigned long request, ...) {
+    va_list args;
+    va_start(args, request);
+    int ret = vfs_vioctl(file, request, args);
+    va_end(args);
+    return ret;
+}
+
+#include "../../mtdblk.c"
+
+static int bench_ioctl(struct mtdblk_file *file, unsigned long request, ...) {
+    va_list args;
+    va_start(args, request);
+    int ret = mtdblk_ioctl(file, request, args);
+    va_end(args);
+    return ret;
+}
+
+
+// A write of len bytes at a byte offset, optionally followed by an fsync
+struct op {
+    uint32_t offset;
+    uint32_t len;
+    bool sync;
+};
+
+// Model of the previous cache: direct-mapped, and every eviction or flush of a cached block
+// erases and programs it whether or not it was written.
+struct model {
+    long *slots;
+    size_t num_entries;
+    uint32_t erases;
+    uint32_t programs;
+    uint32_t wear[NUM_BLOCKS];
+};
+
+static void model_write_back(struct model *model, long block) {
+    model->erases++;
+    model->programs += ERASE_SIZE / WRITE_SIZE;
+    model->wear[block]++;
+}
+
+static void model_flush(struct model *model) {
+    for (size_t i = 0; i < model->num_entries; i++) {
+        if (model->slots[i] >= 0) {
+            model_write_back(model, model->slots[i]);
+        }
+    }
+}
+
+static void model_run(struct model *model, const struct op *ops, size_t num_ops, size_t num_entries) {
+    memset(model, 0, sizeof(*model));
+    model->num_entries = num_entries;
+    model->slots = malloc(num_entries * sizeof(long));
+    for (size_t i = 0; i < num_entries; i++) {
+        model->slots[i] = -1;
+    }
+    for (size_t i = 0; i < num_ops; i++) {
+        for (uint32_t pos = ops[i].offset; pos < ops[i].offset + ops[i].len; pos = (pos / ERASE_SIZE + 1) * ERASE_SIZE) {
+            long block = pos / ERASE_SIZE;
+            long *slot = &model->slots[block % num_entries];
+            if ((*slot >= 0) && (*slot != block)) {
+                model_write_back(model, *slot);
+            }
+            *slot = block;
+        }
+        if (ops[i].sync) {
+            model_flush(model);
+        }
+    }
+    model_flush(model);
+    free(model->slots);
+}
+
+// Opens the device, formatting the emulated flash first if reset is set.
+static struct mtdblk_file *open_device(bool reset) {
+    if (reset) {
+        flash_reset();
+    }
+    struct mtdblk_file *file = calloc(1, sizeof(struct mtdblk_file));
+    if (mtdblk_file_init(file, 0, DEV_MTDBLK0) < 0) {
+        fprintf(stderr, "init failed\n");
+        exit(1);
+    }
+    #if MTDBLK_FTL
+    if (reset) {
+        if (bench_ioctl(file, MTDBLKFTLFORMAT) < 0) {
+            fprintf(stderr, "MTDBLKFTLFORMAT failed\n");
+            exit(1);
+        }
+        flash_reset_counts();
+        memset(&file->stats, 0, sizeof(file->stats));
+    }
+    #endif
+    return file;
+}
+
+static void close_device(struct mtdblk_file *file) {
+    mtdblk_file_deinit(file);
+    free(file);
+}
+
+static void run(const char *name, const struct op *ops, size_t num_ops, int num_entries) {
+    struct mtdblk_file *file = open_device(true);
+    if (bench_ioctl(file, MTDBLKSETCACHE, &num_entries) < 0) {
+        fprintf(stderr, "MTDBLKSETCACHE failed\n");
+        exit(1);
+    }
+
+    static uint8_t buffer[FLASH_SIZE];
+    for (size_t i = 0; i < num_ops; i++) {
+        // Writes usually fill erased space or overwrite with new data, which the FAT workload
+        // changes in both directions.
+        memset(buffer, (i & 1) ? ((i & 2) ? 0xa5 : 0x00) : 0x5a, ops[i].len);
+        if (mtdblk_pwrite(file, buffer, ops[i].len, ops[i].offset) < 0) {
+            fprintf(stderr, "%s: write failed\n", name);
+            exit(1);
+        }
+        memcpy(expected + ops[i].offset, buffer, ops[i].len);
+        if (ops[i].sync) {
+            mtdblk_fsync(file);
+        }
+    }
+    mtdblk_fsync(file);
+    size_t size = file->size;
+    struct mtdblk_stats stats;
+    bench_ioctl(file, MTDBLKGETSTATS, &stats);
+    close_device(file);
+
+    // The counts above do not include reading the data back, which does not erase or program.
+    uint32_t erases = flash_erases;
+    uint32_t programs = flash_programs;
+    uint32_t wear = max_wear(flash_wear);
+    file = open_device(false);
+    if ((mtdblk_pread(file, buffer, size, 0) != size) || memcmp(buffer, expected, size)) {
+        fprintf(stderr, "%s: device does not read back what was written\n", name);
+        exit(1);
+    }
+    close_device(file);
+
+    static struct model model;
+    model_run(&model, ops, num_ops, num_entries);
+    double us = (double)erases * ERASE_US + (double)programs * PROGRAM_US;
+    double model_us = (double)model.erases * ERASE_US + (double)model.programs * PROGRAM_US;
+    printf("%-12s %8u %8u %10.1f %6u   %8u %8u %10.1f %6u   %5u/%-5u %6u\n",
+        name, model.erases, model.programs, model_us / 1000, max_wear(model.wear),
+        erases, programs, us / 1000, wear, stats.hits, stats.misses, stats.gc_moves);
+}
+
+#if MTDBLK_FTL
+// Writes a sector filled with one byte.
+static int write_sector(struct mtdblk_file *file, int sector, uint8_t value) {
+    uint8_t buffer[MTDBLK_FTL_SECTOR_SIZE];
+    memset(buffer, value, sizeof(buffer));
+    return mtdblk_pwrite(file, buffer, sizeof(buffer), (off_t)sector * sizeof(buffer)) < 0 ? -1 : 0;
+}
+
+// Fills every sector of the device, then cuts power at every point of a run of synced random
+// overwrites. Checks that the device comes back with each sector holding what was last synced or
+// what was written after that, and that it can still be written, so that a collection cut short
+// on a full device can always be resumed.
+static void powerfail(int num_entries) {
+    enum { SECTOR = MTDBLK_FTL_SECTOR_SIZE, NUM_SYNCS = 150, PER_SYNC = 8 };
+    static uint8_t synced[FLASH_SIZE / SECTOR];
+    static uint8_t written[FLASH_SIZE / SECTOR];
+    static uint8_t filled[FLASH_SIZE];
+    uint8_t buffer[SECTOR];
+
+    struct mtdblk_file *file = open_device(true);
+    int num_sectors = file->size / SECTOR;
+    for (int sector = 0; sector < num_sectors; sector++) {
+        synced[sector] = sector % 0xfe + 1;
+        if (write_sector(file, sector, synced[sector]) < 0) {
+            fprintf(stderr, "powerfail: fill failed\n");
+            exit(1);
+        }
+    }
+    mtdblk_fsync(file);
+    close_device(file);
+    memcpy(filled, flash, FLASH_SIZE);
+    memcpy(written, synced, num_sectors);
+    const uint8_t *filled_synced = written;
+
+    long num_cuts = 0;
+    for (long cut = 1; ; cut++) {
+        srand(2);
+        memcpy(flash, filled, FLASH_SIZE);
+        memcpy(synced, filled_synced, num_sectors);
+        static uint8_t pending[FLASH_SIZE / SECTOR];
+        memcpy(pending, synced, num_sectors);
+        file = open_device(false);
+        bench_ioctl(file, MTDBLKSETCACHE, &num_entries);
+        flash_cut = cut;
+        uint8_t version = 0;
+        bool failed = false;
+        for (int i = 0; (i < NUM_SYNCS) && !failed; i++) {
+            for (int j = 0; (j < PER_SYNC) && !failed; j++) {
+                int sector = rand() % num_sectors;
+                if (pending[sector] != synced[sector]) {
+                    continue;
+                }
+                version = version % 0xfe + 1;
+                pending[sector] = version;
+                failed = write_sector(file, sector, version) < 0;
+            }
+            failed = failed || (mtdblk_fsync(file) < 0);
+            if (!failed) {
+                memcpy(synced, pending, num_sectors);
+            }
+        }
+        struct mtdblk_stats stats = file->stats;
+        close_device(file);
+        if (!failed) {
+            printf("power cut at %ld points of a full device, no synced sector lost, %u erases and %u moves without a cut\n",
+                num_cuts, stats.erases, stats.gc_moves);
+            break;
+        }
+        flash_cut = -1;
+        num_cuts++;
+
+        file = open_device(false);
+        for (int sector = 0; sector < num_sectors; sector++) {
+            if (mtdblk_pread(file, buffer, SECTOR, sector * SECTOR) != SECTOR) {
+                fprintf(stderr, "powerfail: read failed\n");
+                exit(1);
+            }
+            bool ok = false;
+            for (int k = 0; k < SECTOR; k++) {
+                ok = (buffer[k] == synced[sector]) || (buffer[k] == pending[sector]);
+                if (!ok || (buffer[k] != buffer[0])) {
+                    ok = false;
+                    break;
+                }
+            }
+            if (!ok) {
+                fprintf(stderr, "powerfail: cut %ld: sector %d lost\n", cut, sector);
+                exit(1);
+            }
+        }
+        // Rewrite more sectors than a block holds, so that collection runs after the remount.
+        for (int i = 0; i < 4 * (ERASE_SIZE / SECTOR); i++) {
+            int sector = rand() % num_sectors;
+            if ((write_sector(file, sector, 0xff) < 0) || ((i % PER_SYNC == 0) && (mtdblk_fsync(file) < 0))) {
+                fprintf(stderr, "powerfail: cut %ld: write after remount failed, errno %d, %u free blocks\n",
+                    cut, errno, file->ftl->num_free);
+                exit(1);
+            }
+        }
+        close_device(file);
+    }
+    flash_cut = -1;
+}
+#endif
+
+int main(int argc, char **argv) {
+    int num_entries = (argc > 1) ? atoi(argv[1]) : MTDBLK_NUM_CACHE_ENTRIES;
+    static struct op ops[100000];
+    size_t num_ops;
+    srand(1);
+
+    // Workloads stay within the capacity of the device, which the translation layer reduces.
+    struct mtdblk_file *file = open_device(true);
+    uint32_t num_blocks = file->size / ERASE_SIZE;
+    close_device(file);
+
+    printf("%d entries, %d ways, %u blocks\n", num_entries, MIN(num_entries, MTDBLK_CACHE_WAYS), num_blocks);
+    printf("%-12s %8s %8s %10s %6s   %8s %8s %10s %6s   %-11s %6s\n",
+        "workload", "erases", "programs", "ms", "wear", "erases", "programs", "ms", "wear", "hits/misses", "moves");
+    #if MTDBLK_FTL
+    const char *label = "flash translation layer";
+    #else
+    const char *label = "set-associative, dirty bits";
+    #endif
+    printf("%-12s %37s   %37s\n", "", "direct-mapped, write always", label);
+
+    // Two hot blocks whose numbers are a multiple of the cache size apart, written in turn
+    num_ops = 0;
+    for (uint32_t i = 0; i < 2000; i++) {
+        uint32_t block = (i & 1) ? num_entries : 0;
+        ops[num_ops++] = (struct op){ block * ERASE_SIZE + (i / 2 % 16) * WRITE_SIZE, WRITE_SIZE };
+    }
+    run("collide", ops, num_ops, num_entries);
+
+    // A log appended in write-sized records, as a log-structured filesystem does
+    num_ops = 0;
+    for (uint32_t pos = 0; pos < FLASH_SIZE / 2; pos += WRITE_SIZE) {
+        ops[num_ops++] = (struct op){ pos, WRITE_SIZE };
+    }
+    run("append", ops, num_ops, num_entries);
+
+    // Metadata blocks updated in place, and data blocks written once
+    num_ops = 0;
+    for (uint32_t i = 0; i < 4000; i++) {
+        if (i % 4 == 0) {
+            ops[num_ops++] = (struct op){ (rand() % 4) * ERASE_SIZE + (rand() % 16) * WRITE_SIZE, WRITE_SIZE };
+        } else {
+            ops[num_ops++] = (struct op){ (16 + i / 4 % (num_blocks - 16)) * ERASE_SIZE + (i % 4) * WRITE_SIZE * 4, WRITE_SIZE * 4 };
+        }
+    }
+    run("metadata", ops, num_ops, num_entries);
+
+    // Random writes over a working set twice the size of the cache
+    num_ops = 0;
+    for (uint32_t i = 0; i < 4000; i++) {
+        uint32_t block = rand() % (2 * num_entries);
+        ops[num_ops++] = (struct op){ block * ERASE_SIZE + (rand() % 16) * WRITE_SIZE, WRITE_SIZE };
+    }
+    run("random", ops, num_ops, num_entries);
+
+    // A half full FAT volume: files rewritten a cluster at a time, each followed by an update of
+    // the allocation table in the first block and a sync
+    num_ops = 0;
+    for (uint32_t i = 0; i < 8000; i++) {
+        uint32_t cluster = i % (num_blocks / 2 * (ERASE_SIZE / 512));
+        ops[num_ops++] = (struct op){ ERASE_SIZE + cluster * 512, 512 };
+        ops[num_ops++] = (struct op){ cluster / 128 * 512 % ERASE_SIZE, 512, true };
+    }
+    run("fat", ops, num_ops, num_entries);
+
+    #if MTDBLK_FTL
+    powerfail(num_entries);
+    #endif
+    return 0;
+}
@@ -0,0 +1,15 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Mutexes that always succeed, since the benchmark runs in one thread.
+typedef int StaticSemaphore_t;
+typedef int *SemaphoreHandle_t;
+
+#define xSemaphoreCreateMutexStatic(buffer) (buffer)
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+    return pdTRUE;
+}
+#define xSemaphoreGive(mutex) (void)(mutex)
+#define vSemaphoreDelete(mutex) (void)(mutex)
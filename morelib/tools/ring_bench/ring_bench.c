@@ -0,0 +1,189 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+/* Runs a producer and a consumer thread on the host against one ring with the lock-free
+ * single-producer/single-consumer functions, as the UART receive interrupt and a reading task do on
+ * the device. Every byte carries a pattern derived from its position in the stream, so the consumer
+ * detects any byte that is lost, repeated or read before the producer published it. Each workload
+ * alternates the copying and zero-copy functions and prints the throughput.
+ *
+ * Build from this directory:
+ *   cc -O2 -pthread -iquote ../../include -o ring_bench ring_bench.c
+ *
+ * Usage:
+ *   ring_bench [MBYTES] [LOG2_SIZE]     stream MBYTES per workload (default 256) through a ring of
+ *                                       2^LOG2_SIZE bytes (default 10)
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../ring.c"
+
+
+struct workload {
+    const char *name;
+    size_t chunk_size;      // most bytes moved by one call
+    bool zero_copy;         // use reserve/commit and peek/consume instead of write/read
+};
+
+static const struct workload workloads[] = {
+    { "byte",       1,      false },
+    { "small",      13,     false },
+    { "large",      509,    false },
+    { "byte-zc",    1,      true },
+    { "small-zc",   13,     true },
+    { "large-zc",   509,    true },
+};
+
+static ring_t ring;
+static const struct workload *workload;
+static size_t total_bytes;
+static size_t num_errors;
+static size_t first_error = SIZE_MAX;
+
+static inline char pattern(size_t index) {
+    return index ^ (index >> 8) ^ (index >> 16);
+}
+
+// Returns the byte at offset i of a region split into two segments.
+static inline char *segment_ptr(const struct ring_segment segs[2], size_t i) {
+    return (i < segs[0].size) ? segs[0].ptr + i : segs[1].ptr + (i - segs[0].size);
+}
+
+static size_t produce(size_t index, size_t count) {
+    if (!workload->zero_copy) {
+        char buffer[512];
+        for (size_t i = 0; i < count; i++) {
+            buffer[i] = pattern(index + i);
+        }
+        return ring_spsc_write(&ring, buffer, count);
+    }
+    struct ring_segment segs[2];
+    size_t free_count = ring_spsc_reserve(&ring, segs);
+    count = MIN(free_count, count);
+    for (size_t i = 0; i < count; i++) {
+        *segment_ptr(segs, i) = pattern(index + i);
+    }
+    ring_spsc_commit(&ring, count);
+    return count;
+}
+
+static size_t consume(size_t index, size_t count) {
+    char buffer[512];
+    struct ring_segment segs[2];
+    if (!workload->zero_copy) {
+        count = ring_spsc_read(&ring, buffer, count);
+        segs[0] = (struct ring_segment){ buffer, count };
+        segs[1] = (struct ring_segment){ NULL, 0 };
+    } else {
+        size_t used_count = ring_spsc_peek(&ring, segs);
+        count = MIN(used_count, count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        char ch = *segment_ptr(segs, i);
+        if (ch != pattern(index + i)) {
+            first_error = MIN(first_error, index + i);
+            num_errors++;
+        }
+    }
+    if (workload->zero_copy) {
+        ring_spsc_consume(&ring, count);
+    }
+    return count;
+}
+
+// Varies the size of each call so that the indexes land on every offset of the buffer.
+static size_t next_count(size_t index, size_t remaining) {
+    size_t count = workload->chunk_size > 1 ? 1 + index % workload->chunk_size : 1;
+    return MIN(count, remaining);
+}
+
+// Each side sleeps briefly when the ring is full or empty, so that the other thread gets to run when
+// both share a core.
+static void wait_other(void) {
+    struct timespec ts = { 0, 1000 };
+    nanosleep(&ts, NULL);
+}
+
+static void *producer(void *arg) {
+    (void)arg;
+    size_t index = 0;
+    while (index < total_bytes) {
+        size_t count = produce(index, next_count(index, total_bytes - index));
+        if (!count) {
+            wait_other();
+        }
+        index += count;
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    (void)arg;
+    size_t index = 0;
+    while (index < total_bytes) {
+        size_t count = consume(index, next_count(index * 7, total_bytes - index));
+        if (!count) {
+            wait_other();
+        }
+        index += count;
+    }
+    return NULL;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool run(const struct workload *w) {
+    workload = w;
+    num_errors = 0;
+    first_error = SIZE_MAX;
+    ring_clear(&ring);
+
+    pthread_t threads[2];
+    double start = now();
+    if (pthread_create(&threads[0], NULL, consumer, NULL) || pthread_create(&threads[1], NULL, producer, NULL)) {
+        fprintf(stderr, "pthread_create failed\n");
+        exit(1);
+    }
+    pthread_join(threads[1], NULL);
+    pthread_join(threads[0], NULL);
+    double elapsed = now() - start;
+
+    printf("%-10s %6zu %10.1f %8zu\n", w->name, w->chunk_size, total_bytes / elapsed / 1e6, num_errors);
+    if (num_errors) {
+        fprintf(stderr, "%s: %zu bytes corrupt, first at %zu\n", w->name, num_errors, first_error);
+        return false;
+    }
+    if (ring_spsc_read_count(&ring)) {
+        fprintf(stderr, "%s: %zu bytes left in ring\n", w->name, ring_spsc_read_count(&ring));
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    total_bytes = ((argc > 1) ? strtoul(argv[1], NULL, 0) : 256) << 20;
+    uint log2_size = (argc > 2) ? atoi(argv[2]) : 10;
+    if (!ring_alloc(&ring, log2_size)) {
+        fprintf(stderr, "ring_alloc failed\n");
+        return 1;
+    }
+
+    printf("%zu MB per workload, %zu byte ring\n", total_bytes >> 20, ring.size);
+    printf("%-10s %6s %10s %8s\n", "workload", "chunk", "MB/s", "errors");
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+        ok &= run(&workloads[i]);
+    }
+    ring_free(&ring);
+    return ok ? 0 : 1;
+}
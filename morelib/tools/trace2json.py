@@ -0,0 +1,158 @@
+# SPDX-FileCopyrightText: 2025 Gregory Neverov
+# SPDX-License-Identifier: MIT
+
+import argparse
+import json
+import struct
+
+
+parser = argparse.ArgumentParser(description="Converts a trace dump to the Chrome JSON trace format for Perfetto or Trace Compass")
+parser.add_argument("input", help="input trace dump written by trace_dump")
+parser.add_argument("--output", help="output JSON file")
+args = parser.parse_args()
+
+TRACE_MAGIC = 0x4352544D
+TRACE_VERSION = 1
+
+# Event types from freertos/trace.h
+TRACE_TASK_SWITCHED_IN = 1
+TRACE_TASK_READY = 2
+TRACE_TASK_CREATE = 3
+TRACE_TASK_DELETE = 4
+TRACE_TASK_DELAY = 5
+TRACE_BLOCK_QUEUE_RECEIVE = 6
+TRACE_BLOCK_QUEUE_SEND = 7
+TRACE_BLOCK_NOTIFY = 8
+TRACE_SYSCALL_ENTER = 9
+TRACE_SYSCALL_EXIT = 10
+TRACE_INTERRUPTIBLE_BEGIN = 11
+TRACE_INTERRUPTIBLE_END = 12
+
+SYSCALLS = ["read", "write", "poll"]
+
+CPU_PID = 0
+TASK_PID = 1
+
+
+def read_dump(data):
+    magic, version, num_cores, timestamp_hz, num_tasks = struct.unpack_from("<IHHII", data, 0)
+    if magic != TRACE_MAGIC:
+        raise ValueError("not a trace dump")
+    if version != TRACE_VERSION:
+        raise ValueError(f"unsupported trace version {version}")
+    offset = 16
+
+    tasks = {}
+    for _ in range(num_tasks):
+        number, name = struct.unpack_from("<I16s", data, offset)
+        tasks[number] = name.split(b"\0", 1)[0].decode(errors="replace")
+        offset += 20
+
+    cores = []
+    for _ in range(num_cores):
+        (count,) = struct.unpack_from("<I", data, offset)
+        offset += 4
+        events = []
+        for _ in range(count):
+            events.append(struct.unpack_from("<IBBHII", data, offset))
+            offset += 16
+        cores.append(events)
+    return timestamp_hz, tasks, cores
+
+
+def unwrap(events):
+    # Timestamps are the low 32 bits of a 64-bit counter.
+    high = 0
+    prev = None
+    for timestamp, type, core, _, arg1, arg2 in events:
+        if prev is not None and timestamp < prev:
+            high += 1 << 32
+        prev = timestamp
+        yield high + timestamp, type, core, arg1, arg2
+
+
+def convert(timestamp_hz, tasks, cores):
+    scale = 1000000 / timestamp_hz
+    streams = [list(unwrap(events)) for events in cores]
+
+    # All cores share one clock, so shift each core's events by whole wraps to line up with core 0.
+    ref = next((events[0][0] for events in streams if events), 0)
+    for i, events in enumerate(streams):
+        if events:
+            shift = round((ref - events[0][0]) / (1 << 32)) << 32
+            streams[i] = [(timestamp + shift, *rest) for timestamp, *rest in events]
+    start = min((events[0][0] for events in streams if events), default=0)
+
+    def task_name(number):
+        return tasks.get(number, f"task {number}")
+
+    out = []
+    out.append({"ph": "M", "name": "process_name", "pid": CPU_PID, "args": {"name": "CPUs"}})
+    out.append({"ph": "M", "name": "process_name", "pid": TASK_PID, "args": {"name": "Tasks"}})
+    for core in range(len(cores)):
+        out.append({"ph": "M", "name": "thread_name", "pid": CPU_PID, "tid": core, "args": {"name": f"core {core}"}})
+
+    seen_tasks = set(tasks)
+    for core, events in enumerate(streams):
+        current = None
+        current_start = None
+        for timestamp, type, _, arg1, arg2 in events:
+            ts = (timestamp - start) * scale
+
+            if type == TRACE_TASK_SWITCHED_IN:
+                if current is not None:
+                    out.append({"ph": "X", "name": task_name(current), "pid": CPU_PID, "tid": core, "ts": current_start, "dur": ts - current_start})
+                current = arg1
+                current_start = ts
+                seen_tasks.add(arg1)
+                continue
+
+            if type in (TRACE_TASK_READY, TRACE_TASK_CREATE, TRACE_TASK_DELETE):
+                # These events are about another task, which may not be running.
+                name = {TRACE_TASK_READY: "ready", TRACE_TASK_CREATE: "create", TRACE_TASK_DELETE: "delete"}[type]
+                out.append({"ph": "i", "s": "t", "name": name, "pid": TASK_PID, "tid": arg1, "ts": ts, "args": {"core": core}})
+                seen_tasks.add(arg1)
+                continue
+
+            if current is None:
+                # Event before the first context switch in the buffer. The task is unknown.
+                continue
+            event = {"pid": TASK_PID, "tid": current, "ts": ts}
+            if type == TRACE_TASK_DELAY:
+                event.update({"ph": "i", "s": "t", "name": "delay", "args": {"until": arg1} if arg1 else {}})
+            elif type == TRACE_BLOCK_QUEUE_RECEIVE:
+                event.update({"ph": "i", "s": "t", "name": "block on queue receive", "args": {"queue": hex(arg1)}})
+            elif type == TRACE_BLOCK_QUEUE_SEND:
+                event.update({"ph": "i", "s": "t", "name": "block on queue send", "args": {"queue": hex(arg1)}})
+            elif type == TRACE_BLOCK_NOTIFY:
+                event.update({"ph": "i", "s": "t", "name": "block on notification", "args": {"index": arg1}})
+            elif type == TRACE_SYSCALL_ENTER:
+                name = SYSCALLS[arg1] if arg1 < len(SYSCALLS) else f"syscall {arg1}"
+                event.update({"ph": "B", "name": name, "args": {"arg": arg2}})
+            elif type == TRACE_SYSCALL_EXIT:
+                name = SYSCALLS[arg1] if arg1 < len(SYSCALLS) else f"syscall {arg1}"
+                event.update({"ph": "E", "name": name, "args": {"ret": struct.unpack("<i", struct.pack("<I", arg2))[0]}})
+            elif type == TRACE_INTERRUPTIBLE_BEGIN:
+                event.update({"ph": "B", "name": "interruptible", "args": {"caller": hex(arg1)}})
+            elif type == TRACE_INTERRUPTIBLE_END:
+                event.update({"ph": "E", "name": "interruptible"})
+            else:
+                continue
+            out.append(event)
+
+        # The task running at the time of the dump.
+        if current is not None:
+            ts = (events[-1][0] - start) * scale
+            out.append({"ph": "X", "name": task_name(current), "pid": CPU_PID, "tid": core, "ts": current_start, "dur": ts - current_start})
+
+    for number in sorted(seen_tasks):
+        out.append({"ph": "M", "name": "thread_name", "pid": TASK_PID, "tid": number, "args": {"name": task_name(number)}})
+    return {"traceEvents": out, "displayTimeUnit": "ns"}
+
+
+with open(args.input, "rb") as f:
+    trace = convert(*read_dump(f.read()))
+
+output = args.output or (args.input + ".json")
+with open(output, "w") as f:
+    json.dump(trace, f)
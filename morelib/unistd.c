@@ -9,6 +9,7 @@
 #include <sys/random.h>
 #include <time.h>
 #include <unistd.h>
+#include "freertos/trace.h"
 #include "morelib/dev.h"
 #include "morelib/poll.h"
 #include "morelib/vfs.h"
@@ -40,7 +41,7 @@ static TimerHandle_t alarm_timer;
 
 static void alarm_callback(TimerHandle_t xTimer) {
     if (pvTimerGetTimerID(xTimer)) {
-        raise(SIGALRM);
+        kill(0, SIGALRM);
     }
 }
 
@@ -209,12 +210,14 @@ ssize_t pwrite(int fd, const void *buffer, size_t size, off_t offset) {
 }
 
 int read(int fd, void *buffer, size_t size) {
+    TRACE_SYSCALL(TRACE_SYS_READ, fd);
+    int ret = -1;
     struct vfs_file *file = vfs_acquire_file(fd, FREAD);
-    if (!file) {
-        return -1;
+    if (file) {
+        ret = vfs_read(file, buffer, size);
+        vfs_release_file(file);
     }
-    int ret = vfs_read(file, buffer, size);
-    vfs_release_file(file);
+    TRACE_SYSCALL_RETURN(TRACE_SYS_READ, ret);
     return ret;
 }
 
@@ -292,11 +295,13 @@ int unlink(const char *file) {
 }
 
 int write(int fd, const void *buffer, size_t size) {
+    TRACE_SYSCALL(TRACE_SYS_WRITE, fd);
+    int ret = -1;
     struct vfs_file *file = vfs_acquire_file(fd, FWRITE);
-    if (!file) {
-        return -1;
+    if (file) {
+        ret = vfs_write(file, buffer, size);
+        vfs_release_file(file);
     }
-    int ret = vfs_write(file, buffer, size);
-    vfs_release_file(file);
+    TRACE_SYSCALL_RETURN(TRACE_SYS_WRITE, ret);
     return ret;
 }
@@ -0,0 +1,886 @@
+// SPDX-FileCopyrightText: 2025 Gregory Neverov
+// SPDX-License-Identifier: MIT
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "morelib/ring.h"
+#include "morelib/unix.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+
+// Files in flight in an SCM_RIGHTS message
+struct unix_rights {
+    struct unix_rights *next;
+    size_t index;                       // stream index of the byte the files are attached to
+    int num_files;
+    struct vfs_file *files[];
+};
+
+struct unix_dgram {
+    struct unix_dgram *next;
+    struct unix_rights *rights;
+    char *path;                         // name of the sender, or NULL
+    size_t size;
+    char data[];
+};
+
+struct unix_socket {
+    struct socket base;
+    struct unix_socket *next;           // list of all sockets
+    struct unix_socket *peer;           // connected peer
+    struct unix_socket *waiting_on;     // socket whose buffer this socket is waiting for space in
+    char *path;                         // bound name, or listener's name for accepted sockets, or NULL
+
+    // listening stream sockets
+    struct unix_socket *pending;        // connections waiting to be accepted
+    struct unix_socket *next_pending;
+    int backlog;
+    int num_pending;
+
+    // connected stream sockets
+    ring_t ring;
+    struct unix_rights *rights;         // in stream order
+
+    // datagram sockets
+    struct unix_dgram *dgrams;
+    size_t dgram_bytes;
+
+    struct ucred peercred;
+    uint bound : 1;                     // path is in the name table
+    uint connected : 1;
+    uint rd_shutdown : 1;
+    uint wr_shutdown : 1;
+    uint has_waiters : 1;
+};
+
+// All unix socket state is protected by one mutex, since most operations touch both ends of a connection.
+static SemaphoreHandle_t unix_mutex;
+static struct unix_socket *unix_sockets;
+
+__attribute__((constructor, visibility("hidden")))
+void unix_init(void) {
+    static StaticSemaphore_t xMutexBuffer;
+    unix_mutex = xSemaphoreCreateMutexStatic(&xMutexBuffer);
+}
+
+static void unix_lock(void) {
+    xSemaphoreTake(unix_mutex, portMAX_DELAY);
+}
+
+static void unix_unlock(void) {
+    xSemaphoreGive(unix_mutex);
+}
+
+static const struct socket_vtable unix_vtable;
+
+// Must be called with the unix mutex held.
+static struct unix_socket *unix_alloc(int type) {
+    struct unix_socket *socket = socket_alloc(sizeof(struct unix_socket), &unix_vtable, AF_UNIX, type, 0);
+    if (!socket) {
+        return NULL;
+    }
+    socket->next = unix_sockets;
+    unix_sockets = socket;
+    if (type == SOCK_DGRAM) {
+        socket_notify(&socket->base, 0, POLLOUT | POLLWRNORM);
+    }
+    return socket;
+}
+
+static struct unix_socket *unix_find(const char *path) {
+    for (struct unix_socket *socket = unix_sockets; socket; socket = socket->next) {
+        if (socket->bound && (strcmp(socket->path, path) == 0)) {
+            return socket;
+        }
+    }
+    return NULL;
+}
+
+static const char *unix_path_from_sockaddr(const struct sockaddr *address, socklen_t address_len, vfs_path_buffer_t *vfs_path) {
+    size_t offset = offsetof(struct sockaddr_un, sun_path);
+    if ((address_len <= offset) || (address->sa_family != AF_UNIX)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    char path[UNIX_PATH_MAX + 1];
+    size_t len = MIN(address_len - offset, UNIX_PATH_MAX);
+    strncpy(path, ((const struct sockaddr_un *)address)->sun_path, len);
+    path[len] = '\0';
+    if (vfs_expand_path(vfs_path, path) < 0) {
+        return NULL;
+    }
+    return vfs_path->begin;
+}
+
+static void unix_path_to_sockaddr(const char *path, struct sockaddr *address, socklen_t *address_len) {
+    if (!address) {
+        return;
+    }
+    struct sockaddr_un sa;
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path ? path : "", UNIX_PATH_MAX);
+    size_t len = offsetof(struct sockaddr_un, sun_path) + strnlen(sa.sun_path, UNIX_PATH_MAX);
+    memcpy(address, &sa, MIN(*address_len, len));
+    *address_len = len;
+}
+
+static size_t unix_iov_len(const struct msghdr *message) {
+    size_t len = 0;
+    for (int i = 0; i < message->msg_iovlen; i++) {
+        len += message->msg_iov[i].iov_len;
+    }
+    return len;
+}
+
+static void unix_credentials(struct ucred *cred) {
+    cred->pid = getpid();
+    cred->uid = 0;
+    cred->gid = 0;
+}
+
+// Makes socket wait for space in target. Must be called with the unix mutex held.
+static int unix_wait_for(struct unix_socket *socket, struct unix_socket *target) {
+    socket->waiting_on = target;
+    target->has_waiters = 1;
+    socket_notify(&socket->base, POLLOUT | POLLWRNORM, 0);
+    errno = EAGAIN;
+    return -1;
+}
+
+// Wakes sockets waiting for space in target. Must be called with the unix mutex held.
+static void unix_wake_waiters(struct unix_socket *target) {
+    if (!target->has_waiters) {
+        return;
+    }
+    target->has_waiters = 0;
+    for (struct unix_socket *socket = unix_sockets; socket; socket = socket->next) {
+        if (socket->waiting_on == target) {
+            socket->waiting_on = NULL;
+            socket_notify(&socket->base, 0, POLLOUT | POLLWRNORM);
+        }
+    }
+}
+
+static int unix_connect_pair(struct unix_socket *socket1, struct unix_socket *socket2) {
+    if (socket1->base.type == SOCK_STREAM) {
+        if (!ring_alloc(&socket1->ring, UNIX_STREAM_LOG2_SIZE) || !ring_alloc(&socket2->ring, UNIX_STREAM_LOG2_SIZE)) {
+            ring_free(&socket1->ring);
+            ring_free(&socket2->ring);
+            return -1;
+        }
+        socket_notify(&socket1->base, 0, POLLOUT | POLLWRNORM);
+        socket_notify(&socket2->base, 0, POLLOUT | POLLWRNORM);
+    }
+    socket1->peer = socket2;
+    socket2->peer = socket1;
+    socket1->connected = 1;
+    socket2->connected = 1;
+    unix_credentials(&socket1->peercred);
+    unix_credentials(&socket2->peercred);
+    return 0;
+}
+
+
+// Rights functions
+static void unix_rights_free(struct unix_rights *rights) {
+    while (rights) {
+        struct unix_rights *next = rights->next;
+        for (int i = 0; i < rights->num_files; i++) {
+            vfs_release_file(rights->files[i]);
+        }
+        free(rights);
+        rights = next;
+    }
+}
+
+// Returns true if a control message is SCM_RIGHTS and lies within the control buffer.
+// CMSG_NXTHDR only checks where the next header starts, not the length of the current one.
+static bool unix_rights_cmsg_valid(const struct msghdr *message, const struct cmsghdr *cmsg) {
+    if ((cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS) || (cmsg->cmsg_len < CMSG_LEN(0))) {
+        return false;
+    }
+    const char *end = (const char *)message->msg_control + message->msg_controllen;
+    return cmsg->cmsg_len <= (size_t)(end - (const char *)cmsg);
+}
+
+static int unix_rights_from_msghdr(const struct msghdr *message, struct unix_rights **prights) {
+    *prights = NULL;
+    int num_files = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(message); cmsg; cmsg = CMSG_NXTHDR(message, cmsg)) {
+        if (!unix_rights_cmsg_valid(message, cmsg)) {
+            errno = EINVAL;
+            return -1;
+        }
+        num_files += (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    }
+    if (!num_files) {
+        return 0;
+    }
+    if (num_files > UNIX_RIGHTS_MAX) {
+        errno = ETOOMANYREFS;
+        return -1;
+    }
+
+    struct unix_rights *rights = malloc(sizeof(struct unix_rights) + num_files * sizeof(struct vfs_file *));
+    if (!rights) {
+        return -1;
+    }
+    rights->next = NULL;
+    rights->index = 0;
+    rights->num_files = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(message); cmsg; cmsg = CMSG_NXTHDR(message, cmsg)) {
+        if (!unix_rights_cmsg_valid(message, cmsg)) {
+            unix_rights_free(rights);
+            errno = EINVAL;
+            return -1;
+        }
+        const int *fds = (const int *)CMSG_DATA(cmsg);
+        int n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (int i = 0; i < n; i++) {
+            struct vfs_file *file = vfs_acquire_file(fds[i], 0);
+            if (!file) {
+                unix_rights_free(rights);
+                return -1;
+            }
+            rights->files[rights->num_files++] = file;
+        }
+    }
+    *prights = rights;
+    return 0;
+}
+
+// Installs received files as new descriptors. Must be called without the unix mutex held, since
+// releasing a file may close a unix socket.
+static void unix_rights_to_msghdr(struct unix_rights *rights, struct msghdr *message) {
+    struct cmsghdr *cmsg = message->msg_control ? CMSG_FIRSTHDR(message) : NULL;
+    int max_fds = (cmsg && (message->msg_controllen >= CMSG_LEN(0))) ? (message->msg_controllen - CMSG_LEN(0)) / sizeof(int) : 0;
+    message->msg_controllen = 0;
+    if (!rights) {
+        return;
+    }
+
+    int num_fds = 0;
+    for (int i = 0; i < rights->num_files; i++) {
+        int fd = (i < max_fds) ? vfs_replace(-1, rights->files[i]) : -1;
+        if (fd >= 0) {
+            ((int *)CMSG_DATA(cmsg))[num_fds++] = fd;
+        } else {
+            message->msg_flags |= MSG_CTRUNC;
+        }
+    }
+    if (num_fds) {
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(num_fds * sizeof(int));
+        message->msg_controllen = cmsg->cmsg_len;
+    }
+    unix_rights_free(rights);
+}
+
+
+// Socket functions
+static struct socket *unix_accept(void *ctx, struct sockaddr *address, socklen_t *address_len) {
+    struct unix_socket *socket = ctx;
+    if (!socket->base.listening) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    TickType_t xTicksToWait = portMAX_DELAY;
+    struct unix_socket *new_socket;
+    int ret;
+    do {
+        unix_lock();
+        new_socket = socket->pending;
+        if (new_socket) {
+            socket->pending = new_socket->next_pending;
+            socket->num_pending--;
+            if (!socket->pending) {
+                socket_notify(&socket->base, POLLIN | POLLRDNORM, 0);
+            }
+            unix_wake_waiters(socket);
+            unix_path_to_sockaddr(new_socket->peer ? new_socket->peer->path : NULL, address, address_len);
+            ret = 0;
+        } else {
+            errno = EAGAIN;
+            ret = -1;
+        }
+        unix_unlock();
+    }
+    while (POLL_SOCKET_CHECK(ret, &socket->base, POLLIN, &xTicksToWait));
+    return (ret >= 0) ? &new_socket->base : NULL;
+}
+
+static int unix_bind(void *ctx, const struct sockaddr *address, socklen_t address_len) {
+    struct unix_socket *socket = ctx;
+    vfs_path_buffer_t vfs_path;
+    const char *path = unix_path_from_sockaddr(address, address_len, &vfs_path);
+    if (!path) {
+        return -1;
+    }
+
+    int ret = -1;
+    unix_lock();
+    if (socket->path) {
+        errno = EINVAL;
+    } else if (unix_find(path)) {
+        errno = EADDRINUSE;
+    } else {
+        socket->path = strdup(path);
+        socket->bound = socket->path != NULL;
+        ret = socket->path ? 0 : -1;
+    }
+    unix_unlock();
+    return ret;
+}
+
+static int unix_close(void *ctx) {
+    struct unix_socket *socket = ctx;
+    unix_lock();
+    struct unix_socket **psocket = &unix_sockets;
+    while (*psocket) {
+        if (*psocket == socket) {
+            *psocket = socket->next;
+            break;
+        }
+        psocket = &(*psocket)->next;
+    }
+    for (struct unix_socket *other = unix_sockets; other; other = other->next) {
+        if (other->peer == socket) {
+            other->peer = NULL;
+            if (other->base.type == SOCK_STREAM) {
+                socket_notify(&other->base, 0, POLLIN | POLLRDNORM | POLLHUP);
+            }
+        }
+        if (other->waiting_on == socket) {
+            // Wake the writer so that it finds the peer gone.
+            other->waiting_on = NULL;
+            socket_notify(&other->base, 0, POLLOUT | POLLWRNORM);
+        }
+    }
+    struct unix_socket *pending = socket->pending;
+    struct unix_rights *rights = socket->rights;
+    struct unix_dgram *dgrams = socket->dgrams;
+    unix_unlock();
+
+    // Release these without the mutex held since they may contain unix sockets.
+    while (pending) {
+        struct unix_socket *next = pending->next_pending;
+        socket_release(&pending->base);
+        pending = next;
+    }
+    unix_rights_free(rights);
+    while (dgrams) {
+        struct unix_dgram *next = dgrams->next;
+        unix_rights_free(dgrams->rights);
+        free(dgrams->path);
+        free(dgrams);
+        dgrams = next;
+    }
+    ring_free(&socket->ring);
+    free(socket->path);
+    return 0;
+}
+
+static int unix_connect(void *ctx, const struct sockaddr *address, socklen_t address_len) {
+    struct unix_socket *socket = ctx;
+    vfs_path_buffer_t vfs_path;
+    const char *path = unix_path_from_sockaddr(address, address_len, &vfs_path);
+    if (!path) {
+        return -1;
+    }
+
+    TickType_t xTicksToWait = portMAX_DELAY;
+    int ret;
+    do {
+        ret = -1;
+        unix_lock();
+        struct unix_socket *target = unix_find(path);
+        if (!target) {
+            errno = ENOENT;
+        } else if (target->base.type != socket->base.type) {
+            errno = EPROTOTYPE;
+        } else if (socket->base.type == SOCK_DGRAM) {
+            socket->peer = target;
+            socket->connected = 1;
+            ret = 0;
+        } else if (socket->connected) {
+            errno = EISCONN;
+        } else if (!target->base.listening) {
+            errno = ECONNREFUSED;
+        } else if (target->num_pending >= target->backlog) {
+            ret = unix_wait_for(socket, target);
+        } else {
+            struct unix_socket *new_socket = unix_alloc(SOCK_STREAM);
+            if (new_socket) {
+                new_socket->path = strdup(target->path);
+            }
+            if (new_socket && new_socket->path && (unix_connect_pair(socket, new_socket) >= 0)) {
+                struct unix_socket **pending = &target->pending;
+                while (*pending) {
+                    pending = &(*pending)->next_pending;
+                }
+                *pending = new_socket;
+                target->num_pending++;
+                socket_notify(&target->base, 0, POLLIN | POLLRDNORM);
+                ret = 0;
+            } else if (new_socket) {
+                unix_unlock();
+                socket_release(&new_socket->base);
+                return -1;
+            }
+        }
+        unix_unlock();
+    }
+    while (POLL_SOCKET_CHECK(ret, &socket->base, POLLOUT, &xTicksToWait));
+    return ret;
+}
+
+static int unix_getpeername(void *ctx, struct sockaddr *address, socklen_t *address_len) {
+    struct unix_socket *socket = ctx;
+    int ret = -1;
+    unix_lock();
+    if (socket->peer) {
+        unix_path_to_sockaddr(socket->peer->path, address, address_len);
+        ret = 0;
+    } else {
+        errno = ENOTCONN;
+    }
+    unix_unlock();
+    return ret;
+}
+
+static int unix_getsockname(void *ctx, struct sockaddr *address, socklen_t *address_len) {
+    struct unix_socket *socket = ctx;
+    unix_lock();
+    unix_path_to_sockaddr(socket->path, address, address_len);
+    unix_unlock();
+    return 0;
+}
+
+static int unix_getsockopt(void *ctx, int level, int option_name, void *option_value, socklen_t *option_len) {
+    struct unix_socket *socket = ctx;
+    if (level != SOL_SOCKET) {
+        errno = ENOPROTOOPT;
+        return -1;
+    }
+    switch (option_name) {
+        case SO_ERROR: {
+            socket_getintopt(option_value, option_len, 0);
+            return 0;
+        }
+        case SO_PEERCRED: {
+            if (*option_len < sizeof(struct ucred)) {
+                errno = EINVAL;
+                return -1;
+            }
+            unix_lock();
+            *(struct ucred *)option_value = socket->peercred;
+            unix_unlock();
+            *option_len = sizeof(struct ucred);
+            return 0;
+        }
+        case SO_RCVBUF: {
+            socket_getintopt(option_value, option_len, (socket->base.type == SOCK_STREAM) ? (1 << UNIX_STREAM_LOG2_SIZE) : UNIX_DGRAM_QUEUE_SIZE);
+            return 0;
+        }
+        default: {
+            errno = ENOPROTOOPT;
+            return -1;
+        }
+    }
+}
+
+static int unix_listen(void *ctx, int backlog) {
+    struct unix_socket *socket = ctx;
+    if (socket->base.type != SOCK_STREAM) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    unix_lock();
+    int ret = -1;
+    if (socket->connected) {
+        errno = EINVAL;
+    } else {
+        socket->backlog = MAX(MIN(backlog, SOMAXCONN), 1);
+        socket->base.listening = 1;
+        unix_wake_waiters(socket);
+        ret = 0;
+    }
+    unix_unlock();
+    return ret;
+}
+
+static int unix_stream_recvmsg(struct unix_socket *socket, struct msghdr *message, struct unix_rights **prights) {
+    if (!socket->connected) {
+        errno = ENOTCONN;
+        return -1;
+    }
+    size_t len = unix_iov_len(message);
+    ring_t *ring = &socket->ring;
+    size_t count = MIN(ring_read_count(ring), len);
+    struct unix_rights *rights = socket->rights;
+    if (count && rights && (rights->index == ring->read_index)) {
+        *prights = rights;
+        socket->rights = rights->next;
+        rights->next = NULL;
+        rights = socket->rights;
+    }
+    // Do not read past the files attached to later data.
+    if (rights) {
+        count = MIN(count, rights->index - ring->read_index);
+    }
+
+    int ret;
+    bool eof = socket->rd_shutdown || !socket->peer || socket->peer->wr_shutdown;
+    if (count) {
+        ret = 0;
+        for (int i = 0; (i < message->msg_iovlen) && (ret < count); i++) {
+            ret += ring_read(ring, message->msg_iov[i].iov_base, MIN(message->msg_iov[i].iov_len, count - ret));
+        }
+        unix_wake_waiters(socket);
+    } else if (eof || !len) {
+        ret = 0;
+    } else {
+        errno = EAGAIN;
+        ret = -1;
+    }
+    if (!ring_read_count(ring) && !eof) {
+        socket_notify(&socket->base, POLLIN | POLLRDNORM, 0);
+    }
+    return ret;
+}
+
+static int unix_dgram_recvmsg(struct unix_socket *socket, struct msghdr *message, struct unix_rights **prights, struct unix_dgram **pdgram) {
+    struct unix_dgram *dgram = socket->dgrams;
+    if (!dgram) {
+        if (socket->rd_shutdown) {
+            return 0;
+        }
+        errno = EAGAIN;
+        return -1;
+    }
+    socket->dgrams = dgram->next;
+    socket->dgram_bytes -= dgram->size;
+    if (!socket->dgrams) {
+        socket_notify(&socket->base, POLLIN | POLLRDNORM, 0);
+    }
+    unix_wake_waiters(socket);
+
+    int ret = 0;
+    for (int i = 0; (i < message->msg_iovlen) && (ret < dgram->size); i++) {
+        size_t size = MIN(message->msg_iov[i].iov_len, dgram->size - ret);
+        memcpy(message->msg_iov[i].iov_base, dgram->data + ret, size);
+        ret += size;
+    }
+    if (ret < dgram->size) {
+        message->msg_flags |= MSG_TRUNC;
+    }
+    unix_path_to_sockaddr(dgram->path, message->msg_name, &message->msg_namelen);
+    *prights = dgram->rights;
+    *pdgram = dgram;
+    return ret;
+}
+
+static int unix_recvmsg(void *ctx, struct msghdr *message, int flags) {
+    struct unix_socket *socket = ctx;
+    message->msg_flags = 0;
+    if (message->msg_name && (socket->base.type == SOCK_STREAM)) {
+        message->msg_namelen = 0;
+    }
+
+    TickType_t xTicksToWait = portMAX_DELAY;
+    struct unix_rights *rights = NULL;
+    struct unix_dgram *dgram = NULL;
+    int ret;
+    do {
+        unix_lock();
+        if (socket->base.type == SOCK_STREAM) {
+            ret = unix_stream_recvmsg(socket, message, &rights);
+        } else {
+            ret = unix_dgram_recvmsg(socket, message, &rights, &dgram);
+        }
+        unix_unlock();
+    }
+    while (!(flags & MSG_DONTWAIT) && POLL_SOCKET_CHECK(ret, &socket->base, POLLIN, &xTicksToWait));
+
+    unix_rights_to_msghdr(rights, message);
+    if (dgram) {
+        free(dgram->path);
+        free(dgram);
+    }
+    return ret;
+}
+
+static int unix_recvfrom(void *ctx, void *buf, size_t len, struct sockaddr *address, socklen_t *address_len) {
+    struct iovec iov = { .iov_base = buf, .iov_len = len };
+    struct msghdr message = {
+        .msg_name = address,
+        .msg_namelen = address_len ? *address_len : 0,
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+    int ret = unix_recvmsg(ctx, &message, 0);
+    if (address_len) {
+        *address_len = message.msg_namelen;
+    }
+    return ret;
+}
+
+static int unix_stream_sendmsg(struct unix_socket *socket, const struct msghdr *message, struct unix_rights **prights) {
+    struct unix_socket *peer = socket->peer;
+    if (!socket->connected) {
+        errno = ENOTCONN;
+        return -1;
+    }
+    if (socket->wr_shutdown || !peer || peer->rd_shutdown) {
+        errno = EPIPE;
+        return -1;
+    }
+    size_t len = unix_iov_len(message);
+    ring_t *ring = &peer->ring;
+    if (!len) {
+        return 0;
+    }
+    if (!ring_write_count(ring)) {
+        return unix_wait_for(socket, peer);
+    }
+
+    if (*prights) {
+        struct unix_rights **prev = &peer->rights;
+        while (*prev) {
+            prev = &(*prev)->next;
+        }
+        (*prights)->index = ring->write_index;
+        *prev = *prights;
+        *prights = NULL;
+    }
+    int ret = 0;
+    for (int i = 0; i < message->msg_iovlen; i++) {
+        size_t size = ring_write(ring, message->msg_iov[i].iov_base, message->msg_iov[i].iov_len);
+        ret += size;
+        if (size < message->msg_iov[i].iov_len) {
+            break;
+        }
+    }
+    socket_notify(&peer->base, 0, POLLIN | POLLRDNORM);
+    return ret;
+}
+
+static int unix_dgram_sendmsg(struct unix_socket *socket, const struct msghdr *message, const char *path, struct unix_dgram **pdgram) {
+    struct unix_socket *target = path ? unix_find(path) : socket->peer;
+    if (!target) {
+        errno = path ? ENOENT : (socket->connected ? ECONNREFUSED : ENOTCONN);
+        return -1;
+    }
+    if (target->base.type != SOCK_DGRAM) {
+        errno = EPROTOTYPE;
+        return -1;
+    }
+    if (socket->wr_shutdown || target->rd_shutdown) {
+        errno = EPIPE;
+        return -1;
+    }
+    struct unix_dgram *dgram = *pdgram;
+    if (target->dgrams && (target->dgram_bytes + dgram->size > UNIX_DGRAM_QUEUE_SIZE)) {
+        return unix_wait_for(socket, target);
+    }
+
+    if (socket->path) {
+        dgram->path = strdup(socket->path);
+    }
+    struct unix_dgram **prev = &target->dgrams;
+    while (*prev) {
+        prev = &(*prev)->next;
+    }
+    *prev = dgram;
+    *pdgram = NULL;
+    target->dgram_bytes += dgram->size;
+    socket_notify(&target->base, 0, POLLIN | POLLRDNORM);
+    return dgram->size;
+}
+
+static int unix_sendmsg(void *ctx, const struct msghdr *message, int flags) {
+    struct unix_socket *socket = ctx;
+    vfs_path_buffer_t vfs_path;
+    const char *path = NULL;
+    if (message->msg_name && (socket->base.type == SOCK_DGRAM)) {
+        path = unix_path_from_sockaddr(message->msg_name, message->msg_namelen, &vfs_path);
+        if (!path) {
+            return -1;
+        }
+    } else if (message->msg_name) {
+        errno = EISCONN;
+        return -1;
+    }
+
+    struct unix_rights *rights;
+    if (unix_rights_from_msghdr(message, &rights) < 0) {
+        return -1;
+    }
+
+    struct unix_dgram *dgram = NULL;
+    if (socket->base.type == SOCK_DGRAM) {
+        size_t len = unix_iov_len(message);
+        if (len > UNIX_DGRAM_QUEUE_SIZE) {
+            unix_rights_free(rights);
+            errno = EMSGSIZE;
+            return -1;
+        }
+        dgram = malloc(sizeof(struct unix_dgram) + len);
+        if (!dgram) {
+            unix_rights_free(rights);
+            return -1;
+        }
+        dgram->next = NULL;
+        dgram->rights = rights;
+        dgram->path = NULL;
+        dgram->size = 0;
+        for (int i = 0; i < message->msg_iovlen; i++) {
+            memcpy(dgram->data + dgram->size, message->msg_iov[i].iov_base, message->msg_iov[i].iov_len);
+            dgram->size += message->msg_iov[i].iov_len;
+        }
+        rights = NULL;
+    }
+
+    TickType_t xTicksToWait = portMAX_DELAY;
+    int ret;
+    do {
+        unix_lock();
+        if (socket->base.type == SOCK_STREAM) {
+            ret = unix_stream_sendmsg(socket, message, &rights);
+        } else {
+            ret = unix_dgram_sendmsg(socket, message, path, &dgram);
+        }
+        unix_unlock();
+    }
+    while (!(flags & MSG_DONTWAIT) && POLL_SOCKET_CHECK(ret, &socket->base, POLLOUT, &xTicksToWait));
+
+    // Free anything that was not sent.
+    unix_rights_free(rights);
+    if (dgram) {
+        unix_rights_free(dgram->rights);
+        free(dgram);
+    }
+    return ret;
+}
+
+static int unix_sendto(void *ctx, const void *buf, size_t len, const struct sockaddr *address, socklen_t address_len) {
+    struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+    struct msghdr message = {
+        .msg_name = (void *)address,
+        .msg_namelen = address_len,
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+    };
+    return unix_sendmsg(ctx, &message, 0);
+}
+
+static int unix_shutdown(void *ctx, int how) {
+    struct unix_socket *socket = ctx;
+    unix_lock();
+    int ret = -1;
+    if ((socket->base.type == SOCK_STREAM) && !socket->connected) {
+        errno = ENOTCONN;
+    } else {
+        if ((how == SHUT_RD) || (how == SHUT_RDWR)) {
+            socket->rd_shutdown = 1;
+            socket_notify(&socket->base, 0, POLLIN | POLLRDNORM);
+        }
+        if (((how == SHUT_WR) || (how == SHUT_RDWR)) && !socket->wr_shutdown) {
+            socket->wr_shutdown = 1;
+            if (socket->peer && (socket->base.type == SOCK_STREAM)) {
+                socket_notify(&socket->peer->base, 0, POLLIN | POLLRDNORM);
+            }
+        }
+        ret = 0;
+    }
+    unix_unlock();
+    return ret;
+}
+
+static const struct socket_vtable unix_vtable = {
+    .accept = unix_accept,
+    .bind = unix_bind,
+    .close = unix_close,
+    .connect = unix_connect,
+    .getpeername = unix_getpeername,
+    .getsockname = unix_getsockname,
+    .getsockopt = unix_getsockopt,
+    .listen = unix_listen,
+    .recvfrom = unix_recvfrom,
+    .recvmsg = unix_recvmsg,
+    .sendmsg = unix_sendmsg,
+    .sendto = unix_sendto,
+    .shutdown = unix_shutdown,
+};
+
+static int unix_check_type(int type, int protocol) {
+    if ((type != SOCK_STREAM) && (type != SOCK_DGRAM)) {
+        errno = ESOCKTNOSUPPORT;
+        return -1;
+    }
+    if (protocol != 0) {
+        errno = EPROTONOSUPPORT;
+        return -1;
+    }
+    return 0;
+}
+
+static struct socket *unix_socket(int domain, int type, int protocol) {
+    if (unix_check_type(type, protocol) < 0) {
+        return NULL;
+    }
+    unix_lock();
+    struct unix_socket *socket = unix_alloc(type);
+    unix_unlock();
+    return socket ? &socket->base : NULL;
+}
+
+static int unix_socketpair(int domain, int type, int protocol, int socket_vector[2]) {
+    if (unix_check_type(type, protocol) < 0) {
+        return -1;
+    }
+
+    struct unix_socket *sockets[2];
+    unix_lock();
+    sockets[0] = unix_alloc(type);
+    sockets[1] = sockets[0] ? unix_alloc(type) : NULL;
+    int ret = sockets[1] ? unix_connect_pair(sockets[0], sockets[1]) : -1;
+    unix_unlock();
+
+    for (int i = 0; i < 2; i++) {
+        socket_vector[i] = (ret >= 0) ? socket_fd(&sockets[i]->base) : -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (sockets[i]) {
+            socket_release(&sockets[i]->base);
+        }
+    }
+    if ((socket_vector[0] < 0) || (socket_vector[1] < 0)) {
+        // Keep the errno of the failure rather than one from closing.
+        int errcode = errno;
+        for (int i = 0; i < 2; i++) {
+            if (socket_vector[i] >= 0) {
+                close(socket_vector[i]);
+            }
+        }
+        errno = errcode;
+        ret = -1;
+    }
+    return ret;
+}
+
+const struct socket_family unix_af = {
+    .family = AF_UNIX,
+    .socket = unix_socket,
+    .socketpair = unix_socketpair,
+};
@@ -102,18 +102,21 @@ static void rp2_fifo_do_exchange(rp2_fifo_t *fifo, ring_t *ring, size_t usr_coun
     }
 
     if ((fifo->channel >= 0) && !fifo->trans_count) {
-        size_t begin_index = fifo->tx ? ring->read_index : ring->write_index;
-        size_t end_index = fifo->tx ? ring->write_index : ring->read_index + ring->size;
-        void *ptr = ring_at(ring, begin_index, &dma_count);
-        dma_count = MIN(dma_count, end_index - begin_index);
-        fifo->trans_count = dma_count >> fifo->transfer_size;
+        // DMA directly to or from the first contiguous segment of the ring.
+        struct ring_segment segs[2];
+        if (fifo->tx) {
+            ring_peek(ring, segs);
+        } else {
+            ring_reserve(ring, segs);
+        }
+        fifo->trans_count = segs[0].size >> fifo->transfer_size;
         if (!fifo->trans_count) {
             return;
         }
         if (fifo->tx) {
-            dma_channel_transfer_from_buffer_now(fifo->channel, ptr, fifo->trans_count);
+            dma_channel_transfer_from_buffer_now(fifo->channel, segs[0].ptr, fifo->trans_count);
         } else {
-            dma_channel_transfer_to_buffer_now(fifo->channel, ptr, fifo->trans_count);
+            dma_channel_transfer_to_buffer_now(fifo->channel, segs[0].ptr, fifo->trans_count);
         }
     }
 }
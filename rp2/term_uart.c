@@ -65,10 +65,9 @@ static void term_uart_handler(uint index) {
         }
     }
     if (write_count) {
-        UBaseType_t uxSavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
-        ring_write(&file->rx_fifo, &buffer, write_count);
+        // The ISR is the only producer, so it does not need to mask interrupts to write the ring.
+        ring_spsc_write(&file->rx_fifo, &buffer, write_count);
         poll_file_notify_from_isr(&file->base, 0, POLLIN | POLLRDNORM, &xHigherPriorityTaskWoken);
-        taskEXIT_CRITICAL_FROM_ISR(uxSavedInterruptStatus);
     }
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
@@ -141,8 +140,10 @@ static int term_uart_ioctl(void *ctx, unsigned long request, va_list args) {
         case TCFLSH: {
             rp2_fifo_clear(&file->tx_fifo);
             taskENTER_CRITICAL();
-            ring_clear(&file->rx_fifo);
-            poll_file_notify(&file->base, POLLIN | POLLRDNORM, POLLOUT | POLLWRNORM | POLLDRAIN);
+            ring_spsc_clear(&file->rx_fifo);
+            // The ISR may have written after the clear, so POLLIN follows what is left in the ring.
+            uint readable = ring_spsc_read_count(&file->rx_fifo) ? POLLIN | POLLRDNORM : 0;
+            poll_file_notify(&file->base, (POLLIN | POLLRDNORM) & ~readable, POLLOUT | POLLWRNORM | POLLDRAIN | readable);
             taskEXIT_CRITICAL();
             ret = 0;
             break;
@@ -176,12 +177,17 @@ static int term_uart_read(void *ctx, void *buffer, size_t size) {
     TickType_t xTicksToWait = portMAX_DELAY;
     int ret = 0;
     while ((ret == 0) && (ret < size)) {
-        taskENTER_CRITICAL();
-        ret = ring_read(&file->rx_fifo, buffer, size);
+        // Readers are serialized by the mutex, which makes them the ring's single consumer.
+        xSemaphoreTake(file->mutex, portMAX_DELAY);
+        ret = ring_spsc_read(&file->rx_fifo, buffer, size);
         if (ret == 0) {
             poll_file_notify(&file->base, POLLIN | POLLRDNORM, 0);
+            // The ISR may have written after the read but before POLLIN was cleared.
+            if (ring_spsc_read_count(&file->rx_fifo)) {
+                poll_file_notify(&file->base, 0, POLLIN | POLLRDNORM);
+            }
         }
-        taskEXIT_CRITICAL();
+        xSemaphoreGive(file->mutex);
         if (ret == 0) {
             if (poll_file_wait(&file->base, POLLIN | POLLRDNORM, &xTicksToWait) < 0) {
                 return -1;